@@ -0,0 +1,34 @@
+#version 450 core
+
+// One instance per glyph, the quad is drawn as a 4 vertex triangle strip.
+layout(location = 0) in vec2 a_Position;
+layout(location = 1) in uint a_Glyph;
+layout(location = 2) in vec4 a_Color;
+
+layout(std140, binding = 0) uniform u_Buf
+{
+    vec2 Scale;
+};
+
+struct GlyphQuad
+{
+    vec4 TexRect;   // Texture coords of the first and last corner.
+    vec4 Rect;      // Offset from the pen position and size.
+};
+
+layout(std430, binding = 1) readonly buffer b_Glyphs
+{
+    GlyphQuad Glyphs[];
+};
+
+out vec2 v_TexCoords;
+out vec4 v_Color;
+
+void main() {
+    GlyphQuad glyph = Glyphs[a_Glyph];
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 position = a_Position + glyph.Rect.xy + corner * glyph.Rect.zw;
+    gl_Position = vec4(Scale * position + vec2(-1.0f, 1.0f), 0.0, 1.0);
+    v_TexCoords = mix(glyph.TexRect.xy, glyph.TexRect.zw, corner);
+    v_Color = a_Color;
+}
@@ -0,0 +1,17 @@
+#version 450 core
+
+layout(location = 0) out vec4 o_Color;
+layout(binding = 0) uniform sampler2D u_Tex;
+
+in vec4 v_Color;
+in vec2 v_TexCoords;
+
+// The atlas holds the distance to the glyph's outline, which lies at 0.5.
+// Blending across however much the distance changes over a pixel keeps the
+// edges about a pixel wide at any scale.
+void main() {
+    float distance = texture(u_Tex, v_TexCoords).r;
+    float width = fwidth(distance);
+    float texAlpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    o_Color = vec4(v_Color.rgb, texAlpha);
+}
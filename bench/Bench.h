@@ -0,0 +1,86 @@
+#ifndef _DCE_BENCH_H
+#define _DCE_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Core.h"
+
+// Shared helpers for the benchmarks. Progress goes to stderr as each result
+// comes in, the full set of results is printed to stdout as one JSON document
+// at the end so runs can be diffed between commits.
+
+namespace bench
+{
+    struct Result
+    {
+        std::string Name;
+        std::string Variant;
+        size_t Size;
+        size_t Ops;
+        size_t Bytes;
+        double Seconds;
+    };
+
+    static std::vector<Result> s_Results;
+    static volatile uint64_t s_Sink;
+    static uint64_t s_Seed = 0x2545F4914F6CDD1Dull;
+
+    static inline uint64_t NextRandom()
+    {
+        s_Seed ^= s_Seed << 13;
+        s_Seed ^= s_Seed >> 7;
+        s_Seed ^= s_Seed << 17;
+        return s_Seed;
+    }
+
+    static inline double Now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 'bytes' is how much data the operations went through, 0 if that isn't
+    // meaningful for the benchmark.
+    static inline void Report(const std::string& name, const std::string& variant, size_t size,
+                              size_t ops, size_t bytes, double seconds)
+    {
+        s_Results.push_back({ name, variant, size, ops, bytes, seconds });
+        fprintf(stderr, "  %-32s %-12s %12lu B  %12.1f ns/op", name.c_str(), variant.c_str(), size,
+                seconds * 1e9 / (double)ops);
+        if(bytes)
+            fprintf(stderr, "  %10.1f MB/s", (double)bytes / seconds / 1e6);
+        fprintf(stderr, "\n");
+    }
+
+    static inline void PrintJson(const char* suite)
+    {
+        printf("{\n  \"suite\": \"%s\",\n  \"results\": [\n", suite);
+        for(size_t i = 0; i < s_Results.size(); ++i)
+        {
+            const Result& r = s_Results[i];
+            printf("    { \"name\": \"%s\", \"variant\": \"%s\", \"size\": %lu, \"ops\": %lu, "
+                   "\"ns_per_op\": %.3f, \"bytes_per_sec\": %.1f }%s\n",
+                   r.Name.c_str(), r.Variant.c_str(), r.Size, r.Ops, r.Seconds * 1e9 / (double)r.Ops,
+                   r.Bytes ? (double)r.Bytes / r.Seconds : 0.0, i + 1 == s_Results.size() ? "" : ",");
+        }
+        printf("  ]\n}\n");
+    }
+
+    // Parses sizes like 4096, 64K, 16M or 1G.
+    static inline size_t ParseSize(const char* text)
+    {
+        char* end;
+        size_t size = strtoull(text, &end, 10);
+        if(*end == 'K' || *end == 'k')
+            size <<= 10;
+        else if(*end == 'M' || *end == 'm')
+            size <<= 20;
+        else if(*end == 'G' || *end == 'g')
+            size <<= 30;
+        return size;
+    }
+}
+
+#endif // _DCE_BENCH_H
@@ -0,0 +1,395 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "BufferRegistry.h"
+#include "FileManager.h"
+#include "GapBuffer.h"
+#include "LineIndex.h"
+#include "Scheduler.h"
+#include "TextScan.h"
+
+// Headless benchmarks of the storage core over texts from 1KB up to
+// --max-size (1GB by default). Files for the load and save benchmarks are
+// written to --dir, which defaults to the system temp directory.
+
+using namespace dce;
+
+// The storage only needs these from the rest of the editor.
+static BufferRegistry* s_Buffers;
+
+namespace dce
+{
+    namespace Editor
+    {
+        EditorStorage& GetStorage() { return s_Buffers->GetActive(); }
+        BufferRegistry& GetBuffers() { return *s_Buffers; }
+        void Wake() {}
+    }
+
+    namespace Renderer
+    {
+        size_t GetLastLineCountDrawn() { return 50; }
+    }
+}
+
+// Keeps cheap operations from being timed too briefly and expensive ones
+// from taking forever, based on how many bytes each one touches.
+static size_t GetOpCount(size_t bytesPerOp, size_t maxOps)
+{
+    size_t ops = (0x10000000ul / (bytesPerOp ? bytesPerOp : 1));
+    return ops < 16 ? 16 : (ops > maxOps ? maxOps : ops);
+}
+
+static void FillText(char* data, size_t size)
+{
+    for(size_t i = 0; i < size; ++i)
+    {
+        uint64_t r = bench::NextRandom();
+        data[i] = (r % 40) == 0 ? '\n' : (char)('a' + r % 26);
+    }
+}
+
+static void BenchGapBuffer(size_t size)
+{
+    const char chunk[] = "0123456789abcdef";
+    {
+        GapBuffer<char> buffer(16);
+        size_t ops = size / 16 ? size / 16 : 1;
+        double start = bench::Now();
+        for(size_t i = 0; i < ops; ++i)
+            buffer.Add(chunk, 16, true);
+        bench::Report("GapBuffer.Add", "16 bytes", size, ops, ops * 16, bench::Now() - start);
+    }
+
+    GapBuffer<char> buffer(size);
+    FillText(buffer.AddUninitialized(size), size);
+    {
+        size_t ops = GetOpCount(size >> 1, 100000ul);
+        std::vector<size_t> positions(ops);
+        for(size_t& position : positions)
+            position = bench::NextRandom() % (size + 1);
+        double start = bench::Now();
+        size_t moved = 0, gap = buffer.GapPos();
+        for(size_t position : positions)
+        {
+            buffer.SetGapPosition(position);
+            moved += position > gap ? position - gap : gap - position;
+            gap = position;
+        }
+        bench::Report("GapBuffer.SetGapPosition", "random", size, ops, moved, bench::Now() - start);
+    }
+    {
+        // Both sides of the gap stay multiples of 16 bytes, so every remove
+        // finds enough on the side it picks.
+        buffer.SetGapPosition(buffer.GapPos() & ~(size_t)15);
+        size_t ops = size / 16;
+        double start = bench::Now();
+        for(size_t i = 0; i < ops; ++i)
+        {
+            bool isBeforeGap = buffer.GapPos() >= 16 && ((i & 1) || buffer.Size() - buffer.GapPos() < 16);
+            buffer.Remove(16, isBeforeGap);
+        }
+        bench::Report("GapBuffer.Remove", "16 bytes", size, ops, 0, bench::Now() - start);
+    }
+}
+
+static void BenchLineIndex(const char* data, size_t size)
+{
+    std::vector<size_t> lengths;
+    double start = bench::Now();
+    TextScan::BuildLineLengths(data, size, lengths);
+    LineIndex lines;
+    lines.Build(lengths.data(), lengths.size());
+    bench::Report("LineIndex.Build", TextScan::GetScanMethodName(), size, 1, size, bench::Now() - start);
+
+    size_t ops = 100000;
+    std::vector<size_t> positions(ops);
+    for(size_t& position : positions)
+        position = bench::NextRandom() % (size + 1);
+    uint64_t sink = 0;
+    start = bench::Now();
+    for(size_t position : positions)
+        sink += lines.GetLineOf(position);
+    bench::Report("LineIndex.GetLineOf", "random", size, ops, 0, bench::Now() - start);
+
+    start = bench::Now();
+    for(size_t position : positions)
+        sink += lines.GetLineStart(position % lines.GetLineCount());
+    bench::Report("LineIndex.GetLineStart", "random", size, ops, 0, bench::Now() - start);
+    bench::s_Sink = sink;
+}
+
+// Scans for a two letter query, narrows it down a letter at a time and
+// edits with the matches kept up to date. The text is the one BenchFile()
+// edited, so the gap or the pieces are spread all over it.
+static void BenchSearch(EditorStorage& storage, size_t size, const char* backendName)
+{
+    TextSearch& search = storage.GetSearch();
+    double start = bench::Now();
+    search.SetQuery(storage.GetText(), "ab");
+    Scheduler::Run(Scheduler::Clock::time_point::max());
+    bench::Report("TextSearch.Scan", backendName, size, 1, storage.GetText().Size(), bench::Now() - start);
+
+    start = bench::Now();
+    search.SetQuery(storage.GetText(), "abc");
+    Scheduler::Run(Scheduler::Clock::time_point::max());
+    search.SetQuery(storage.GetText(), "abcd");
+    Scheduler::Run(Scheduler::Clock::time_point::max());
+    bench::Report("TextSearch.Narrow", backendName, size, 2, 0, bench::Now() - start);
+
+    search.SetQuery(storage.GetText(), "ab");
+    Scheduler::Run(Scheduler::Clock::time_point::max());
+    size_t ops = 1000;
+    start = bench::Now();
+    for(size_t i = 0; i < ops; ++i)
+    {
+        storage.SetCursor(bench::NextRandom() % storage.GetText().Size());
+        storage.AddChar(i % 2 ? 'a' : 'b');
+    }
+    bench::Report("TextSearch.Edit", backendName, size, ops, 0, bench::Now() - start);
+    search.Clear();
+
+    // Workers find the matches, the scheduler only picks them up.
+    RegexSearch& regex = storage.GetRegexSearch();
+    start = bench::Now();
+    regex.SetQuery(storage.GetText(), storage.GetLines(), "[a-z]+_[a-z]+\\(");
+    while(regex.IsSearching())
+    {
+        Scheduler::Run(Scheduler::Clock::time_point::max());
+        std::this_thread::yield();
+    }
+    bench::Report("RegexSearch.Scan", backendName, size, 1, storage.GetText().Size(), bench::Now() - start);
+    regex.Clear();
+}
+
+static void BenchFile(const std::string& path, size_t size, TextBackend backend)
+{
+    const char* backendName = TextBuffer::GetBackendName(backend);
+    BufferRegistry buffers;
+    buffers.SetDefaultBackend(backend);
+    s_Buffers = &buffers;
+
+    double start = bench::Now();
+    FileMan::LoadFileToEditor(path);
+    while(FileMan::IsLoading(buffers.GetActive()))
+        Scheduler::Run(Scheduler::Clock::time_point::max());
+    bench::Report("FileMan.LoadFileToEditor", backendName, size, 1, size, bench::Now() - start);
+
+    EditorStorage& storage = buffers.GetActive();
+    size_t ops = 100000;
+    start = bench::Now();
+    for(size_t i = 0; i < ops; ++i)
+        storage.MoveCursorLinewise((int64_t)(bench::NextRandom() % 201) - 100);
+    bench::Report("EditorStorage.MoveCursorLinewise", backendName, size, ops, 0, bench::Now() - start);
+
+    // Saving an edited buffer writes every piece, not just the original.
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        storage.MoveCursorLinewise((int64_t)(bench::NextRandom() % 2001) - 1000);
+        storage.AddChar('x');
+    }
+    BenchSearch(storage, size, backendName);
+    start = bench::Now();
+    FileMan::SaveEditorToFile(path);
+    FileMan::FinishSaving();
+    bench::Report("FileMan.SaveEditorToFile", backendName, size, 1, storage.GetText().Size(), bench::Now() - start);
+    s_Buffers = nullptr;
+}
+
+static constexpr size_t SYNTAX_LINE_CNT = 50000;
+
+// SYNTAX_LINE_CNT lines of C, written to a file with the given extension.
+static std::string WriteSyntaxFile(const std::string& dir, const char* extension, size_t* o_Size)
+{
+    static const char FUNCTION[] =
+        "/* Sums up the even values. */\n"
+        "static int SumEven(const int* values, size_t count)\n"
+        "{\n"
+        "    int sum = 0;\n"
+        "    for(size_t i = 0; i < count; ++i)\n"
+        "    {\n"
+        "        if(values[i] % 2 == 0)\n"
+        "            sum += values[i];\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n"
+        "\n";
+    std::string text;
+    for(size_t line = 0; line < SYNTAX_LINE_CNT; line += 12)
+        text += FUNCTION;
+
+    std::string path = dir + "/dce-bench-" + std::to_string(getpid()) + extension;
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file || fwrite(text.data(), 1, text.size(), file) != text.size())
+    {
+        fprintf(stderr, "Unable to write benchmark file: %s\n", path.c_str());
+        if(file)
+            fclose(file);
+        return std::string();
+    }
+    fclose(file);
+    *o_Size = text.size();
+    return path;
+}
+
+// Parses a C file and then types into it at random spots, timing each edit
+// until the highlighter has the tree for the edited text.
+static void BenchSyntax(const std::string& dir, TextBackend backend)
+{
+    size_t size;
+    std::string path = WriteSyntaxFile(dir, ".c", &size);
+    if(path.empty())
+        return;
+
+    const char* backendName = TextBuffer::GetBackendName(backend);
+    BufferRegistry buffers;
+    buffers.SetDefaultBackend(backend);
+    s_Buffers = &buffers;
+    FileMan::LoadFileToEditor(path);
+    while(FileMan::IsLoading(buffers.GetActive()))
+        Scheduler::Run(Scheduler::Clock::time_point::max());
+    unlink(path.c_str());
+    EditorStorage& storage = buffers.GetActive();
+    SyntaxHighlighter& syntax = storage.GetSyntax();
+
+    // Nothing is parsed until it's about to be drawn. Without a highlight
+    // query, e.g. when not run from the repository root, no tree ever comes.
+    double start = bench::Now();
+    syntax.Highlight(storage.GetText(), storage.GetLines(), 0, 0);
+    if(!syntax.IsParsing())
+    {
+        printf("Skipping the tree-sitter benchmarks, the C grammar or its highlight query didn't load.\n");
+        s_Buffers = nullptr;
+        return;
+    }
+    while(!syntax.Update())
+        std::this_thread::yield();
+    bench::Report("SyntaxHighlighter.Parse", backendName, size, 1, size, bench::Now() - start);
+
+    // An edit only costs the main thread applying it to the trees, the
+    // reparse is the time until the new tree is picked up.
+    size_t ops = 200;
+    double editTime = 0.0;
+    start = bench::Now();
+    for(size_t i = 0; i < ops; ++i)
+    {
+        storage.SetCursor(bench::NextRandom() % storage.GetText().Size());
+        double editStart = bench::Now();
+        storage.AddChar('x');
+        editTime += bench::Now() - editStart;
+        while(!syntax.Update())
+            std::this_thread::yield();
+    }
+    double reparseTime = bench::Now() - start;
+    bench::Report("SyntaxHighlighter.Edit", backendName, size, ops, 0, editTime);
+    bench::Report("SyntaxHighlighter.Reparse", backendName, size, ops, 0, reparseTime);
+    s_Buffers = nullptr;
+}
+
+// Same as BenchSyntax() for a file that's only lexed. Every edit is followed
+// by highlighting the lines from the edited one on and lexing until the line
+// states are right again.
+static void BenchLexer(const std::string& dir, TextBackend backend)
+{
+    static constexpr size_t VISIBLE_SIZE = 0x1000ul;
+    size_t size;
+    std::string path = WriteSyntaxFile(dir, ".cpp", &size);
+    if(path.empty())
+        return;
+
+    const char* backendName = TextBuffer::GetBackendName(backend);
+    BufferRegistry buffers;
+    buffers.SetDefaultBackend(backend);
+    s_Buffers = &buffers;
+    FileMan::LoadFileToEditor(path);
+    while(FileMan::IsLoading(buffers.GetActive()))
+        Scheduler::Run(Scheduler::Clock::time_point::max());
+    unlink(path.c_str());
+    EditorStorage& storage = buffers.GetActive();
+    SyntaxHighlighter& syntax = storage.GetSyntax();
+
+    double start = bench::Now();
+    syntax.Highlight(storage.GetText(), storage.GetLines(), 0, 0);
+    Scheduler::Run(Scheduler::Clock::time_point::max());
+    bench::Report("Lexer.Lex", backendName, size, 1, size, bench::Now() - start);
+
+    size_t ops = 200;
+    start = bench::Now();
+    for(size_t i = 0; i < ops; ++i)
+    {
+        storage.SetCursor(bench::NextRandom() % storage.GetText().Size());
+        storage.AddChar(i % 2 ? '\n' : '"');
+        size_t lineStart = storage.GetLines().GetLineStart(storage.GetCursorLine() - 1);
+        syntax.Highlight(storage.GetText(), storage.GetLines(), lineStart,
+                         std::min(VISIBLE_SIZE, storage.GetText().Size() - lineStart));
+        Scheduler::Run(Scheduler::Clock::time_point::max());
+    }
+    bench::Report("Lexer.Edit", backendName, size, ops, 0, bench::Now() - start);
+    s_Buffers = nullptr;
+}
+
+int main(int argc, char** argv)
+{
+    size_t maxSize = 1ul << 30;
+    std::string dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+            maxSize = bench::ParseSize(argv[++i]);
+        else if(strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [--max-size SIZE] [--dir DIRECTORY]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Keeps the load and save messages out of the JSON on stdout.
+    fflush(stdout);
+    int jsonFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    std::string path = dir + "/dce-bench-" + std::to_string(getpid()) + ".txt";
+    for(size_t size = 0x400ul; size <= maxSize; size <<= 4)
+    {
+        fprintf(stderr, "%lu byte text:\n", size);
+        std::vector<char> text(size);
+        FillText(text.data(), size);
+
+        BenchGapBuffer(size);
+        BenchLineIndex(text.data(), size);
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if(!file || fwrite(text.data(), 1, size, file) != size)
+        {
+            fprintf(stderr, "Unable to write benchmark file: %s\n", path.c_str());
+            return EXIT_FAILURE;
+        }
+        fclose(file);
+        text = std::vector<char>();
+
+        BenchFile(path, size, TextBackend::GAP_BUFFER);
+        BenchFile(path, size, TextBackend::PIECE_TREE);
+        unlink(path.c_str());
+    }
+
+    fprintf(stderr, "Syntax highlighting:\n");
+    BenchSyntax(dir, TextBackend::GAP_BUFFER);
+    BenchSyntax(dir, TextBackend::PIECE_TREE);
+    BenchLexer(dir, TextBackend::GAP_BUFFER);
+    BenchLexer(dir, TextBackend::PIECE_TREE);
+
+    fflush(stdout);
+    dup2(jsonFd, STDOUT_FILENO);
+    close(jsonFd);
+    bench::PrintJson("storage");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Bench.h"
+#include "TextBuffer.h"
+#include "PieceTree.h"
+
+// Replays the same random-access edit trace against every text backend and
+// reports how long each one took, along with a checksum so both backends can
+// be confirmed to end up with identical contents.
+
+using namespace dce;
+
+enum class EditType
+{
+    INSERT,
+    ERASE,
+    SEEK
+};
+
+struct Edit
+{
+    EditType Type;
+    size_t Position;
+    size_t Count;
+};
+
+static std::vector<Edit> GenerateTrace(size_t initialSize, size_t editCount)
+{
+    std::vector<Edit> trace;
+    trace.reserve(editCount);
+    size_t size = initialSize;
+    for(size_t i = 0; i < editCount; ++i)
+    {
+        uint64_t r = bench::NextRandom();
+        size_t count = 1 + (r >> 60);
+        EditType type = (r & 3) == 0 ? EditType::ERASE : ((r & 3) == 1 ? EditType::SEEK : EditType::INSERT);
+        if(type == EditType::ERASE && size < count)
+            type = EditType::INSERT;
+
+        size_t position = (size_t)(bench::NextRandom() % (size + 1));
+        if(type == EditType::ERASE)
+        {
+            position = position > size - count ? size - count : position;
+            size -= count;
+        }
+        else if(type == EditType::INSERT)
+            size += count;
+        trace.push_back({ type, position, count });
+    }
+    return trace;
+}
+
+static uint64_t Checksum(const TextBuffer& text)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t pos = 0; pos < text.Size(); )
+    {
+        TextSpan span = text.SpanAt(pos);
+        for(size_t i = 0; i < span.Size; ++i)
+            hash = (hash ^ (uint8_t)span.Data[i]) * 1099511628211ull;
+        pos += span.Size;
+    }
+    return hash;
+}
+
+static void RunTrace(TextBackend backend, const std::vector<char>& original, const std::vector<Edit>& trace)
+{
+    std::unique_ptr<TextBuffer> text(TextBuffer::Create(backend, original.size()));
+    memcpy(text->Load(original.size()), original.data(), original.size());
+
+    const char insertData[] = "abcdefghijklmnop\n";
+    uint64_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(const Edit& edit : trace)
+    {
+        if(edit.Type == EditType::INSERT)
+            text->Insert(edit.Position, insertData, edit.Count);
+        else if(edit.Type == EditType::ERASE)
+            text->Erase(edit.Position, edit.Count);
+        else
+        {
+            TextSpan span = text->SpanAt(edit.Position);
+            sink += span.Size ? (uint8_t)span.Data[0] : 0;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    bench::s_Sink = sink;
+    bench::Report("TextBuffer.RandomEdits", TextBuffer::GetBackendName(backend), original.size(),
+                  trace.size(), 0, seconds);
+    fprintf(stderr, "  %-32s %-12s checksum %016lx\n", "", "", Checksum(*text));
+}
+
+int main(int argc, char** argv)
+{
+    size_t editCount = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000ul;
+    const size_t SIZES[] = { 0x10000ul, 0x100000ul, 0x1000000ul };
+
+    for(size_t size : SIZES)
+    {
+        std::vector<char> original(size);
+        for(size_t i = 0; i < size; ++i)
+        {
+            uint64_t r = bench::NextRandom();
+            original[i] = (r % 40) == 0 ? '\n' : (char)('a' + r % 26);
+        }
+        std::vector<Edit> trace = GenerateTrace(size, editCount);
+
+        fprintf(stderr, "%lu random edits on a %lu byte file:\n", editCount, size);
+        RunTrace(TextBackend::GAP_BUFFER, original, trace);
+        RunTrace(TextBackend::PIECE_TREE, original, trace);
+    }
+    bench::PrintJson("textbuffer");
+    return EXIT_SUCCESS;
+}
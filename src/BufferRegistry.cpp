@@ -0,0 +1,66 @@
+#include "BufferRegistry.h"
+
+namespace dce
+{
+    BufferRegistry::BufferRegistry()
+    {
+        m_Active = 0;
+        m_DefaultBackend = TextBackend::PIECE_TREE;
+        Open();
+    }
+
+    EditorStorage& BufferRegistry::Open()
+    {
+        m_Buffers.emplace_back(new EditorStorage());
+        m_Buffers.back()->SetBackend(m_DefaultBackend);
+        m_Active = m_Buffers.size() - 1;
+        return *m_Buffers.back();
+    }
+
+    void BufferRegistry::Close(size_t index)
+    {
+        DCE_ASSERT(index < m_Buffers.size(), "Attempted to close buffer out of bounds %lu! Valid range is 0 - %lu.\n",
+                   index, m_Buffers.size() - 1);
+        m_Buffers.erase(m_Buffers.begin() + index);
+        if(m_Buffers.empty())
+        {
+            Open();
+            return;
+        }
+        if(m_Active > index || m_Active == m_Buffers.size())
+            --m_Active;
+    }
+
+    void BufferRegistry::SetActive(size_t index)
+    {
+        DCE_ASSERT(index < m_Buffers.size(), "Attempted to switch to buffer out of bounds %lu! Valid range is 0 - %lu.\n",
+                   index, m_Buffers.size() - 1);
+        m_Active = index;
+    }
+
+    // Buffers opened from now on use the backend, and so does the active one
+    // as long as nothing has been loaded into it yet.
+    void BufferRegistry::SetDefaultBackend(TextBackend backend)
+    {
+        m_DefaultBackend = backend;
+        EditorStorage& active = GetActive();
+        if(active.GetText().Size() == 0 && active.GetFilePath().empty())
+            active.SetBackend(backend);
+    }
+
+    void BufferRegistry::Trim()
+    {
+        for(std::unique_ptr<EditorStorage>& buffer : m_Buffers)
+            buffer->Trim();
+    }
+
+    size_t BufferRegistry::Find(const std::string& filepath) const
+    {
+        for(size_t i = 0; i < m_Buffers.size(); ++i)
+        {
+            if(m_Buffers[i]->GetFilePath() == filepath)
+                return i;
+        }
+        return m_Buffers.size();
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef _DCE_BUFFER_REGISTRY_H
+#define _DCE_BUFFER_REGISTRY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EditorStorage.h"
+
+namespace dce
+{
+    // Every open buffer, each with its own text, cursor and camera. Switching
+    // only changes which one is active, nothing gets reloaded or copied.
+    class BufferRegistry
+    {
+    public:
+        BufferRegistry();
+
+        // Adds an empty buffer using the default backend and makes it active.
+        EditorStorage& Open();
+        // Closing the last buffer leaves a new empty one behind.
+        void Close(size_t index);
+        void SetActive(size_t index);
+        void SetDefaultBackend(TextBackend backend);
+        void Trim();
+        // Returns GetCount() if no buffer has that path.
+        size_t Find(const std::string& filepath) const;
+
+        inline EditorStorage& GetActive() { return *m_Buffers[m_Active]; }
+        inline EditorStorage& Get(size_t index) { return *m_Buffers[index]; }
+        inline size_t GetActiveIndex() const { return m_Active; }
+        inline size_t GetCount() const { return m_Buffers.size(); }
+    private:
+        std::vector<std::unique_ptr<EditorStorage>> m_Buffers;
+        size_t m_Active;
+        TextBackend m_DefaultBackend;
+    };
+}
+
+#endif // _DCE_BUFFER_REGISTRY_H
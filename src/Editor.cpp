@@ -1,6 +1,15 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
 #include "Editor.h"
 #include "FileManager.h"
+#include "FrameStats.h"
 #include "Renderer.h"
+#include "Replay.h"
+#include "Scheduler.h"
 #include "Window.h"
 
 namespace dce
@@ -12,38 +21,257 @@ namespace dce
         
 
         static EditorState s_State;
-        static EditorStorage s_Storage;
+        static BufferRegistry s_Buffers;
         static EditorWindow* s_Window; 
+        static std::atomic<bool> s_WindowOpen; // Read by Wake() on other threads.
         static Font* s_RegularFont;
 
         
         static size_t s_SelectedFile;
-        static int s_CusorBlinkTimer;
+        static std::string s_FindQuery;
+        static bool s_FindRegex;
+        static bool s_CursorVisible;
+        static bool s_Damaged;
+        static std::chrono::steady_clock::time_point s_LastInputTime;
+        static std::chrono::steady_clock::time_point s_StartTime;
+        static bool s_Trimmed;
 
-        static const uint32_t s_FontSize = 30;
+        static constexpr const char* FONT_PATH = "assets/fonts/Consolas.ttf";
+        static constexpr uint32_t BASE_FONT_SIZE = 30;
+        static constexpr float ZOOM_STEP = 1.1f;
+        static constexpr float MIN_ZOOM = 0.5f, MAX_ZOOM = 4.0f;
+        static uint32_t s_FontSize = BASE_FONT_SIZE;
+        static FontRenderMode s_FontRenderMode = FontRenderMode::BITMAP;
+        static float s_Zoom = 1.0f;
+        static float s_ContentScale = 1.0f;
+        static constexpr std::chrono::seconds IDLE_TRIM_DELAY(5);
+        static constexpr double HEADLESS_FRAME_TIME = 1.0 / 60.0;
+        static constexpr std::chrono::milliseconds CURSOR_BLINK_INTERVAL(DCE_CURSOR_BLINK_INTERVAL_MS);
+        // Kept free at the end of every frame for swapping buffers, background
+        // work stops short of it.
+        static constexpr std::chrono::microseconds FRAME_SLACK(2000);
+        static std::chrono::steady_clock::duration s_FramePeriod;
 
-        
+        // An SDF atlas is drawn scaled, a bitmap one has to be rasterized again
+        // at the new size.
+        static void ApplyZoom()
+        {
+            const float scale = s_Zoom * s_ContentScale;
+            if(s_FontRenderMode == FontRenderMode::SDF)
+                Renderer::SetZoom(scale);
+            else
+            {
+                uint32_t fontSize = (uint32_t)((float)BASE_FONT_SIZE * scale + 0.5f);
+                if(fontSize != s_FontSize)
+                {
+                    delete s_RegularFont;
+                    s_FontSize = fontSize;
+                    s_RegularFont = new Font(FONT_PATH, s_FontSize, s_FontRenderMode);
+                }
+            }
+            s_Damaged = true;
+        }
+
+        static void SetZoom(float zoom)
+        {
+            s_Zoom = zoom < MIN_ZOOM ? MIN_ZOOM : (zoom > MAX_ZOOM ? MAX_ZOOM : zoom);
+            ApplyZoom();
+        }
+
+        static void SwitchBuffer(size_t index)
+        {
+            s_Buffers.SetActive(index);
+            const std::string& path = s_Buffers.GetActive().GetFilePath();
+            printf("Buffer %lu/%lu: %s\n", index + 1, s_Buffers.GetCount(), path.empty() ? "[untitled]" : path.c_str());
+        }
+
+        static double Seconds(std::chrono::steady_clock::duration duration)
+        {
+            return std::chrono::duration<double>(duration).count();
+        }
+
+        // The cursor blinks in phases of CURSOR_BLINK_INTERVAL counted from the
+        // last key press, starting visible. Returns when the next phase begins.
+        static std::chrono::steady_clock::time_point UpdateCursorBlink(std::chrono::steady_clock::time_point now)
+        {
+            auto phase = (now - s_LastInputTime) / CURSOR_BLINK_INTERVAL;
+            bool visible = (phase & 1) == 0;
+            if(visible != s_CursorVisible)
+            {
+                s_CursorVisible = visible;
+                s_Damaged = true;
+            }
+            return s_LastInputTime + (phase + 1) * CURSOR_BLINK_INTERVAL;
+        }
+
+        // Feeds the events to OnKeyPress in frames of HEADLESS_FRAME_TIME, each
+        // followed by the layout RenderEditor() does and the background work
+        // that fits in the rest of the frame, and reports how long both took.
+        // Frames without any events or loading to do are skipped.
+        static void RunReplay(const std::vector<KeyEvent>& events)
+        {
+            std::vector<double> frameTimes;
+            double editTime = 0.0;
+            size_t next = 0;
+            double frameEnd = 0.0;
+            auto replayStart = std::chrono::steady_clock::now();
+            while(s_Running && (next < events.size() || FileMan::IsLoading(GetStorage())))
+            {
+                if(next < events.size() && !FileMan::IsLoading(GetStorage()))
+                    frameEnd = std::max(frameEnd, events[next].Time);
+                frameEnd += HEADLESS_FRAME_TIME;
 
+                FrameStats::BeginFrame();
+                auto frameStart = std::chrono::steady_clock::now();
+                {
+                    ScopedStageTimer timer(FrameStage::EVENTS);
+                    for(; next < events.size() && events[next].Time < frameEnd; ++next)
+                        OnKeyPress(events[next].Code, events[next].Mods, events[next].Repeat);
+                }
+                auto editEnd = std::chrono::steady_clock::now();
+                editTime += Seconds(editEnd - frameStart);
+
+                GetStorage().GetSyntax().Update();
+                GetStorage().GetSearch().Update();
+                GetStorage().GetRegexSearch().Update();
+                UpdateCursorBlink(std::chrono::steady_clock::now());
+                if(s_State == EditorState::EDITING || s_State == EditorState::FIND)
+                    Renderer::RenderEditor();
+                else if(s_State == EditorState::FILE_MANAGER)
+                    Renderer::RenderFileManager(s_SelectedFile);
+                if(s_State == EditorState::FIND)
+                    Renderer::RenderFindBar(s_FindRegex);
+                if(FrameStats::IsOverlayVisible())
+                    Renderer::RenderFrameStats();
+                Renderer::EndFrame();
+                {
+                    ScopedStageTimer timer(FrameStage::BACKGROUND);
+                    Scheduler::Run(frameStart + s_FramePeriod - FRAME_SLACK);
+                }
+                frameTimes.push_back(Seconds(std::chrono::steady_clock::now() - frameStart));
+                FrameStats::EndFrame();
+            }
+            double totalTime = Seconds(std::chrono::steady_clock::now() - replayStart);
+
+            size_t frameCount = frameTimes.size() ? frameTimes.size() : 1;
+            std::sort(frameTimes.begin(), frameTimes.end());
+            frameTimes.resize(frameCount, 0.0);
+            double frameSum = 0.0;
+            for(double time : frameTimes)
+                frameSum += time;
+
+            printf("\n----------------------\n");
+            printf("    Replay Summary:\n\n");
+            printf("Key Events      :  %lu in %.3f ms (%.0f events/s)\n", next, totalTime * 1e3,
+                   (double)next / totalTime);
+            printf("Edit Time       :  %.3f ms, %.3f us/event\n", editTime * 1e3,
+                   next ? editTime * 1e6 / (double)next : 0.0);
+            printf("Frames          :  %lu\n", frameTimes.size());
+            printf("Frame CPU Time  :  avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                   frameSum * 1e3 / (double)frameCount, frameTimes[frameCount / 2] * 1e3,
+                   frameTimes[frameCount * 99 / 100] * 1e3, frameTimes.back() * 1e3);
+            printf("Quads Laid Out  :  %lu (%.1f per frame)\n", Renderer::GetQuadsDrawn(),
+                   (double)Renderer::GetQuadsDrawn() / (double)frameCount);
+            printf("Final Text Size :  %lu bytes, %lu lines\n", GetStorage().GetText().Size(),
+                   GetStorage().GetLines().GetLineCount());
+
+            FrameStats::Summary summary;
+            FrameStats::Summarize(summary);
+            printf("Stage Averages  : ");
+            for(size_t stage = 0; stage < (size_t)FrameStage::COUNT; ++stage)
+                printf(" %s %.3f ms%s", FrameStats::GetStageName((FrameStage)stage), summary.StageAverages[stage],
+                       stage + 1 < (size_t)FrameStage::COUNT ? "," : "\n");
+        }
 
         void Start(int argc, const char** argv)
         {
-            (void)argc; (void)argv;
+            std::vector<const char*> filepaths;
+            const char* replayPath = nullptr;
+            const char* frameStatsPath = nullptr;
+            bool headless = false;
+            for(int i = 1; i < argc; ++i)
+            {
+                if(strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+                {
+                    const char* backend = argv[++i];
+                    if(strcmp(backend, "gap") == 0)
+                        s_Buffers.SetDefaultBackend(TextBackend::GAP_BUFFER);
+                    else if(strcmp(backend, "piece") == 0)
+                        s_Buffers.SetDefaultBackend(TextBackend::PIECE_TREE);
+                    else
+                        printf("Unknown text backend \'%s\', expected \'gap\' or \'piece\'.\n", backend);
+                }
+                else if(strcmp(argv[i], "--sdf") == 0)
+                    s_FontRenderMode = FontRenderMode::SDF;
+                else if(strcmp(argv[i], "--headless") == 0)
+                    headless = true;
+                else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+                    replayPath = argv[++i];
+                else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+                    Replay::StartRecording(argv[++i]);
+                else if(strcmp(argv[i], "--frame-stats") == 0 && i + 1 < argc)
+                    frameStatsPath = argv[++i];
+                else
+                    filepaths.push_back(argv[i]);
+            }
 
+            std::vector<KeyEvent> replayEvents;
+            if(replayPath && !Replay::LoadScript(replayPath, replayEvents))
+                return;
+            if(headless && !replayPath)
+            {
+                printf("Headless mode needs a script to replay, pass one with --replay.\n");
+                return;
+            }
+            s_StartTime = std::chrono::steady_clock::now();
 
-            s_Window = new EditorWindow("DCE", 960, 540);
-            
-            Renderer::Init();
+            if(headless)
+            {
+                s_Window = nullptr;
+                s_FramePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(HEADLESS_FRAME_TIME));
+                Renderer::InitHeadless();
+            }
+            else
+            {
+                s_Window = new EditorWindow("DCE", 960, 540);
+                s_WindowOpen = true;
+                s_FramePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / s_Window->GetRefreshRate()));
+                Renderer::Init();
+            }
 
-            if(argc > 1)
-                FileMan::LoadFileToEditor(std::string(argv[1]));
+            for(const char* filepath : filepaths)
+                FileMan::LoadFileToEditor(std::string(filepath));
+            if(!filepaths.empty())
+                s_Buffers.SetActive(0);
 
             s_State = EditorState::EDITING;
-            s_RegularFont = new Font("assets/fonts/Consolas.ttf", s_FontSize);
+            s_RegularFont = new Font(FONT_PATH, s_FontSize, s_FontRenderMode);
+            if(s_Window)
+            {
+                s_ContentScale = s_Window->GetContentScale();
+                ApplyZoom();
+            }
             
             Renderer::SetClearColor(0.1, 0.1, 0.1);
 
             s_Running = true;
             s_InvalidWindow = true;
+            s_Damaged = true;
+            s_LastInputTime = std::chrono::steady_clock::now();
+
+            if(headless)
+            {
+                Renderer::UpdateProjection(960.0f, 540.0f);
+                RunReplay(replayEvents);
+                FileMan::CancelLoading();
+                FileMan::FinishSaving();
+                if(frameStatsPath)
+                    FrameStats::WriteCsv(frameStatsPath);
+                delete s_RegularFont;
+                return;
+            }
 
 
             printf("\n\n\n");
@@ -52,24 +280,78 @@ namespace dce
             printf("-------------------------\n\n\n");
 
 
+            // Only redraws when something on screen changed: a key press, a
+            // resize, a blink or loading progress. Scheduler tasks get what's
+            // left of each frame, drawn or not. In between it sleeps until
+            // whichever of those timed events comes first, or a worker thread
+            // has something to pick up.
             while(s_Running)
             {
+                auto frameStart = std::chrono::steady_clock::now();
                 if(s_InvalidWindow)
                 {
                     uint32_t newWidth, newHeight;
                     s_Window->GetWindowSize(&newWidth, &newHeight);
                     Renderer::UpdateProjection((float)newWidth, (float)newHeight);
                     s_InvalidWindow = false;
+                    s_Damaged = true;
                 }
 
-                Renderer::Clear();
-                if(s_State == EditorState::EDITING)
-                    Renderer::RenderEditor();
-                else if(s_State == EditorState::FILE_MANAGER)
-                    Renderer::RenderFileManager(s_SelectedFile);
-                s_Window->WindowNextFrame();
+                if(FileMan::IsLoading(GetStorage()))
+                    s_Damaged = true;
+                if(GetStorage().GetSyntax().Update())
+                    s_Damaged = true;
+                if(GetStorage().GetSearch().Update())
+                    s_Damaged = true;
+                if(GetStorage().GetRegexSearch().Update())
+                    s_Damaged = true;
+
+                auto now = std::chrono::steady_clock::now();
+                // Buffers only shrink once typing has stopped for a while, so
+                // they never end up bouncing between sizes.
+                if(!s_Trimmed && now - s_LastInputTime > IDLE_TRIM_DELAY)
+                {
+                    s_Buffers.Trim();
+                    s_Trimmed = true;
+                }
+
+                auto deadline = UpdateCursorBlink(now);
+                if(!s_Trimmed)
+                    deadline = std::min(deadline, s_LastInputTime + IDLE_TRIM_DELAY);
+
+                if(s_Damaged)
+                {
+                    s_Damaged = false;
+                    FrameStats::BeginFrame();
+                    Renderer::Clear();
+                    if(s_State == EditorState::EDITING || s_State == EditorState::FIND)
+                        Renderer::RenderEditor();
+                    else if(s_State == EditorState::FILE_MANAGER)
+                        Renderer::RenderFileManager(s_SelectedFile);
+                    if(s_State == EditorState::FIND)
+                        Renderer::RenderFindBar(s_FindRegex);
+                    if(FrameStats::IsOverlayVisible())
+                        Renderer::RenderFrameStats();
+                    Renderer::EndFrame();
+                    {
+                        ScopedStageTimer timer(FrameStage::BACKGROUND);
+                        Scheduler::Run(frameStart + s_FramePeriod - FRAME_SLACK);
+                    }
+                    s_Window->SwapBuffers();
+                    FrameStats::EndFrame();
+                }
+                else
+                    Scheduler::Run(frameStart + s_FramePeriod - FRAME_SLACK);
+                bool busy = s_Damaged || Scheduler::HasWork();
+                s_Window->WaitEvents(busy ? 0.0 : Seconds(deadline - std::chrono::steady_clock::now()));
             }
+            FileMan::CancelLoading();
+            FileMan::FinishSaving();
+            Replay::StopRecording();
+            if(frameStatsPath)
+                FrameStats::WriteCsv(frameStatsPath);
             delete s_RegularFont;
+            s_WindowOpen = false;
             delete s_Window;
         }
 
@@ -84,7 +366,25 @@ namespace dce
             s_InvalidWindow = true;
         }
 
-        void OnKeyPress(KeyCode code, int mods, bool repeat)
+        void OnContentScale(float scale)
+        {
+            s_ContentScale = scale;
+            ApplyZoom();
+        }
+
+        void Invalidate()
+        {
+            s_Damaged = true;
+        }
+
+        void Wake()
+        {
+            if(s_WindowOpen)
+                EditorWindow::Wake();
+        }
+
+        // Printable keys only, from Space to Grave.
+        static char GetTypedChar(KeyCode code, int mods)
         {
             // FOR CONVERTING KEYS WHEN SHIFT IS HELD
             constexpr char SHIFT_KEY_CONVERSION[] =
@@ -93,9 +393,47 @@ namespace dce
                 ")!@#$%^&*(\0:\0+\0\0\0"
                 "abcdefghijklmnopqrstuvwxyz"
                 "{|}\0\0~";
+            bool isShifted = mods & (DCE_MOD_SHIFT | DCE_MOD_CAPS_LOCK);
+            return isShifted ^ (code >= KeyCode::A && code <= KeyCode::Z) ? SHIFT_KEY_CONVERSION[(uint16_t)code - ' '] : (char)code;
+        }
+
+        // Matches are only wrapped around to once the search is done, until
+        // then there may be others on the way.
+        template<typename Search>
+        static void JumpToMatch(const Search& search, bool backwards)
+        {
+            EditorStorage& storage = s_Buffers.GetActive();
+            size_t count = search.GetMatchCount();
+            size_t index = backwards ? search.FindPrevious(storage.GetCursor()) : search.FindNext(storage.GetCursor() + 1);
+            if(index == count && count && !search.IsSearching())
+                index = backwards ? count - 1 : 0;
+            if(index < count)
+                storage.SetCursor(search.GetMatch(index));
+        }
+
+        static void SetFindQuery(EditorStorage& storage)
+        {
+            if(s_FindRegex)
+                storage.GetRegexSearch().SetQuery(storage.GetText(), storage.GetLines(), s_FindQuery);
+            else
+                storage.GetSearch().SetQuery(storage.GetText(), s_FindQuery);
+        }
+
+        void OnKeyPress(KeyCode code, int mods, bool repeat)
+        {
             (void)repeat;
 
-            s_CusorBlinkTimer = DCE_CURSOR_BLINK_THRESHOLD;
+            s_LastInputTime = std::chrono::steady_clock::now();
+            s_Trimmed = false;
+            s_CursorVisible = true;
+            s_Damaged = true;
+            Replay::RecordKey({ Seconds(s_LastInputTime - s_StartTime), code, mods, repeat });
+
+            if(code == KeyCode::F3)
+            {
+                FrameStats::ToggleOverlay();
+                return;
+            }
            
             if(s_State == EditorState::FILE_MANAGER)
             {
@@ -125,43 +463,133 @@ namespace dce
             }
 
 
+            EditorStorage& storage = s_Buffers.GetActive();
+            if(s_State == EditorState::FIND)
+            {
+                if(code == KeyCode::Escape || ((mods & DCE_MOD_CONTROL) && code == KeyCode::F))
+                {
+                    storage.GetSearch().Clear();
+                    storage.GetRegexSearch().Clear();
+                    s_State = EditorState::EDITING;
+                    return;
+                }
+                if((mods & DCE_MOD_CONTROL) && code == KeyCode::R)
+                {
+                    storage.GetSearch().Clear();
+                    storage.GetRegexSearch().Clear();
+                    s_FindRegex = !s_FindRegex;
+                    SetFindQuery(storage);
+                    return;
+                }
+                if(mods & DCE_MOD_CONTROL)
+                    return;
+                if(code == KeyCode::Enter || code == KeyCode::KPEnter)
+                {
+                    if(s_FindRegex)
+                        JumpToMatch(storage.GetRegexSearch(), mods & DCE_MOD_SHIFT);
+                    else
+                        JumpToMatch(storage.GetSearch(), mods & DCE_MOD_SHIFT);
+                    return;
+                }
+                if(code >= KeyCode::Space && code <= KeyCode::Grave)
+                    s_FindQuery.push_back(GetTypedChar(code, mods));
+                else if(code == KeyCode::Backspace && !s_FindQuery.empty())
+                    s_FindQuery.pop_back();
+                else
+                    return;
+                SetFindQuery(storage);
+                return;
+            }
+
             if(mods & DCE_MOD_CONTROL)
             {
                 if(code == KeyCode::S)
-                    FileMan::SaveEditorToFile("temp.txt");
+                {
+                    const std::string& path = storage.GetFilePath();
+                    FileMan::SaveEditorToFile(path.empty() ? "untitled.txt" : path);
+                }
+                else if(code == KeyCode::Z)
+                {
+                    if(mods & DCE_MOD_SHIFT)
+                        storage.Redo();
+                    else
+                        storage.Undo();
+                }
+                else if(code == KeyCode::Y)
+                    storage.Redo();
+                else if(code == KeyCode::N)
+                {
+                    s_Buffers.Open();
+                    SwitchBuffer(s_Buffers.GetActiveIndex());
+                }
+                else if(code == KeyCode::W)
+                {
+                    FileMan::CancelLoading(storage);
+                    if(FileMan::IsSaving(storage))
+                        FileMan::FinishSaving();
+                    s_Buffers.Close(s_Buffers.GetActiveIndex());
+                    SwitchBuffer(s_Buffers.GetActiveIndex());
+                }
+                else if(code == KeyCode::Tab)
+                {
+                    size_t count = s_Buffers.GetCount();
+                    size_t offset = (mods & DCE_MOD_SHIFT) ? count - 1 : 1;
+                    SwitchBuffer((s_Buffers.GetActiveIndex() + offset) % count);
+                }
+                else if(code >= KeyCode::NUM1 && code <= KeyCode::NUM9)
+                {
+                    size_t index = (size_t)code - (size_t)KeyCode::NUM1;
+                    if(index < s_Buffers.GetCount())
+                        SwitchBuffer(index);
+                }
                 else if(code == KeyCode::D)
-                    s_Storage.PrintDebugInfo(mods & DCE_MOD_SHIFT);
+                    storage.PrintDebugInfo(mods & DCE_MOD_SHIFT);
+                else if(code == KeyCode::Equal)
+                    SetZoom(s_Zoom * ZOOM_STEP);
+                else if(code == KeyCode::Minus)
+                    SetZoom(s_Zoom / ZOOM_STEP);
+                else if(code == KeyCode::NUM0)
+                    SetZoom(1.0f);
                 else if(code == KeyCode::O)
                 {
                     s_SelectedFile = 0;
                     s_State = EditorState::FILE_MANAGER;
                 }
+                else if(code == KeyCode::F)
+                {
+                    // The last query is searched for again right away.
+                    SetFindQuery(storage);
+                    s_State = EditorState::FIND;
+                }
             }
             else if(code >= KeyCode::Space && code <= KeyCode::Grave)
-            {
-                bool isShifted = mods & (DCE_MOD_SHIFT | DCE_MOD_CAPS_LOCK);
-                s_Storage.AddChar(isShifted ^ (code >= KeyCode::A && code <= KeyCode::Z) ? SHIFT_KEY_CONVERSION[(uint16_t)code - ' '] : (char)code); 
-            }
+                storage.AddChar(GetTypedChar(code, mods));
             else if(code == KeyCode::Backspace || code == KeyCode::Delete)
-                s_Storage.RemoveChars(1, code == KeyCode::Delete);
+                storage.RemoveChars(1, code == KeyCode::Delete);
             else if(code == KeyCode::Enter)
-                s_Storage.AddChar('\n');
+                storage.NewLine();
             else if(code == KeyCode::Left)
-                s_Storage.MoveCursor(-1);
+                storage.MoveCursor(-1);
             else if(code == KeyCode::Right)
-                s_Storage.MoveCursor(1);
+                storage.MoveCursor(1);
             else if(code == KeyCode::Up)
-                s_Storage.MoveCursorLinewise(-1);
+                storage.MoveCursorLinewise(-1);
             else if(code == KeyCode::Down)
-                s_Storage.MoveCursorLinewise(1);
+                storage.MoveCursorLinewise(1);
         }
 
         EditorStorage& GetStorage()
         {
-            return s_Storage;
+            return s_Buffers.GetActive();
         }
 
-        const Font* GetRegularFont()
+        BufferRegistry& GetBuffers()
+        {
+            return s_Buffers;
+        }
+
+
+        Font* GetRegularFont()
         {
             return s_RegularFont;
         }
@@ -171,9 +599,9 @@ namespace dce
             return s_FontSize;
         }
 
-        int& GetCursorTimer()
+        bool IsCursorVisible()
         {
-            return s_CusorBlinkTimer;
+            return s_CursorVisible;
         }
 
         const EditorWindow* GetWindow()
@@ -1,8 +1,9 @@
 #ifndef _DCE_APP_H
 #define _DCE_APP_H
 
-#define DCE_CURSOR_BLINK_THRESHOLD 128
+#define DCE_CURSOR_BLINK_INTERVAL_MS 530
 
+#include "BufferRegistry.h"
 #include "EditorStorage.h"
 #include "Font.h"
 #include "KeyCodes.h"
@@ -15,6 +16,7 @@ namespace dce
     {
         EDITING,
         FILE_MANAGER,
+        FIND,
         PAUSE
     };
 
@@ -23,11 +25,20 @@ namespace dce
         void Start(int argc, const char** argv);
         void Close();
         void OnResize(uint32_t width, uint32_t height);
+        // The window moved to a monitor with a different DPI scale.
+        void OnContentScale(float scale);
         void OnKeyPress(KeyCode code, int mods, bool repeat);
         EditorStorage& GetStorage();
-        const Font* GetRegularFont();
+        BufferRegistry& GetBuffers();
+        Font* GetRegularFont();
         uint32_t GetFontSize();
-        int& GetCursorTimer();
+        // Whether the blinking cursor is in its visible phase this frame.
+        bool IsCursorVisible();
+        // Makes the main loop redraw the next time around.
+        void Invalidate();
+        // Makes the main loop come around without waiting for its timeout,
+        // for worker threads with results to pick up.
+        void Wake();
         const EditorWindow* GetWindow();
         inline float GetLineHeight() { return 1.1f * GetFontSize(); }
     }
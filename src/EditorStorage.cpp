@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Core.h"
 #include "EditorStorage.h"
 #include "Editor.h"
@@ -7,164 +9,256 @@ namespace dce
 {
     EditorStorage::EditorStorage()
     {
-        m_CharData = GapBuffer<char>(EditorStorage::INITIAL_DATA_CAP);
-        m_LineData = GapBuffer<size_t>(EditorStorage::INITIAL_LINE_CAP);
+        m_Text.reset(TextBuffer::Create(TextBackend::PIECE_TREE, EditorStorage::INITIAL_DATA_CAP));
+        m_Cursor = 0;
+        m_CursorLine = 1;
         m_CameraStartingLine = 1;
-        m_LineData.Add(0, true);
-        m_LineData.Add(0, false);
+        m_CachedHorizPos = 0;
+        m_UnindexedBytes = 0;
+        m_EditCount = 0;
     }
 
     void EditorStorage::Reset()
     {
-        m_CharData.Clear();
-        m_LineData.Clear();
+        m_Syntax.Reset();
+        m_Search.Clear();
+        m_RegexSearch.Clear();
+        m_Text->Clear();
+        m_Lines.Clear();
+        m_History.Clear();
+        m_Cursor = 0;
+        m_CursorLine = 1;
         m_CachedHorizPos = 0;
         m_CameraStartingLine = 1;
-        m_LineData.Add(0, true);
-        m_LineData.Add(0, false);
+        m_UnindexedBytes = 0;
+        ++m_EditCount;
+    }
+
+    void EditorStorage::SetBackend(TextBackend backend)
+    {
+        if(backend == m_Text->GetBackend())
+            return;
+        m_Syntax.Reset();
+        m_RegexSearch.Clear();
+        m_Text.reset(TextBuffer::Create(backend, EditorStorage::INITIAL_DATA_CAP));
+        Reset();
+    }
+
+    void EditorStorage::Trim()
+    {
+        // Cancels a parse that's under way, which is only worth it if the
+        // text actually moves.
+        if(!m_Text->CanTrim())
+            return;
+        std::unique_lock<std::mutex> lock = m_Syntax.Lock();
+        m_Text->Trim();
+        m_Syntax.OnTextMoved();
     }
 
     void EditorStorage::AddChar(char c)
     {
+        m_History.Record(UndoHistory::OpType::INSERT, m_Cursor, &c, 1);
+        InsertText(m_Cursor, &c, 1);
+        ++m_Cursor;
+
         if(c == '\n')
         {
-            m_LineData.Add(m_CharData.GapPos() + 1, true);
-            if(m_LineData.GapPos() >= m_CameraStartingLine + Renderer::GetLastLineCountDrawn())
+            ++m_CursorLine;
+            if(m_CursorLine >= m_CameraStartingLine + Renderer::GetLastLineCountDrawn())
                 ++m_CameraStartingLine;
         }
-
-        m_CharData.Add(c, true);
-        
-        for(size_t i = m_LineData.GapPos(); i < m_LineData.Size(); ++i)
-            ++m_LineData[i];
         
-        m_CachedHorizPos = m_CharData.GapPos() - m_LineData.AtRelative(-1);
+        m_CachedHorizPos = m_Cursor - m_Lines.GetLineStart(m_CursorLine - 1);
     }
 
     void EditorStorage::RemoveChars(size_t count, bool forward)
     {
-        size_t effectiveSize = forward ? m_CharData.Size() - m_CharData.GapPos() : m_CharData.GapPos();
+        size_t effectiveSize = forward ? GetEditableEnd() - m_Cursor : m_Cursor;
         if(count > effectiveSize)
             count = effectiveSize;
         if(count == 0)
             return;
 
-        size_t offset = (size_t)(!forward);
-        size_t lineCnt = offset;
-        while((forward && (m_LineData.AtRelative(lineCnt) + 1 - m_CharData.GapPos()) < count)
-            ||(!forward && (m_CharData.GapPos() - m_LineData.AtRelative(-lineCnt) < count)))
-            ++lineCnt;
-        m_LineData.Remove(lineCnt - offset, !forward);
-        m_CharData.Remove(count, !forward);
-        for(size_t i = m_LineData.GapPos(); i < m_LineData.Size(); ++i)
-            m_LineData[i] -= count;
+        size_t position = forward ? m_Cursor : m_Cursor - count;
+        std::string erased(count, '\0');
+        TextReader reader(*m_Text, position);
+        for(size_t i = 0; i < count; ++i)
+            erased[i] = reader.Next();
+        m_History.Record(forward ? UndoHistory::OpType::ERASE : UndoHistory::OpType::ERASE_BACKWARD,
+                         position, erased.data(), count);
+        EraseText(position, count);
+        m_Cursor = position;
+        m_CursorLine = m_Lines.GetLineOf(m_Cursor) + 1;
        
-        if(m_LineData.GapPos() < m_CameraStartingLine)
-            m_CameraStartingLine = m_LineData.GapPos();
+        if(m_CursorLine < m_CameraStartingLine)
+            m_CameraStartingLine = m_CursorLine;
+
+        m_CachedHorizPos = m_Cursor - m_Lines.GetLineStart(m_CursorLine - 1);
+    }
+
+    void EditorStorage::NewLine()
+    {
+        AddChar('\n');
+    }
+
+    void EditorStorage::Undo()
+    {
+        const UndoHistory::Op* op = m_History.Undo();
+        if(!op)
+            return;
+
+        if(op->Type == UndoHistory::OpType::INSERT)
+        {
+            EraseText(op->Position, op->Length);
+            PlaceCursor(op->Position);
+        }
+        else if(op->Type == UndoHistory::OpType::ERASE)
+        {
+            InsertText(op->Position, op->Data, op->Length);
+            PlaceCursor(op->Position);
+        }
+        else
+        {
+            std::string text(op->Data, op->Length);
+            std::reverse(text.begin(), text.end());
+            InsertText(op->Position, text.data(), op->Length);
+            PlaceCursor(op->Position + op->Length);
+        }
+    }
 
-        m_CachedHorizPos = m_CharData.GapPos() - m_LineData.AtRelative(-1);
+    void EditorStorage::Redo()
+    {
+        const UndoHistory::Op* op = m_History.Redo();
+        if(!op)
+            return;
+
+        if(op->Type == UndoHistory::OpType::INSERT)
+        {
+            InsertText(op->Position, op->Data, op->Length);
+            PlaceCursor(op->Position + op->Length);
+        }
+        else
+        {
+            EraseText(op->Position, op->Length);
+            PlaceCursor(op->Position);
+        }
     }
 
     void EditorStorage::SetCursor(size_t newPosition)
     {
-        if(newPosition >= m_CharData.Size())
-            newPosition = m_CharData.Size() - 1;
-        if(newPosition == m_CharData.GapPos())
+        if(newPosition >= m_Text->Size())
+            newPosition = m_Text->Size() - 1;
+        if(newPosition > GetEditableEnd())
+            newPosition = GetEditableEnd();
+        if(newPosition == m_Cursor)
             return;
-        m_CharData.SetGapPosition(newPosition);
-        m_LineData.SetGapPosition(BSLineNumber(newPosition, 0, m_LineData.Size() - 2));
-        
-        if(m_LineData.GapPos() < m_CameraStartingLine)
-            m_CameraStartingLine = m_LineData.GapPos();
-        else if(m_LineData.GapPos() >= m_CameraStartingLine + Renderer::GetLastLineCountDrawn())
-            m_CameraStartingLine = m_LineData.GapPos() - Renderer::GetLastLineCountDrawn() + 1;
+        m_History.Seal();
+        m_Cursor = newPosition;
+        m_CursorLine = m_Lines.GetLineOf(m_Cursor) + 1;
+        ScrollToCursor();
     }
 
     void EditorStorage::MoveCursor(int64_t offset)
     {
-        if(-offset > (int64_t)m_CharData.GapPos())
-            offset = -m_CharData.GapPos();
-        else if(offset > (int64_t)(m_CharData.Size() - m_CharData.GapPos()))
-            offset = m_CharData.Size() - m_CharData.GapPos();
+        if(-offset > (int64_t)m_Cursor)
+            offset = -m_Cursor;
+        else if(offset > (int64_t)(GetEditableEnd() - m_Cursor))
+            offset = GetEditableEnd() - m_Cursor;
         if(offset == 0)
             return;
-        m_CharData.MoveGapPosition(offset);
-        size_t newPosition = m_CharData.GapPos();
-        bool forward = offset >= 0;
-        if((!forward || newPosition >= m_LineData.AtRelative(0))
-        && (forward || newPosition < m_LineData.AtRelative(-1)))
-            m_LineData.SetGapPosition(BSLineNumber(newPosition, 
-                                            (forward ? m_LineData.GapPos() : 0), 
-                                            (forward ? m_LineData.Size() - 2 : m_LineData.GapPos() - 1)));
-
-        if(m_LineData.GapPos() < m_CameraStartingLine)
-            m_CameraStartingLine = m_LineData.GapPos();
-        else if(m_LineData.GapPos() >= m_CameraStartingLine + Renderer::GetLastLineCountDrawn())
-            m_CameraStartingLine = m_LineData.GapPos() - Renderer::GetLastLineCountDrawn() + 1;
-        
-        m_CachedHorizPos = m_CharData.GapPos() - m_LineData.AtRelative(-1);
+        PlaceCursor(m_Cursor + (size_t)offset);
     }
 
 
     void EditorStorage::MoveCursorLinewise(int64_t lineOffset)
     {
+        size_t lineCount = m_Lines.GetLineCount();
         size_t lineNum;
-        if(-lineOffset >= (int64_t)m_LineData.GapPos())
+        if(-lineOffset >= (int64_t)m_CursorLine)
         {
             lineNum = 1;
             m_CachedHorizPos = 0;
         }
-        else if(lineOffset >= (int64_t)(m_LineData.Size() - m_LineData.GapPos()))
+        else if(lineOffset > (int64_t)(lineCount - m_CursorLine))
         {
-            lineNum = m_LineData.Size() - 1;
-            m_CachedHorizPos = m_LineData[m_LineData.Size() - 1] - m_LineData[m_LineData.Size() - 2];
+            lineNum = lineCount;
+            m_CachedHorizPos = m_Lines.GetLineLength(lineCount - 1);
         }
         else
-            lineNum = m_LineData.GapPos() + (size_t)lineOffset;
+            lineNum = m_CursorLine + (size_t)lineOffset;
         
 
-        size_t triedPos = m_LineData[lineNum - 1] + m_CachedHorizPos;
-        size_t otherPos = m_LineData[lineNum] - (lineNum != m_LineData.Size() - 1);
-        m_CharData.SetGapPosition((triedPos <= otherPos) ? triedPos : otherPos);
-        m_LineData.SetGapPosition(lineNum);
-        if(lineNum < m_CameraStartingLine)
-            m_CameraStartingLine = lineNum;
-        else if(lineNum >= m_CameraStartingLine + Renderer::GetLastLineCountDrawn())
-            m_CameraStartingLine = lineNum - Renderer::GetLastLineCountDrawn() + 1;
+        size_t lineStart = m_Lines.GetLineStart(lineNum - 1);
+        size_t triedPos = lineStart + m_CachedHorizPos;
+        size_t otherPos = lineStart + m_Lines.GetLineLength(lineNum - 1) - (lineNum != lineCount);
+        m_Cursor = (triedPos <= otherPos) ? triedPos : otherPos;
+        if(m_Cursor > GetEditableEnd())
+            m_Cursor = GetEditableEnd();
+        m_CursorLine = lineNum;
+        m_History.Seal();
+        ScrollToCursor();
+    }
 
+    void EditorStorage::InsertText(size_t position, const char* data, size_t count)
+    {
+        std::unique_lock<std::mutex> lock = m_Syntax.Lock();
+        m_Syntax.OnInsert(*m_Text, m_Lines, position, data, count);
+        m_Text->Insert(position, data, count);
+        m_Lines.OnInsert(position, data, count);
+        m_Search.OnInsert(position, count);
+        m_RegexSearch.OnInsert(position, count);
+        ++m_EditCount;
     }
 
-    size_t EditorStorage::BSLineNumber(size_t cursorPosition, size_t lo, size_t hi)
+    void EditorStorage::EraseText(size_t position, size_t count)
     {
-        DCE_ASSERT(lo <= hi && hi < m_LineData.Size(), "Invalid parameters.\n");
-        while(lo <= hi)
-        {
-            size_t mid = (lo + hi) >> 1;
-            if(m_LineData[mid] > cursorPosition)
-                hi = mid - 1;
-            else if(m_LineData[mid + 1] < cursorPosition)
-                lo = mid + 1;
-            else
-                return mid + 1 + (m_LineData[mid] != cursorPosition && m_LineData[mid + 1] == cursorPosition);
-        }
-        return (size_t)-1;
+        std::unique_lock<std::mutex> lock = m_Syntax.Lock();
+        m_Syntax.OnErase(*m_Text, m_Lines, position, count);
+        m_Lines.OnErase(position, count);
+        m_Text->Erase(position, count);
+        m_Search.OnErase(position, count);
+        m_RegexSearch.OnErase(position, count);
+        ++m_EditCount;
+    }
+
+    void EditorStorage::PlaceCursor(size_t position)
+    {
+        m_History.Seal();
+        m_Cursor = position;
+        m_CursorLine = m_Lines.GetLineOf(m_Cursor) + 1;
+        ScrollToCursor();
+        m_CachedHorizPos = m_Cursor - m_Lines.GetLineStart(m_CursorLine - 1);
+    }
+
+    void EditorStorage::ScrollToCursor()
+    {
+        if(m_CursorLine < m_CameraStartingLine)
+            m_CameraStartingLine = m_CursorLine;
+        else if(m_CursorLine >= m_CameraStartingLine + Renderer::GetLastLineCountDrawn())
+            m_CameraStartingLine = m_CursorLine - Renderer::GetLastLineCountDrawn() + 1;
     }
 
     void EditorStorage::PrintDebugInfo(bool lineInfo) const
     {
         printf("\n----------------------\n");
         printf("    Debug Info:\n\n");
-        printf("Character Count :  %lu\n", m_CharData.Size());
-        printf("Cursor Position :  %lu\n", m_CharData.GapPos());
-        printf("Line Number     :  %lu\n", m_LineData.GapPos());
+        printf("Text Backend    :  %s\n", TextBuffer::GetBackendName(m_Text->GetBackend()));
+        printf("Character Count :  %lu\n", m_Text->Size());
+        printf("Cursor Position :  %lu\n", m_Cursor);
+        printf("Line Number     :  %lu\n", m_CursorLine);
+        printf("Line Count      :  %lu\n", m_Lines.GetLineCount());
+        printf("Line Index Size :  %lu bytes\n", m_Lines.GetMemoryUsage());
+        printf("Unindexed Bytes :  %lu\n", m_UnindexedBytes);
+        printf("Undo History    :  %lu/%lu ops, %lu bytes\n", m_History.GetUndoCount(), m_History.GetOpCount(),
+               m_History.GetMemoryUsage());
         printf("Camera Start    :  %lu\n", m_CameraStartingLine);
         printf("Lines To Draw   :  %lu\n", Renderer::GetLastLineCountDrawn());
         if(lineInfo)
         {
             printf("Lines:\n");
-            for(size_t i = 0; i < m_LineData.Size() - 1; ++i)
-                printf("Line %lu: Starts - %lu     Size - %lu\n", i + 1, m_LineData[i], m_LineData[i + 1] - m_LineData[i]);
-            printf("End of File: %lu\n", m_LineData[m_LineData.Size() - 1]);
+            for(size_t i = 0; i < m_Lines.GetLineCount(); ++i)
+                printf("Line %lu: Starts - %lu     Size - %lu\n", i + 1, m_Lines.GetLineStart(i), m_Lines.GetLineLength(i));
+            printf("End of File: %lu\n", m_Lines.GetTextSize());
         }
     }
 }
@@ -1,9 +1,14 @@
 #ifndef _DCE_EDITOR_H
 #define _DCE_EDITOR_H
 
+#include <memory>
 #include <string>
 
-#include "GapBuffer.h"
+#include "LineIndex.h"
+#include "Search.h"
+#include "Syntax.h"
+#include "TextBuffer.h"
+#include "UndoHistory.h"
 
 namespace dce
 {
@@ -14,31 +19,73 @@ namespace dce
         ~EditorStorage() = default;
 
         void Reset();
+        void SetBackend(TextBackend backend);
+        // Gives back the text buffer's spare memory, under the highlighter's
+        // lock since its worker may be reading the text.
+        void Trim();
         void AddChar(char c);
         void RemoveChars(size_t count, bool forward);
         void NewLine();
+        void Undo();
+        void Redo();
         void SetCursor(size_t newPosition);
         void MoveCursor(int64_t offset);
         void MoveCursorLinewise(int64_t lineOffset);
-        inline void SetFilePath(const std::string& newPath) { m_FilePath = newPath; }
-        inline GapBuffer<char>& GetCharData() { return m_CharData; }
-        inline GapBuffer<size_t>& GetLineData() { return m_LineData; }
-        inline const GapBuffer<char>& GetCharData() const { return m_CharData; }
-        inline const GapBuffer<size_t>& GetLineData() const { return m_LineData; }
+        inline void SetFilePath(const std::string& newPath)
+        {
+            m_FilePath = newPath;
+            m_Syntax.SetLanguage(newPath);
+        }
+        // Bytes at the end of the text that the line index doesn't know about
+        // yet. The cursor and edits are kept out of them until they are.
+        inline void SetUnindexedBytes(size_t count)
+        {
+            m_UnindexedBytes = count;
+            m_RegexSearch.SetUnindexedBytes(count);
+        }
+        inline size_t GetEditableEnd() const { return m_Text->Size() - m_UnindexedBytes; }
+        inline const std::string& GetFilePath() const { return m_FilePath; }
+        inline TextBuffer& GetText() { return *m_Text; }
+        inline LineIndex& GetLines() { return m_Lines; }
+        inline const TextBuffer& GetText() const { return *m_Text; }
+        inline const LineIndex& GetLines() const { return m_Lines; }
+        inline const UndoHistory& GetHistory() const { return m_History; }
+        inline SyntaxHighlighter& GetSyntax() { return m_Syntax; }
+        inline TextSearch& GetSearch() { return m_Search; }
+        inline const TextSearch& GetSearch() const { return m_Search; }
+        inline RegexSearch& GetRegexSearch() { return m_RegexSearch; }
+        inline const RegexSearch& GetRegexSearch() const { return m_RegexSearch; }
+        // Goes up with every change to the text.
+        inline uint64_t GetEditCount() const { return m_EditCount; }
+        inline size_t GetCursor() const { return m_Cursor; }
+        inline size_t GetCursorLine() const { return m_CursorLine; }
         inline size_t GetCameraStartLine() const { return m_CameraStartingLine; }
 
         void PrintDebugInfo(bool lineInfo) const;
     public:
         static constexpr size_t INITIAL_DATA_CAP = 0x10000ul;
-        static constexpr size_t INITIAL_LINE_CAP = 0x1000ul;
     private:
-        size_t BSLineNumber(size_t cursorPosition, size_t lo, size_t hi);
+        // Every change to the text goes through these two.
+        void InsertText(size_t position, const char* data, size_t count);
+        void EraseText(size_t position, size_t count);
+        void PlaceCursor(size_t position);
+        void ScrollToCursor();
     private:
-        GapBuffer<char> m_CharData;
-        GapBuffer<size_t> m_LineData;
+        std::unique_ptr<TextBuffer> m_Text;
+        LineIndex m_Lines;
+        UndoHistory m_History;
+        TextSearch m_Search;
+        // After the text, its workers are waited for before the text goes away.
+        RegexSearch m_RegexSearch;
+        size_t m_Cursor;
+        size_t m_CursorLine;
         size_t m_CameraStartingLine;
         size_t m_CachedHorizPos;
+        size_t m_UnindexedBytes;
+        uint64_t m_EditCount;
         std::string m_FilePath;
+        // Last, so it stops parsing before the text goes away.
+        SyntaxHighlighter m_Syntax;
     };
 
 
@@ -1,13 +1,25 @@
+#include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
-#include <fstream>
+#include <cerrno>
+#include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "FileManager.h"
 #include "Core.h"
+#include "BufferRegistry.h"
 #include "Editor.h"
+#include "MappedFile.h"
+#include "Scheduler.h"
+#include "TextScan.h"
 
 
 namespace dce
@@ -17,74 +29,451 @@ namespace dce
         static DirContents s_CachedContents; 
         static bool s_IsCached;
 
-        void LoadFileToEditor(const std::string& filepath)
+        // Large files are indexed on a worker thread in chunks that get merged
+        // into the line index a slice at a time in what's left of each frame,
+        // so the first screen shows up right away. Everything past the merged
+        // part sits in the last line. Every buffer being loaded has a worker
+        // and a Scheduler task of its own.
+        struct LoadedChunk
         {
-            std::ifstream is(filepath, std::ios::ate | std::ios::binary);
-            if(!is)
+            std::vector<size_t> Lengths;
+            size_t Size; // Bytes of the chunk not merged yet.
+            size_t Merged; // Lines merged so far.
+        };
+
+        struct LoadState
+        {
+            EditorStorage* Storage;
+            std::thread Thread;
+            std::mutex Mutex;
+            std::deque<LoadedChunk> LoadedChunks;
+            std::atomic<bool> Cancel;
+            std::deque<LoadedChunk> MergingChunks; // Only touched by the main thread.
+            MappedFile File; // Only used when the text buffer copied the file.
+            size_t Size;
+            size_t Remaining;
+            Scheduler::TaskID Task;
+        };
+
+        static std::vector<std::unique_ptr<LoadState>> s_Loads;
+
+        // Saving hands the spans of the text buffer to a worker thread, which
+        // writes them out, syncs the file and renames it over the target. Spans
+        // of backends that move their text around on edits are written out
+        // right away instead and only the rest is left to the worker.
+        static EditorStorage* s_SaveStorage; // Buffer being saved, if any.
+        static std::string s_SavePath;
+        static std::string s_SaveTempPath;
+        static int s_SaveFile;
+        static size_t s_SaveSize;
+        static std::thread s_SaveThread;
+        static std::atomic<bool> s_SaveSynced;
+        static int s_SaveError; // Written by the worker before s_SaveSynced.
+        static Scheduler::TaskID s_SaveTask;
+
+        static void IndexFileAsync(LoadState* load, const char* data, size_t offset, size_t size)
+        {
+            while(offset < size && !load->Cancel.load(std::memory_order_relaxed))
             {
-                printf("Unable to open file: %s\n", filepath.c_str());
+                size_t chunkSize = std::min(LOAD_CHUNK_SIZE, size - offset);
+                LoadedChunk chunk;
+                chunk.Size = chunkSize;
+                chunk.Merged = 0;
+                TextScan::ScanLineLengthsParallel(data + offset, chunkSize, chunk.Lengths);
+                MappedFile::DropResidentPages(data + offset, chunkSize);
+                offset += chunkSize;
+
+                {
+                    std::lock_guard<std::mutex> lock(load->Mutex);
+                    load->LoadedChunks.push_back(std::move(chunk));
+                }
+                Editor::Wake();
+            }
+        }
+
+        // Merges LOAD_MERGE_LINES lines at a time until the deadline, returns
+        // whether the whole chunk made it in. At least one slice is merged.
+        static bool MergeLoadedChunk(LoadState& load, LoadedChunk& chunk, Scheduler::Clock::time_point deadline)
+        {
+            LineIndex& lines = load.Storage->GetLines();
+            // Growing the index as lines come in would now and then copy all
+            // of it within one slice, so there's room made for as many lines
+            // as the rest of the file looks like it has.
+            if(lines.GetCapacity() < lines.GetLineCount() + chunk.Lengths.size() - chunk.Merged)
+            {
+                double linesPerByte = (double)(chunk.Lengths.size() - chunk.Merged) / (double)chunk.Size;
+                size_t projected = lines.GetLineCount() + (size_t)(linesPerByte * (double)load.Remaining);
+                lines.Reserve(projected + projected / 4);
+            }
+            while(chunk.Merged < chunk.Lengths.size())
+            {
+                size_t* lengths = chunk.Lengths.data() + chunk.Merged;
+                size_t count = std::min(LOAD_MERGE_LINES, chunk.Lengths.size() - chunk.Merged);
+                size_t size = 0;
+                for(size_t i = 0; i < count; ++i)
+                    size += lengths[i];
+
+                // The first line continues whatever is already indexed of the
+                // last line, which may have been edited in the meantime.
+                size_t lastLine = lines.GetLineCount() - 1;
+                lengths[0] += lines.GetLineLength(lastLine) - load.Remaining;
+                lines.SplitLastLine(lengths, count);
+                chunk.Merged += count;
+                chunk.Size -= size;
+                load.Remaining -= size;
+                load.Storage->SetUnindexedBytes(load.Remaining);
+                if(chunk.Merged < chunk.Lengths.size() && Scheduler::Clock::now() >= deadline)
+                    return false;
+            }
+            load.Remaining -= chunk.Size;
+            chunk.Size = 0;
+            load.Storage->SetUnindexedBytes(load.Remaining);
+            return true;
+        }
+
+        static LoadState* FindLoad(const EditorStorage& storage)
+        {
+            for(std::unique_ptr<LoadState>& load : s_Loads)
+            {
+                if(load->Storage == &storage)
+                    return load.get();
+            }
+            return nullptr;
+        }
+
+        static void RemoveLoad(LoadState* load)
+        {
+            s_Loads.erase(std::find_if(s_Loads.begin(), s_Loads.end(),
+                                       [load](const std::unique_ptr<LoadState>& other) { return other.get() == load; }));
+        }
+
+        static TaskStatus UpdateLoading(LoadState& load, Scheduler::Clock::time_point deadline)
+        {
+            {
+                std::lock_guard<std::mutex> lock(load.Mutex);
+                for(LoadedChunk& chunk : load.LoadedChunks)
+                    load.MergingChunks.push_back(std::move(chunk));
+                load.LoadedChunks.clear();
+            }
+            while(!load.MergingChunks.empty())
+            {
+                if(!MergeLoadedChunk(load, load.MergingChunks.front(), deadline))
+                    return TaskStatus::YIELDED;
+                load.MergingChunks.pop_front();
+                if(!load.MergingChunks.empty() && Scheduler::Clock::now() >= deadline)
+                    return TaskStatus::YIELDED;
+            }
+            if(load.Remaining != 0)
+                return TaskStatus::BLOCKED;
+
+            if(load.Thread.joinable())
+                load.Thread.join();
+            printf("File \'%s\' fully indexed: %lu lines.\n", load.Storage->GetFilePath().c_str(),
+                   load.Storage->GetLines().GetLineCount());
+            RemoveLoad(&load);
+            return TaskStatus::DONE;
+        }
+
+        void LoadFileToEditor(const std::string& path)
+        {
+            // Buffers are told apart by their path, so it has to be the same
+            // no matter which directory the file was opened from.
+            char* resolved = realpath(path.c_str(), nullptr);
+            std::string filepath = resolved ? resolved : path;
+            free(resolved);
+
+            BufferRegistry& buffers = Editor::GetBuffers();
+            size_t existing = buffers.Find(filepath);
+            if(existing != buffers.GetCount())
+            {
+                buffers.SetActive(existing);
                 return;
             }
 
-            long size = is.tellg();
-            is.seekg(0, std::ios::beg);
-            if(size == -1L)
+            struct stat statbuf;
+            if(stat(filepath.c_str(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode))
             {
-                printf("Error reading file: %s\n", filepath.c_str());
-                is.close();
+                printf("Unable to open file: %s\n", filepath.c_str());
                 return;
             }
-            else if(size == 0)
+            else if(statbuf.st_size == 0)
             {
                 printf("File was empty.\n");
-                is.close();
                 return;
             }
 
-            EditorStorage& storage = Editor::GetStorage();
-            GapBuffer<char>& charData = storage.GetCharData();
-            GapBuffer<size_t>& lineData = storage.GetLineData();
-            storage.Reset();
-            charData.EnsureCapacity(size + (size >> 1));
-            
-            constexpr size_t READ_BUFFER_SIZE = 4096;
-            char fileBuffer[READ_BUFFER_SIZE];
-            is.read(fileBuffer, READ_BUFFER_SIZE);
-            while(is.gcount())
+            MappedFile file;
+            if(!file.Open(filepath))
             {
-                charData.Add(fileBuffer, is.gcount(), true);
-                is.read(fileBuffer, READ_BUFFER_SIZE);
+                printf("Error reading file: %s\n", filepath.c_str());
+                return;
             }
-            charData.SetGapPosition(0);
 
-            printf("File \'%s\' successfully opened: %lu of %lu bytes read.\n", filepath.c_str(), size, size);
+            FinishSaving();
+            size_t size = file.Size();
+            const char* data = file.Data();
 
-            for(size_t i = charData.Size(); i > 0; )
-                if(charData[--i] == '\n')
-                    lineData.Add(i + 1, false);
-            
-            lineData[lineData.Size() - 1] = charData.Size();
+            // An untouched empty buffer is reused, otherwise the file gets a
+            // buffer of its own.
+            EditorStorage* target = &buffers.GetActive();
+            if(!target->GetFilePath().empty() || target->GetText().Size() != 0)
+                target = &buffers.Open();
+            EditorStorage& storage = *target;
+            storage.Reset();
+            TextBuffer& text = storage.GetText();
             storage.SetFilePath(filepath);
 
-            is.close();
+            if(size < MAPPED_LOAD_THRESHOLD)
+            {
+                std::vector<size_t> lineLengths;
+                TextScan::BuildLineLengths(data, size, lineLengths);
+                memcpy(text.Load(size), data, size);
+                storage.GetLines().Build(lineLengths.data(), lineLengths.size());
+                printf("File \'%s\' successfully opened: %lu bytes, %lu lines.\n", filepath.c_str(),
+                       size, lineLengths.size());
+                return;
+            }
+
+            // Large files stay mapped and become the original contents of the
+            // text buffer, so only edited text ever ends up on the heap. Backends
+            // that need their own copy still get indexed from the mapping, which
+            // then lives until indexing is done.
+            file.AdviseSequential();
+            s_Loads.emplace_back(new LoadState());
+            LoadState& load = *s_Loads.back();
+            bool mapped = text.LoadMapped(file);
+            if(!mapped)
+            {
+                memcpy(text.Load(size), data, size);
+                load.File = std::move(file);
+            }
+
+            // Whatever fits on the first screen is indexed before returning.
+            size_t firstSize = std::min(LOAD_FIRST_CHUNK_SIZE, size);
+            LoadedChunk first;
+            first.Size = firstSize;
+            first.Merged = 0;
+            TextScan::ScanLineLengths(data, firstSize, first.Lengths);
+            size_t lastLine = size;
+            storage.GetLines().Build(&lastLine, 1);
+            load.Storage = &storage;
+            load.Size = size;
+            load.Remaining = size;
+            MergeLoadedChunk(load, first, Scheduler::Clock::time_point::max());
+
+            load.Cancel = false;
+            load.Thread = std::thread(IndexFileAsync, &load, data, firstSize, size);
+            load.Task = Scheduler::Post([&load](Scheduler::Clock::time_point deadline) { return UpdateLoading(load, deadline); });
+            printf("File \'%s\' successfully %s: %lu bytes, indexing lines in the background.\n",
+                   filepath.c_str(), mapped ? "mapped" : "opened", size);
+        }
+
+        static void CancelLoading(LoadState* load)
+        {
+            load->Cancel = true;
+            if(load->Thread.joinable())
+                load->Thread.join();
+            load->Storage->SetUnindexedBytes(0);
+            Scheduler::Cancel(load->Task);
+            RemoveLoad(load);
+        }
+
+        void CancelLoading(const EditorStorage& storage)
+        {
+            if(LoadState* load = FindLoad(storage))
+                CancelLoading(load);
+        }
+
+        void CancelLoading()
+        {
+            while(!s_Loads.empty())
+                CancelLoading(s_Loads.back().get());
+        }
+
+        bool IsLoading(const EditorStorage& storage)
+        {
+            return FindLoad(storage) != nullptr;
+        }
+
+        bool IsLoading()
+        {
+            return !s_Loads.empty();
+        }
+
+        float GetLoadProgress(const EditorStorage& storage)
+        {
+            LoadState* load = FindLoad(storage);
+            if(!load)
+                return 1.0f;
+            return 1.0f - (float)load->Remaining / (float)load->Size;
         }
         
+        // Writes every iovec completely, picking up where a short write left off.
+        static bool WriteAll(int fd, struct iovec* iov, int count)
+        {
+            while(count > 0)
+            {
+                ssize_t written = writev(fd, iov, count);
+                if(written < 0)
+                {
+                    if(errno == EINTR)
+                        continue;
+                    return false;
+                }
+                while(count > 0 && (size_t)written >= iov->iov_len)
+                {
+                    written -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if(count > 0)
+                {
+                    iov->iov_base = (char*)iov->iov_base + written;
+                    iov->iov_len -= written;
+                }
+            }
+            return true;
+        }
+
+        static bool WriteSpans(int fd, const std::vector<TextSpan>& spans)
+        {
+            struct iovec iov[SAVE_IOV_COUNT];
+            for(size_t i = 0; i < spans.size(); )
+            {
+                int iovCount = 0;
+                for(; iovCount < SAVE_IOV_COUNT && i < spans.size(); ++i)
+                    iov[iovCount++] = { (void*)spans[i].Data, spans[i].Size };
+                if(!WriteAll(fd, iov, iovCount))
+                    return false;
+            }
+            return true;
+        }
+
+        static void WriteSavedFileAsync(int fd, std::vector<TextSpan> spans, std::string tempPath,
+                                        std::string filepath)
+        {
+            int error = 0;
+            if(!WriteSpans(fd, spans))
+                error = errno;
+            if(!error && fdatasync(fd) != 0)
+                error = errno;
+            if(close(fd) != 0 && !error)
+                error = errno;
+            if(!error && rename(tempPath.c_str(), filepath.c_str()) != 0)
+                error = errno;
+
+            // The rename itself only becomes durable once the directory is synced.
+            if(!error)
+            {
+                size_t slash = filepath.find_last_of('/');
+                std::string dirPath = slash == std::string::npos ? "." : filepath.substr(0, slash + 1);
+                int dirFd = open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if(dirFd >= 0)
+                {
+                    fsync(dirFd);
+                    close(dirFd);
+                }
+            }
+            s_SaveError = error;
+            s_SaveSynced.store(true, std::memory_order_release);
+            Editor::Wake();
+        }
+
+        static void FailSaving(int error)
+        {
+            printf("Unable to save file \'%s\': %s\n", s_SavePath.c_str(), strerror(error));
+            unlink(s_SaveTempPath.c_str());
+            s_SaveStorage = nullptr;
+            s_SaveTask = Scheduler::NO_TASK;
+        }
+
+        static void StartWritingAsync(std::vector<TextSpan> spans)
+        {
+            s_SaveSynced = false;
+            s_SaveThread = std::thread(WriteSavedFileAsync, s_SaveFile, std::move(spans), s_SaveTempPath, s_SavePath);
+        }
+
+        static TaskStatus UpdateSaving(Scheduler::Clock::time_point)
+        {
+            if(!s_SaveSynced.load(std::memory_order_acquire))
+                return TaskStatus::BLOCKED;
+            if(s_SaveThread.joinable())
+                s_SaveThread.join();
+            if(s_SaveError)
+            {
+                FailSaving(s_SaveError);
+                return TaskStatus::DONE;
+            }
+            s_SaveStorage->SetFilePath(s_SavePath);
+            printf("Successfully wrote %lu bytes to file \'%s\'.\n", s_SaveSize, s_SavePath.c_str());
+            s_SaveStorage = nullptr;
+            s_SaveTask = Scheduler::NO_TASK;
+            return TaskStatus::DONE;
+        }
+
+        // The text goes to a temporary file next to the target which then gets
+        // renamed over it, so a crash at any point leaves either the old or the
+        // new contents on disk. Either way the text is saved as it is now,
+        // edits made while the worker is busy don't make it in.
         void SaveEditorToFile(const std::string& filepath)
         {
-            std::ofstream os(filepath, std::ios::binary);
-            if(!os) 
+            FinishSaving();
+            std::string tempPath = filepath + ".dce-XXXXXX";
+            int fd = mkstemp(&tempPath[0]);
+            if(fd < 0)
             {
-                printf("Unable to open file: %s\n", filepath.c_str());
+                printf("Unable to open file: %s\n", tempPath.c_str());
                 return;
             }
 
-            EditorStorage& storage = Editor::GetStorage();
-            GapBuffer<char>& charData = storage.GetCharData();
-            os.write(charData.Data(), charData.GapPos());
-            os.write(charData.At(charData.GapPos()), charData.Size() - charData.GapPos());
+            // mkstemp always creates the file as 0600, keep the original mode.
+            struct stat statbuf;
+            mode_t mode = 0644;
+            if(stat(filepath.c_str(), &statbuf) == 0)
+                mode = statbuf.st_mode & 07777;
+            fchmod(fd, mode);
+
+            s_SaveStorage = &Editor::GetStorage();
+            s_SavePath = filepath;
+            s_SaveTempPath = tempPath;
+            s_SaveFile = fd;
+            const TextBuffer& text = s_SaveStorage->GetText();
+            s_SaveSize = text.Size();
+            std::vector<TextSpan> spans;
+            for(size_t position = 0; position < text.Size(); position += spans.back().Size)
+                spans.push_back(text.SpanAt(position));
+            if(!text.HasStableSpans())
+            {
+                // The next edit moves these, a gap buffer only has two of them
+                // and they go out in a single writev.
+                if(!WriteSpans(fd, spans))
+                {
+                    int error = errno;
+                    close(fd);
+                    FailSaving(error);
+                    return;
+                }
+                spans.clear();
+            }
+            StartWritingAsync(std::move(spans));
+            s_SaveTask = Scheduler::Post(UpdateSaving);
+        }
 
-            printf("Successfully wrote %lu bytes to file \'%s\'.\n", charData.Size(), filepath.c_str());
-            os.close();
+        void FinishSaving()
+        {
+            if(!s_SaveStorage)
+                return;
+            Scheduler::Cancel(s_SaveTask);
+            while(UpdateSaving(Scheduler::Clock::time_point::max()) == TaskStatus::BLOCKED)
+            {
+                if(s_SaveThread.joinable())
+                    s_SaveThread.join();
+            }
+        }
+
+        bool IsSaving(const EditorStorage& storage)
+        {
+            return s_SaveStorage == &storage;
         }
 
         static bool SortDirContents(const DirInfo& i1, const DirInfo& i2)
@@ -24,11 +24,36 @@ namespace dce
 {
     namespace FileMan
     {
+        // Opens the file in a buffer of its own, or switches to it if it is
+        // already open. Files of at least MAPPED_LOAD_THRESHOLD bytes are only
+        // indexed up to the first screen before this returns, the rest is
+        // merged by a Scheduler task as the worker thread gets to it. Several
+        // files can be indexed at once, each in its own buffer.
         void LoadFileToEditor(const std::string& filepath);
+        // Stops indexing the buffer, or every buffer.
+        void CancelLoading(const EditorStorage& storage);
+        void CancelLoading();
+        bool IsLoading(const EditorStorage& storage);
+        bool IsLoading();
+        float GetLoadProgress(const EditorStorage& storage);
+        // Saves the active buffer in the background, one save at a time.
         void SaveEditorToFile(const std::string& filepath);
+        // Completes a save in progress before returning.
+        void FinishSaving();
+        bool IsSaving(const EditorStorage& storage);
         const DirContents& GetDirContents();
         void ClearDirContents();
         bool OpenPathFromDir(size_t index);
+
+        // Files at least this large are mapped instead of copied when the text
+        // backend supports it.
+        static constexpr size_t MAPPED_LOAD_THRESHOLD = 0x100000ul;
+        static constexpr size_t LOAD_FIRST_CHUNK_SIZE = 0x10000ul;
+        static constexpr size_t LOAD_CHUNK_SIZE = 0x2000000ul;
+        // Lines merged into the line index per slice of loading.
+        static constexpr size_t LOAD_MERGE_LINES = 0x4000ul;
+        // Spans handed to a single writev, well below any IOV_MAX.
+        static constexpr int SAVE_IOV_COUNT = 256;
     }
 }
 
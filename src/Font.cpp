@@ -1,135 +1,469 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
 #include "Font.h"
 #include "Core.h"
+#include "FontCache.h"
+#include "Hash.h"
 #include "Renderer.h"
+#include "Utf8.h"
 
 
 namespace dce
 {
     static FT_Library s_Lib = nullptr;
 
-    Font::Font(const std::string& filepath, uint32_t fontSize)
+    static FT_Render_Mode GetFreeTypeRenderMode(FontRenderMode mode)
     {
-        int error_code; (void)error_code;
-        if (!s_Lib)
+        return mode == FontRenderMode::SDF ? FT_RENDER_MODE_SDF : FT_RENDER_MODE_NORMAL;
+    }
+
+    // Loads and renders the glyph at index into the face's glyph slot.
+    static bool RenderGlyph(FT_Face face, FontRenderMode mode, uint32_t index)
+    {
+        if (mode == FontRenderMode::BITMAP)
+            return FT_Load_Glyph(face, index, FT_LOAD_RENDER) == 0;
+        return FT_Load_Glyph(face, index, FT_LOAD_DEFAULT) == 0 &&
+               FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF) == 0;
+    }
+
+    Font::Font(const std::string& filepath, uint32_t fontSize, FontRenderMode mode)
+    {
+        DCE_ASSURE_OR_EXIT(m_FontFile.Open(filepath),
+                           "Unable to load font at path \'%s\'.\n",
+                           filepath.c_str());
+        m_Face = nullptr;
+        m_FontSize = fontSize;
+        m_RenderMode = mode;
+
+        // A row of 16 glyphs fits across, which leaves most of the atlas to
+        // glyphs outside of ASCII.
+        m_AtlasWidth = ATLAS_MIN_SIZE;
+        while (m_AtlasWidth < fontSize << 4 && m_AtlasWidth < 4096)
+            m_AtlasWidth <<= 1;
+        m_AtlasHeight = m_AtlasWidth;
+        // Distances are interpolated, coverage is sampled as is.
+        m_AtlasRendererID = Renderer::CreateFontTexture(m_AtlasWidth, m_AtlasHeight, mode == FontRenderMode::SDF);
+
+        m_Glyphs.resize(MAX_GLYPHS);
+        m_GlyphShelves.assign(MAX_GLYPHS, NO_SHELF);
+        m_GlyphCodepoints.assign(MAX_GLYPHS, 0);
+        m_ShelvesBottom = 0;
+        m_Frame = 1;
+        m_Generation = 0;
+        m_FallbackGlyph = '?' - '!';
+        m_Pixels.assign((size_t)m_AtlasWidth * m_AtlasHeight, 0);
+        m_DirtyTop = m_AtlasHeight;
+        m_DirtyBottom = 0;
+        m_DirtyFirstGlyph = MAX_GLYPHS;
+        m_DirtyEndGlyph = 0;
+
+        const uint64_t fontHash = HashBytes(m_FontFile.Data(), m_FontFile.Size());
+        if (!LoadCachedAtlas(fontHash))
+            BakeAtlas(fontHash);
+
+        for (uint32_t c = 0; c < 0x80; ++c)
         {
-            error_code = FT_Init_FreeType(&s_Lib);
-            DCE_ASSURE_OR_EXIT(error_code == 0, "FreeType Error (Code %d): Unable to initialize FreeType library.\n", error_code);
+            bool printable = c >= '!' && c <= '~';
+            m_AsciiGlyphs[c] = printable ? c - '!' : m_FallbackGlyph;
+            if (printable)
+                m_GlyphCodepoints[c - '!'] = c;
         }
+        for (size_t i = MAX_GLYPHS; i > PINNED_GLYPH_CNT; --i)
+            m_FreeGlyphs.push_back((uint32_t)i - 1);
+        FlushUploads();
+    }
 
-        FT_Face face;
-        error_code = FT_New_Face(s_Lib, filepath.c_str(), 0, &face);
-        DCE_ASSERT(error_code == 0, 
-                   "FreeType Error: Unable to load font at path \'%s\'.\n", 
-                   filepath.c_str());
-        
-        error_code = FT_Set_Pixel_Sizes(face, 0, fontSize);
-        DCE_ASSERT(error_code == 0, "FreeType Error: Unable to set font size.\n");
+    Font::~Font()
+    {
+        if (m_Face)
+            FT_Done_Face(m_Face);
+        Renderer::DestroyFontTexture(m_AtlasRendererID);
+    }
 
-        m_AtlasWidth = 0;
-        m_AtlasHeight = 0;
-        m_FontMetrics.Descender = face->bbox.yMin >> 6;
-        
-        const size_t cutoff = (size_t)fontSize << 4;
-        const size_t SPACE_BETWEEN_CHARS = 5ul;
-        FT_Int32 load_flags = FT_LOAD_RENDER; //| FT_LOAD_TARGET_(FT_RENDER_MODE_SDF);
+    bool Font::LoadCachedAtlas(uint64_t fontHash)
+    {
+        MappedFile cache;
+        const FontCache::AtlasHeader* header = FontCache::Open({ fontHash, m_FontSize, GetFreeTypeRenderMode(m_RenderMode) }, cache);
+        if (!header || header->GlyphCount != PINNED_GLYPH_CNT ||
+                header->AtlasWidth != m_AtlasWidth || header->AtlasHeight != m_AtlasHeight)
+            return false;
+
+        m_FontMetrics = header->Metrics;
+        memcpy(m_Glyphs.data(), FontCache::GetGlyphMetrics(header), PINNED_GLYPH_CNT * sizeof(CharMetrics));
+        m_ShelvesBottom = header->PixelRows;
+        memcpy(m_Pixels.data(), FontCache::GetPixels(header), (size_t)m_AtlasWidth * header->PixelRows);
+        m_DirtyTop = 0;
+        m_DirtyBottom = header->PixelRows;
+        m_DirtyFirstGlyph = 0;
+        m_DirtyEndGlyph = PINNED_GLYPH_CNT;
+        return true;
+    }
 
-        m_FontMetrics.Space_Size = FT_Load_Char(face, ' ', load_flags) ? 0 : face->glyph->advance.x >> 6;
+    void Font::BakeAtlas(uint64_t fontHash)
+    {
+        DCE_ASSURE_OR_EXIT(OpenFace(), "FreeType Error: Unable to open font face.\n");
+        m_FontMetrics.Descender = m_Face->bbox.yMin >> 6;
+        m_FontMetrics.Space_Size = FT_Load_Char(m_Face, ' ', FT_LOAD_DEFAULT) ? 0 : m_Face->glyph->advance.x >> 6;
 
+        std::vector<uint32_t> indices(PINNED_GLYPH_CNT);
+        for (uint32_t i = 0; i < PINNED_GLYPH_CNT; ++i)
+            indices[i] = FT_Get_Char_Index(m_Face, (FT_ULong)GLYPHS[i]);
+        std::vector<GlyphBitmap> bitmaps;
+        std::vector<std::vector<uint8_t>> storage;
+        RasterizeGlyphs(indices, bitmaps, storage);
 
-        uint32_t curRowW = 0, curRowH = 0;
-        for (size_t i = 0; i < GLYPH_CNT; ++i)
+        int loaded_glyph_cnt = 0;
+        for (uint32_t i = 0; i < PINNED_GLYPH_CNT; ++i)
         {
-            if (FT_Load_Char(face, GLYPHS[i], load_flags))
+            char ch = GLYPHS[i];
+            const GlyphBitmap& bitmap = bitmaps[i];
+            if (!bitmap.Valid || bitmap.Width == 0 || bitmap.Rows == 0)
             {
-                printf("ERROR: Could not load character \'%c\'.\n", GLYPHS[i]);
+                printf("Error: Unable to load glyph %c\n", ch);
+                m_Glyphs[i].Bottom_Left_X = -1.0f;
                 continue;
             }
 
-            FT_Bitmap* bmp = &face->glyph->bitmap;
-
-            if (bmp->width == 0 || bmp->rows == 0)
-                continue;
-
-            if (curRowW + bmp->width + SPACE_BETWEEN_CHARS >= cutoff)
+            if (!StoreGlyph(i, bitmap))
             {
-                m_AtlasWidth = m_AtlasWidth > curRowW ? m_AtlasWidth : curRowW;
-                m_AtlasHeight += curRowH + SPACE_BETWEEN_CHARS;
-                curRowW = 0;
-                curRowH = 0;
+                printf("ERROR: No room in the atlas for glyph \'%c\'.\n", ch);
+                m_Glyphs[i].Bottom_Left_X = -1.0f;
+                continue;
             }
-            curRowW += bmp->width + SPACE_BETWEEN_CHARS;
-            curRowH = curRowH > bmp->rows ? curRowH : bmp->rows;
+            ++loaded_glyph_cnt;
         }
 
-        m_AtlasWidth = m_AtlasWidth > curRowW ? m_AtlasWidth : curRowW;
-        m_AtlasHeight = m_AtlasHeight + curRowH;
+        // Shelves holding ASCII are forgotten, which keeps them from ever
+        // being filled up further or evicted.
+        m_Shelves.clear();
+        for (uint32_t i = 0; i < PINNED_GLYPH_CNT; ++i)
+            m_GlyphShelves[i] = NO_SHELF;
+        m_DirtyFirstGlyph = 0;
+        m_DirtyEndGlyph = PINNED_GLYPH_CNT;
 
-        m_AtlasRendererID = Renderer::CreateFontTexture(m_AtlasWidth, m_AtlasHeight);
+        printf("Loaded %d out of %ld glyphs for font.\n", loaded_glyph_cnt, PINNED_GLYPH_CNT);
 
-        uint32_t offX = 0, offY = 0;
-        curRowH = 0;
-        int loaded_glyph_cnt = 0;
-        for (size_t i = 0; i < GLYPH_CNT; ++i)
+        FontCache::AtlasHeader header = {};
+        header.Key = { fontHash, m_FontSize, GetFreeTypeRenderMode(m_RenderMode) };
+        header.Metrics = m_FontMetrics;
+        header.AtlasWidth = m_AtlasWidth;
+        header.AtlasHeight = m_AtlasHeight;
+        header.PixelRows = m_ShelvesBottom;
+        header.GlyphCount = PINNED_GLYPH_CNT;
+        FontCache::Store(header, m_Glyphs.data(), m_Pixels.data());
+    }
+
+    bool Font::OpenFace()
+    {
+        if (m_Face)
+            return true;
+
+        int error_code; (void)error_code;
+        if (!s_Lib)
         {
-            char ch = GLYPHS[i];
+            error_code = FT_Init_FreeType(&s_Lib);
+            DCE_ASSURE_OR_EXIT(error_code == 0, "FreeType Error (Code %d): Unable to initialize FreeType library.\n", error_code);
+        }
+
+        // The face reads straight out of the mapping the font was hashed from.
+        error_code = FT_New_Memory_Face(s_Lib, (const FT_Byte*)m_FontFile.Data(), (FT_Long)m_FontFile.Size(), 0, &m_Face);
+        if (error_code)
+        {
+            printf("FreeType Error (Code %d): Unable to load font face.\n", error_code);
+            m_Face = nullptr;
+            return false;
+        }
+
+        error_code = FT_Set_Pixel_Sizes(m_Face, 0, m_FontSize);
+        DCE_ASSERT(error_code == 0, "FreeType Error: Unable to set font size.\n");
+        return true;
+    }
+
+    uint32_t Font::LookupGlyph(uint32_t codepoint)
+    {
+        auto it = m_CodepointGlyphs.find(codepoint);
+        if (it != m_CodepointGlyphs.end())
+        {
+            TouchGlyph(it->second);
+            return it->second;
+        }
+
+        FT_UInt index = OpenFace() ? FT_Get_Char_Index(m_Face, codepoint) : 0;
+        if (index == 0 || !RenderGlyph(m_Face, m_RenderMode, index))
+        {
+            m_CodepointGlyphs[codepoint] = m_FallbackGlyph;
+            return m_FallbackGlyph;
+        }
+        return AddGlyph(codepoint, GetSlotBitmap(m_Face->glyph));
+    }
 
-            // load character glyph
-            if (FT_Load_Char(face, ch, load_flags)
-                    || face->glyph->bitmap.width == 0
-                    || face->glyph->bitmap.rows == 0)
+    Font::GlyphBitmap Font::GetSlotBitmap(FT_GlyphSlotRec_* slot)
+    {
+        return (GlyphBitmap)
+        {
+            slot->bitmap.buffer,
+            slot->bitmap.width,
+            slot->bitmap.rows,
+            slot->bitmap.pitch,
+            slot->bitmap_left,
+            slot->bitmap_top,
+            (int32_t)(slot->advance.x >> 6),
+            true
+        };
+    }
+
+    uint32_t Font::AddGlyph(uint32_t codepoint, const GlyphBitmap& bitmap)
+    {
+        // Neither running out of slots nor of atlas space is remembered, the
+        // glyph is tried again once shelves stop being used every frame.
+        if (m_FreeGlyphs.empty() && EvictShelf(0) == NO_SHELF)
+            return m_FallbackGlyph;
+        uint32_t glyph = m_FreeGlyphs.back();
+        m_FreeGlyphs.pop_back();
+        if (!StoreGlyph(glyph, bitmap))
+        {
+            m_FreeGlyphs.push_back(glyph);
+            return m_FallbackGlyph;
+        }
+
+        m_GlyphCodepoints[glyph] = codepoint;
+        m_CodepointGlyphs[codepoint] = glyph;
+        return glyph;
+    }
+
+    void Font::Prefetch(const char* text, size_t size)
+    {
+        std::vector<uint32_t>& codepoints = m_PrefetchCodepoints;
+        codepoints.clear();
+        for (size_t i = 0; i < size;)
+        {
+            if ((uint8_t)text[i] < 0x80)
             {
-                printf("Error: Unable to load glyph %c\n", ch);
-                m_CharMetrics[ch - '!'].Bottom_Left_X = -1.0f;
+                ++i;
                 continue;
             }
+            size_t sequenceLength;
+            uint32_t codepoint = Utf8::Decode(text + i, size - i, &sequenceLength);
+            i += sequenceLength;
+            if (m_CodepointGlyphs.find(codepoint) == m_CodepointGlyphs.end())
+                codepoints.push_back(codepoint);
+        }
+        // A few glyphs are rasterized faster by layout than threads start.
+        if (codepoints.size() < 2 * MIN_GLYPHS_PER_THREAD || !OpenFace())
+            return;
+        std::sort(codepoints.begin(), codepoints.end());
+        codepoints.erase(std::unique(codepoints.begin(), codepoints.end()), codepoints.end());
 
-            if (FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL))
+        std::vector<uint32_t> indices;
+        indices.reserve(codepoints.size());
+        for (uint32_t codepoint : codepoints)
+        {
+            FT_UInt index = FT_Get_Char_Index(m_Face, codepoint);
+            if (index == 0)
             {
-                printf("ERROR: Unable to render glyph \'%c\'.\n", ch);
+                m_CodepointGlyphs[codepoint] = m_FallbackGlyph;
                 continue;
             }
+            codepoints[indices.size()] = codepoint;
+            indices.push_back(index);
+        }
 
-            FT_Bitmap* bmp = &face->glyph->bitmap;
+        std::vector<GlyphBitmap> bitmaps;
+        std::vector<std::vector<uint8_t>> storage;
+        RasterizeGlyphs(indices, bitmaps, storage);
+        // Glyphs a worker failed on are left to LookupGlyph.
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            if (bitmaps[i].Valid)
+                AddGlyph(codepoints[i], bitmaps[i]);
+        }
+    }
 
-            if (offX + bmp->width + SPACE_BETWEEN_CHARS >= cutoff)
+    void Font::RasterizeGlyphs(const std::vector<uint32_t>& indices, std::vector<GlyphBitmap>& o_Glyphs,
+                               std::vector<std::vector<uint8_t>>& o_Storage)
+    {
+        size_t threadCount = std::thread::hardware_concurrency();
+        size_t maxThreads = indices.size() / MIN_GLYPHS_PER_THREAD;
+        if (threadCount > maxThreads)
+            threadCount = maxThreads;
+        if (threadCount < 1)
+            threadCount = 1;
+
+        o_Glyphs.assign(indices.size(), GlyphBitmap());
+        o_Storage.assign(threadCount, std::vector<uint8_t>());
+        // Every thread takes every threadCount-th glyph, which spreads the
+        // expensive ones more evenly than contiguous ranges would. Pixels are
+        // stored by offset until all threads are done growing their storage.
+        auto rasterize = [this, &indices, &o_Glyphs, &o_Storage, threadCount](FT_Face face, size_t first)
+        {
+            std::vector<uint8_t>& pixels = o_Storage[first];
+            for (size_t i = first; i < indices.size(); i += threadCount)
             {
-                offX = 0;
-                offY += curRowH + SPACE_BETWEEN_CHARS;
-                curRowH = 0;
+                GlyphBitmap& glyph = o_Glyphs[i];
+                if (!RenderGlyph(face, m_RenderMode, indices[i]))
+                    continue;
+                glyph = GetSlotBitmap(face->glyph);
+                size_t offset = pixels.size();
+                pixels.resize(offset + (size_t)glyph.Width * glyph.Rows);
+                for (uint32_t row = 0; row < glyph.Rows; ++row)
+                    memcpy(&pixels[offset + (size_t)row * glyph.Width], glyph.Pixels + (ptrdiff_t)row * glyph.Pitch, glyph.Width);
+                glyph.Pixels = (const uint8_t*)offset;
+                glyph.Pitch = (int32_t)glyph.Width;
             }
+        };
 
-            Renderer::UpdateFontTexture(m_AtlasRendererID, (int)offX, (int)offY, (int)bmp->width, (int)bmp->rows, (const void*)bmp->buffer);
+        // FreeType libraries and faces may only be used by one thread at a
+        // time, so workers load the font from the shared mapping themselves.
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threadCount; ++t)
+        {
+            workers.emplace_back([this, &rasterize, t]()
+            {
+                FT_Library library;
+                FT_Face face;
+                if (FT_Init_FreeType(&library))
+                    return;
+                if (FT_New_Memory_Face(library, (const FT_Byte*)m_FontFile.Data(), (FT_Long)m_FontFile.Size(), 0, &face) == 0)
+                {
+                    if (FT_Set_Pixel_Sizes(face, 0, m_FontSize) == 0)
+                        rasterize(face, t);
+                    FT_Done_Face(face);
+                }
+                FT_Done_FreeType(library);
+            });
+        }
+        rasterize(m_Face, 0);
+        for (std::thread& worker : workers)
+            worker.join();
 
-            // now store character metrics for later use
+        for (size_t i = 0; i < o_Glyphs.size(); ++i)
+        {
+            if (o_Glyphs[i].Valid)
+                o_Glyphs[i].Pixels = o_Storage[i % threadCount].data() + (size_t)o_Glyphs[i].Pixels;
+        }
+    }
 
-            m_CharMetrics[ch - '!'] = (CharMetrics)
-            {
-                (float)offX / (float)m_AtlasWidth,
-                (float)(offY + bmp->rows) / (float)m_AtlasHeight,
-                (float)(offX + bmp->width) / (float)m_AtlasWidth,
-                (float)offY / (float)m_AtlasHeight,
-                bmp->width,
-                bmp->rows,
-                face->glyph->bitmap_left,
-                face->glyph->bitmap_top,
-                (int)(face->glyph->advance.x >> 6)
-            };
-
-            curRowH = curRowH > bmp->rows ? curRowH : bmp->rows;
-            offX += bmp->width + SPACE_BETWEEN_CHARS;
-            ++loaded_glyph_cnt;
+    void Font::FlushUploads()
+    {
+        if (m_DirtyTop < m_DirtyBottom)
+        {
+            Renderer::UpdateFontTexture(m_AtlasRendererID, 0, (int)m_DirtyTop, (int)m_AtlasWidth, (int)(m_DirtyBottom - m_DirtyTop),
+                                        m_Pixels.data() + (size_t)m_DirtyTop * m_AtlasWidth);
+            m_DirtyTop = m_AtlasHeight;
+            m_DirtyBottom = 0;
+        }
+        if (m_DirtyFirstGlyph < m_DirtyEndGlyph)
+        {
+            Renderer::UpdateGlyphMetrics(m_DirtyFirstGlyph, &m_Glyphs[m_DirtyFirstGlyph], m_DirtyEndGlyph - m_DirtyFirstGlyph);
+            m_DirtyFirstGlyph = MAX_GLYPHS;
+            m_DirtyEndGlyph = 0;
+        }
+    }
+
+    bool Font::StoreGlyph(uint32_t glyph, const GlyphBitmap& bitmap)
+    {
+        uint32_t offX = 0, offY = 0;
+        uint16_t shelf = NO_SHELF;
+        // Blank glyphs only need their metrics.
+        if (bitmap.Width && bitmap.Rows)
+        {
+            shelf = AllocateShelfSpace(bitmap.Width, bitmap.Rows, &offX);
+            if (shelf == NO_SHELF)
+                return false;
+            offY = m_Shelves[shelf].Y;
+            m_Shelves[shelf].Glyphs.push_back(glyph);
+            m_Shelves[shelf].LastUsed = m_Frame;
+            for (uint32_t row = 0; row < bitmap.Rows; ++row)
+                memcpy(&m_Pixels[(size_t)(offY + row) * m_AtlasWidth + offX], bitmap.Pixels + (ptrdiff_t)row * bitmap.Pitch, bitmap.Width);
+            m_DirtyTop = std::min(m_DirtyTop, offY);
+            m_DirtyBottom = std::max(m_DirtyBottom, offY + bitmap.Rows);
         }
 
-        printf("Loaded %d out of %ld glyphs for font.\n", loaded_glyph_cnt, GLYPH_CNT);
+        m_GlyphShelves[glyph] = shelf;
+        m_Glyphs[glyph] = (CharMetrics)
+        {
+            (float)offX / (float)m_AtlasWidth,
+            (float)(offY + bitmap.Rows) / (float)m_AtlasHeight,
+            (float)(offX + bitmap.Width) / (float)m_AtlasWidth,
+            (float)offY / (float)m_AtlasHeight,
+            bitmap.Width,
+            bitmap.Rows,
+            bitmap.Left,
+            bitmap.Top,
+            bitmap.Advance
+        };
+        m_DirtyFirstGlyph = std::min(m_DirtyFirstGlyph, glyph);
+        m_DirtyEndGlyph = std::max(m_DirtyEndGlyph, glyph + 1);
+        return true;
+    }
+
+    uint16_t Font::AllocateShelfSpace(uint32_t width, uint32_t height, uint32_t* o_X)
+    {
+        width += GLYPH_PADDING;
+        height += GLYPH_PADDING;
+        if (width > m_AtlasWidth)
+            return NO_SHELF;
+
+        // Best fit among the shelves with room left, else a new shelf, else
+        // an evicted one.
+        uint16_t best = NO_SHELF;
+        for (size_t i = 0; i < m_Shelves.size(); ++i)
+        {
+            const Shelf& shelf = m_Shelves[i];
+            if (shelf.Height >= height && shelf.X + width <= m_AtlasWidth &&
+                    (best == NO_SHELF || shelf.Height < m_Shelves[best].Height))
+                best = (uint16_t)i;
+        }
+        if (best == NO_SHELF)
+        {
+            uint32_t shelfHeight = (height + SHELF_HEIGHT_STEP - 1) / SHELF_HEIGHT_STEP * SHELF_HEIGHT_STEP;
+            if (m_ShelvesBottom + shelfHeight <= m_AtlasHeight && m_Shelves.size() < NO_SHELF)
+            {
+                best = (uint16_t)m_Shelves.size();
+                m_Shelves.push_back({ m_ShelvesBottom, shelfHeight, 0, m_Frame, {} });
+                m_ShelvesBottom += shelfHeight;
+            }
+            else
+                best = EvictShelf(height);
+            if (best == NO_SHELF)
+                return NO_SHELF;
+        }
 
-        FT_Done_Face(face);
+        Shelf& shelf = m_Shelves[best];
+        *o_X = shelf.X;
+        shelf.X += width;
+        return best;
     }
 
-    const CharMetrics& Font::GetCharMetrics(char c) const
+    uint16_t Font::EvictShelf(uint32_t minHeight)
     {
-        return (c >= '!' && c <= '~') ? m_CharMetrics[c - '!'] : m_CharMetrics['?'];
+        uint16_t victim = NO_SHELF;
+        for (size_t i = 0; i < m_Shelves.size(); ++i)
+        {
+            const Shelf& shelf = m_Shelves[i];
+            if (shelf.Height < minHeight || shelf.LastUsed == m_Frame)
+                continue;
+            if (victim == NO_SHELF || shelf.LastUsed < m_Shelves[victim].LastUsed)
+                victim = (uint16_t)i;
+        }
+        if (victim == NO_SHELF)
+            return NO_SHELF;
+
+        Shelf& shelf = m_Shelves[victim];
+        for (uint32_t glyph : shelf.Glyphs)
+        {
+            m_CodepointGlyphs.erase(m_GlyphCodepoints[glyph]);
+            m_GlyphShelves[glyph] = NO_SHELF;
+            m_FreeGlyphs.push_back(glyph);
+        }
+        shelf.Glyphs.clear();
+        shelf.X = 0;
+        ++m_Generation;
+        return victim;
     }
 }
@@ -2,8 +2,14 @@
 #define _DCE_FONT_H
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "Core.h"
+#include "MappedFile.h"
+
+struct FT_FaceRec_;
+struct FT_GlyphSlotRec_;
 
 namespace dce
 {
@@ -24,25 +30,145 @@ namespace dce
         int32_t   Advance;                      // Offset to advance to next glyph
     };
 
+    // BITMAP glyphs are coverage masks meant to be drawn at the size they
+    // were rasterized at. SDF glyphs hold the distance to the outline instead,
+    // which keeps edges sharp when they are drawn scaled, so one atlas serves
+    // every zoom level.
+    enum class FontRenderMode : uint8_t
+    {
+        BITMAP,
+        SDF
+    };
+
+    // Glyphs live in slots of a fixed size atlas. The printable ASCII range is
+    // baked into the first slots at construction and never moves, everything
+    // else is rasterized on first use into shelves, rows of glyphs of similar
+    // height. Once the atlas is full, the least recently used shelf is
+    // emptied for the new glyph, which bumps the atlas generation since its
+    // slots may now hold other glyphs. The baked part is kept in FontCache,
+    // FreeType is only loaded once a glyph actually has to be rasterized.
     class Font
     {
     public:
-        Font(const std::string& filepath, uint32_t fontSize);
-        ~Font() = default;
+        Font(const std::string& filepath, uint32_t fontSize, FontRenderMode mode = FontRenderMode::BITMAP);
+        Font(const Font&) = delete;
+        ~Font();
+
+        // Index of the slot holding the glyph drawn for codepoint, the
+        // renderer's glyph instances refer to glyphs by it. Codepoints the
+        // font has no glyph for are drawn as '?'.
+        inline uint32_t GetGlyphIndex(uint32_t codepoint)
+        {
+            if(codepoint < 0x80)
+                return m_AsciiGlyphs[codepoint];
+            return LookupGlyph(codepoint);
+        }
+        inline const CharMetrics& GetGlyphMetrics(uint32_t glyph) const { return m_Glyphs[glyph]; }
+        inline const CharMetrics& GetCharMetrics(char c) const
+        {
+            return m_Glyphs[(uint8_t)c < 0x80 ? m_AsciiGlyphs[(uint8_t)c] : m_FallbackGlyph];
+        }
+        // Marks the shelf of a glyph drawn without a lookup, like one out of a
+        // cached layout, as used this frame. Shelves used in the current frame
+        // are never evicted.
+        inline void TouchGlyph(uint32_t glyph)
+        {
+            if(glyph >= PINNED_GLYPH_CNT && m_GlyphShelves[glyph] != NO_SHELF)
+                m_Shelves[m_GlyphShelves[glyph]].LastUsed = m_Frame;
+        }
+        // Rasterizes the glyphs text needs that aren't in the atlas yet in one
+        // parallel batch, rather than one at a time as layout runs into them.
+        void Prefetch(const char* text, size_t size);
+        // Uploads the glyphs stored since the last call in one go, needs to
+        // happen before they are drawn.
+        void FlushUploads();
+        inline void NextFrame() { ++m_Frame; }
+        inline uint32_t GetAtlasGeneration() const { return m_Generation; }
 
-        const CharMetrics& GetCharMetrics(char c) const;
         const FontMetrics& GetFontMetrics() const { return m_FontMetrics; }
+        FontRenderMode GetRenderMode() const { return m_RenderMode; }
         uint32_t GetAtlasRendererID() const { return m_AtlasRendererID; }
+    public:
+        static constexpr size_t MAX_GLYPHS = 4096;
+        static constexpr uint32_t ATLAS_MIN_SIZE = 1024;
+        // Fewer glyphs than this per thread aren't worth a FreeType instance.
+        static constexpr size_t MIN_GLYPHS_PER_THREAD = 8;
+    private:
+        // A rendered glyph, Pixels pointing to Rows rows of Pitch bytes.
+        struct GlyphBitmap
+        {
+            const uint8_t* Pixels;
+            uint32_t Width, Rows;
+            int32_t Pitch;
+            int32_t Left, Top;
+            int32_t Advance;
+            bool Valid;
+        };
+
+        struct Shelf
+        {
+            uint32_t Y, Height;
+            uint32_t X;
+            uint64_t LastUsed;
+            std::vector<uint32_t> Glyphs;
+        };
+
+        bool LoadCachedAtlas(uint64_t fontHash);
+        void BakeAtlas(uint64_t fontHash);
+        bool OpenFace();
+        // Renders the glyphs at the given face indices. With enough of them,
+        // they are split across worker threads that each open the font in a
+        // FreeType library of their own. Pixels of the results are kept in
+        // o_Storage.
+        void RasterizeGlyphs(const std::vector<uint32_t>& indices, std::vector<GlyphBitmap>& o_Glyphs,
+                             std::vector<std::vector<uint8_t>>& o_Storage);
+        static GlyphBitmap GetSlotBitmap(FT_GlyphSlotRec_* slot);
+        uint32_t LookupGlyph(uint32_t codepoint);
+        // Gives codepoint a slot holding bitmap, or returns the fallback glyph
+        // if there's no room.
+        uint32_t AddGlyph(uint32_t codepoint, const GlyphBitmap& bitmap);
+        // Packs bitmap into a free spot of the atlas and stores it in slot
+        // glyph. Returns false if there's no room.
+        bool StoreGlyph(uint32_t glyph, const GlyphBitmap& bitmap);
+        uint16_t AllocateShelfSpace(uint32_t width, uint32_t height, uint32_t* o_X);
+        // Empties the least recently used shelf not used this frame, at least
+        // minHeight tall. Returns NO_SHELF if there is none.
+        uint16_t EvictShelf(uint32_t minHeight);
     private:
         static constexpr char GLYPHS[] =
             "!\"#$%&'()*+,-./0123456789:;<=>?@"
             "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
             "abcdefghijklmnopqrstuvwxyz{|}~";
-        static constexpr size_t GLYPH_CNT = sizeof(GLYPHS) - 1;
+        static constexpr size_t PINNED_GLYPH_CNT = sizeof(GLYPHS) - 1;
+        static constexpr uint16_t NO_SHELF = UINT16_MAX;
+        static constexpr uint32_t GLYPH_PADDING = 2;
+        static constexpr uint32_t SHELF_HEIGHT_STEP = 8;
+
+        MappedFile m_FontFile;
+        FT_FaceRec_* m_Face;
+        uint32_t m_FontSize;
+        FontRenderMode m_RenderMode;
         FontMetrics m_FontMetrics;
-        CharMetrics m_CharMetrics[GLYPH_CNT];
+        uint32_t m_AsciiGlyphs[0x80];
+        uint32_t m_FallbackGlyph;
+        std::vector<CharMetrics> m_Glyphs;
+        std::vector<uint16_t> m_GlyphShelves;
+        std::vector<uint32_t> m_GlyphCodepoints;
+        std::vector<uint32_t> m_FreeGlyphs;
+        std::unordered_map<uint32_t, uint32_t> m_CodepointGlyphs;
+        std::vector<Shelf> m_Shelves;
+        uint32_t m_ShelvesBottom;
+        uint64_t m_Frame;
+        uint32_t m_Generation;
         uint32_t m_AtlasWidth, m_AtlasHeight;
         uint32_t m_AtlasRendererID;
+        // Copy of the atlas that glyphs are packed into, rows from m_DirtyTop
+        // up to m_DirtyBottom and the metrics of the slots between
+        // m_DirtyFirstGlyph and m_DirtyEndGlyph still have to be uploaded.
+        std::vector<uint8_t> m_Pixels;
+        uint32_t m_DirtyTop, m_DirtyBottom;
+        uint32_t m_DirtyFirstGlyph, m_DirtyEndGlyph;
+        std::vector<uint32_t> m_PrefetchCodepoints;
     };
 }
 #endif // !_DCE_FONT_H
@@ -0,0 +1,105 @@
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "FontCache.h"
+
+namespace dce
+{
+    namespace FontCache
+    {
+        static const char MAGIC[4] = { 'D', 'C', 'E', 'A' };
+
+        // $XDG_CACHE_HOME/dce, falling back to ~/.cache/dce. Empty if neither
+        // is set.
+        static std::string GetCacheDirectory()
+        {
+            const char* cacheHome = getenv("XDG_CACHE_HOME");
+            if(cacheHome && *cacheHome)
+                return std::string(cacheHome) + "/dce";
+            const char* home = getenv("HOME");
+            if(home && *home)
+                return std::string(home) + "/.cache/dce";
+            return std::string();
+        }
+
+        static std::string GetCachePath(const std::string& directory, const AtlasKey& key)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "/atlas-%016lx-%u-%u.bin", (unsigned long)key.FontHash, key.FontSize, key.RenderMode);
+            return directory + name;
+        }
+
+        const AtlasHeader* Open(const AtlasKey& key, MappedFile& o_File)
+        {
+            std::string directory = GetCacheDirectory();
+            if(directory.empty() || !o_File.Open(GetCachePath(directory, key)))
+                return nullptr;
+
+            const AtlasHeader* header = (const AtlasHeader*)o_File.Data();
+            bool valid = o_File.Size() >= sizeof(AtlasHeader) &&
+                         memcmp(header->Magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                         header->Version == FORMAT_VERSION &&
+                         header->Key.FontHash == key.FontHash &&
+                         header->Key.FontSize == key.FontSize &&
+                         header->Key.RenderMode == key.RenderMode &&
+                         header->PixelRows <= header->AtlasHeight;
+            // A file cut short by a crash while it was written is just as stale.
+            valid = valid && o_File.Size() == sizeof(AtlasHeader) + header->GlyphCount * sizeof(CharMetrics) +
+                                              (size_t)header->AtlasWidth * header->PixelRows;
+            if(!valid)
+            {
+                o_File.Close();
+                return nullptr;
+            }
+            return header;
+        }
+
+        void Store(AtlasHeader header, const CharMetrics* metrics, const uint8_t* pixels)
+        {
+            std::string directory = GetCacheDirectory();
+            if(directory.empty())
+                return;
+            // Creates ~/.cache as well if need be.
+            size_t parent = directory.find_last_of('/');
+            if(parent != 0 && parent != std::string::npos)
+                mkdir(directory.substr(0, parent).c_str(), 0700);
+            mkdir(directory.c_str(), 0700);
+
+            memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+            header.Version = FORMAT_VERSION;
+
+            // Written next to the final path and renamed over it, so a cache
+            // file is never seen half written by another instance.
+            std::string path = GetCachePath(directory, header.Key);
+            std::string tempPath = path + ".XXXXXX";
+            int fd = mkstemp(&tempPath[0]);
+            FILE* file = fd < 0 ? nullptr : fdopen(fd, "wb");
+            if(!file)
+            {
+                if(fd >= 0)
+                {
+                    close(fd);
+                    unlink(tempPath.c_str());
+                }
+                printf("Unable to create font cache file in \'%s\': %s\n", directory.c_str(), strerror(errno));
+                return;
+            }
+
+            const size_t pixelCount = (size_t)header.AtlasWidth * header.PixelRows;
+            bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+            ok = ok && fwrite(metrics, sizeof(CharMetrics), header.GlyphCount, file) == header.GlyphCount;
+            ok = ok && fwrite(pixels, 1, pixelCount, file) == pixelCount;
+            ok = (fclose(file) == 0) && ok;
+            ok = ok && rename(tempPath.c_str(), path.c_str()) == 0;
+            if(!ok)
+            {
+                printf("Unable to write font cache file \'%s\': %s\n", path.c_str(), strerror(errno));
+                unlink(tempPath.c_str());
+            }
+        }
+    }
+}
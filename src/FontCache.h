@@ -0,0 +1,48 @@
+#ifndef _DCE_FONT_CACHE_H
+#define _DCE_FONT_CACHE_H
+
+#include "Core.h"
+#include "Font.h"
+#include "MappedFile.h"
+
+namespace dce
+{
+    // Atlases baked at startup are kept on disk, so launching again with the
+    // same font only maps a file and uploads it.
+    namespace FontCache
+    {
+        struct AtlasKey
+        {
+            uint64_t FontHash;  // Of the contents of the font file.
+            uint32_t FontSize;
+            uint32_t RenderMode;
+        };
+
+        // A cache file holds the header, GlyphCount glyph metrics and then the
+        // top PixelRows rows of the atlas, which is AtlasWidth pixels wide.
+        struct AtlasHeader
+        {
+            char Magic[4];
+            uint32_t Version;
+            AtlasKey Key;
+            FontMetrics Metrics;
+            uint32_t AtlasWidth, AtlasHeight;
+            uint32_t PixelRows;
+            uint32_t GlyphCount;
+        };
+
+        // Maps the cache file for key. Returns nullptr if there is none or it
+        // doesn't hold an atlas for key in the current format.
+        const AtlasHeader* Open(const AtlasKey& key, MappedFile& o_File);
+        inline const CharMetrics* GetGlyphMetrics(const AtlasHeader* header) { return (const CharMetrics*)(header + 1); }
+        inline const uint8_t* GetPixels(const AtlasHeader* header) { return (const uint8_t*)(GetGlyphMetrics(header) + header->GlyphCount); }
+
+        // Fills in the magic and version of header itself. Failing to write
+        // the cache only costs the next launch its speedup.
+        void Store(AtlasHeader header, const CharMetrics* metrics, const uint8_t* pixels);
+
+        static constexpr uint32_t FORMAT_VERSION = 1;
+    }
+}
+
+#endif // _DCE_FONT_CACHE_H
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "FrameStats.h"
+
+namespace dce
+{
+    namespace FrameStats
+    {
+        using Clock = std::chrono::steady_clock;
+
+        static FrameSample s_Frames[FRAME_HISTORY];
+        static size_t s_FrameCount = 0; // Frames ever recorded.
+        static FrameSample s_Current;
+        static FrameStage s_Stage = FrameStage::COUNT;
+        static Clock::time_point s_FrameStart;
+        static Clock::time_point s_StageStart;
+        static bool s_InFrame = false;
+        static bool s_OverlayVisible = false;
+
+        static const char* const STAGE_NAMES[(size_t)FrameStage::COUNT] =
+        {
+            "events", "background", "gutter", "text", "cursor", "overlay", "file_list", "sync", "draw", "swap"
+        };
+
+        static float Milliseconds(Clock::duration duration)
+        {
+            return std::chrono::duration<float, std::milli>(duration).count();
+        }
+
+        static void ChargeStage(Clock::time_point now)
+        {
+            if(s_Stage != FrameStage::COUNT)
+            {
+                float time = Milliseconds(now - s_StageStart);
+                s_Current.StageTimes[(size_t)s_Stage] += time;
+                if(!s_InFrame)
+                    s_Current.FrameTime += time;
+            }
+            s_StageStart = now;
+        }
+
+        void BeginFrame()
+        {
+            s_InFrame = true;
+            s_Stage = FrameStage::COUNT;
+            s_FrameStart = s_StageStart = Clock::now();
+        }
+
+        void EndFrame()
+        {
+            Clock::time_point now = Clock::now();
+            ChargeStage(now);
+            s_Current.FrameTime += Milliseconds(now - s_FrameStart);
+            s_Frames[s_FrameCount % FRAME_HISTORY] = s_Current;
+            ++s_FrameCount;
+            s_Current = {};
+            s_InFrame = false;
+        }
+
+        void EnterStage(FrameStage stage)
+        {
+            ChargeStage(Clock::now());
+            s_Stage = stage;
+        }
+
+        void LeaveStage(FrameStage previous)
+        {
+            ChargeStage(Clock::now());
+            s_Stage = previous;
+        }
+
+        FrameStage GetCurrentStage()
+        {
+            return s_Stage;
+        }
+
+        void AddDrawCall(uint32_t quads, uint32_t bytesUploaded)
+        {
+            ++s_Current.DrawCalls;
+            s_Current.Quads += quads;
+            s_Current.BytesUploaded += bytesUploaded;
+        }
+
+        void Summarize(Summary& o_Summary)
+        {
+            o_Summary = {};
+            size_t count = std::min(s_FrameCount, FRAME_HISTORY);
+            o_Summary.FrameCount = count;
+            if(count == 0)
+                return;
+
+            float frameTimes[FRAME_HISTORY];
+            for(size_t i = 0; i < count; ++i)
+            {
+                const FrameSample& frame = s_Frames[i];
+                frameTimes[i] = frame.FrameTime;
+                for(size_t stage = 0; stage < (size_t)FrameStage::COUNT; ++stage)
+                    o_Summary.StageAverages[stage] += frame.StageTimes[stage];
+                o_Summary.DrawCalls += (float)frame.DrawCalls;
+                o_Summary.Quads += (float)frame.Quads;
+                o_Summary.BytesUploaded += (float)frame.BytesUploaded;
+            }
+
+            for(float& time : o_Summary.StageAverages)
+                time /= (float)count;
+            o_Summary.DrawCalls /= (float)count;
+            o_Summary.Quads /= (float)count;
+            o_Summary.BytesUploaded /= (float)count;
+
+            std::nth_element(frameTimes, frameTimes + count / 2, frameTimes + count);
+            o_Summary.P50 = frameTimes[count / 2];
+            std::nth_element(frameTimes, frameTimes + count * 99 / 100, frameTimes + count);
+            o_Summary.P99 = frameTimes[count * 99 / 100];
+            o_Summary.Max = *std::max_element(frameTimes + count * 99 / 100, frameTimes + count);
+        }
+
+        bool WriteCsv(const std::string& filepath)
+        {
+            FILE* file = fopen(filepath.c_str(), "w");
+            if(!file)
+            {
+                printf("Unable to open file for frame stats: %s\n", filepath.c_str());
+                return false;
+            }
+
+            fprintf(file, "frame,frame_ms");
+            for(const char* name : STAGE_NAMES)
+                fprintf(file, ",%s_ms", name);
+            fprintf(file, ",draw_calls,quads,bytes_uploaded\n");
+
+            size_t count = std::min(s_FrameCount, FRAME_HISTORY);
+            for(size_t i = s_FrameCount - count; i < s_FrameCount; ++i)
+            {
+                const FrameSample& frame = s_Frames[i % FRAME_HISTORY];
+                fprintf(file, "%lu,%.4f", i, frame.FrameTime);
+                for(float time : frame.StageTimes)
+                    fprintf(file, ",%.4f", time);
+                fprintf(file, ",%u,%u,%u\n", frame.DrawCalls, frame.Quads, frame.BytesUploaded);
+            }
+
+            bool ok = !ferror(file);
+            fclose(file);
+            if(ok)
+                printf("Frame stats for %lu frames written to %s\n", count, filepath.c_str());
+            else
+                printf("Unable to write frame stats to %s\n", filepath.c_str());
+            return ok;
+        }
+
+        const char* GetStageName(FrameStage stage)
+        {
+            return stage < FrameStage::COUNT ? STAGE_NAMES[(size_t)stage] : "none";
+        }
+
+        void ToggleOverlay()
+        {
+            s_OverlayVisible = !s_OverlayVisible;
+        }
+
+        bool IsOverlayVisible()
+        {
+            return s_OverlayVisible;
+        }
+
+        void SetOverlayVisible(bool visible)
+        {
+            s_OverlayVisible = visible;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef _DCE_FRAME_STATS_H
+#define _DCE_FRAME_STATS_H
+
+#include <string>
+
+#include "Core.h"
+
+namespace dce
+{
+    enum class FrameStage : uint8_t
+    {
+        EVENTS,     // Polling events, key handling included.
+        BACKGROUND, // Scheduler tasks run in what's left of the frame.
+        GUTTER,
+        TEXT,       // Laying out the visible glyphs.
+        CURSOR,
+        OVERLAY,    // Progress bar, status text and the stats overlay itself.
+        FILE_LIST,
+        SYNC,       // Waiting for the GPU to be done with a stream region.
+        DRAW,
+        SWAP,
+        COUNT
+    };
+
+    // Per-frame timings of every FrameStage plus draw counters, kept for the
+    // last FRAME_HISTORY frames. Time is charged exclusively: while a nested
+    // stage runs, the one around it is paused, so the draw calls inside the
+    // text pass only show up under DRAW. Time outside of any stage only counts
+    // towards the frame time, GetCurrentStage() returns COUNT there. Stages
+    // timed between two frames, like key handling while the editor waits for
+    // events, are added to the next frame.
+    namespace FrameStats
+    {
+        struct FrameSample
+        {
+            float StageTimes[(size_t)FrameStage::COUNT]; // In milliseconds.
+            float FrameTime;
+            uint32_t DrawCalls;
+            uint32_t Quads;
+            uint32_t BytesUploaded;
+        };
+
+        struct Summary
+        {
+            float P50, P99, Max;
+            float StageAverages[(size_t)FrameStage::COUNT];
+            float DrawCalls, Quads, BytesUploaded; // Averages per frame.
+            size_t FrameCount;
+        };
+
+        void BeginFrame();
+        void EndFrame();
+        void EnterStage(FrameStage stage);
+        void LeaveStage(FrameStage previous);
+        FrameStage GetCurrentStage();
+        void AddDrawCall(uint32_t quads, uint32_t bytesUploaded);
+
+        // Over the frames still in the ring buffer, the current one excluded.
+        void Summarize(Summary& o_Summary);
+        // Dumps every recorded frame, oldest first, one row per frame.
+        bool WriteCsv(const std::string& filepath);
+        const char* GetStageName(FrameStage stage);
+
+        void ToggleOverlay();
+        bool IsOverlayVisible();
+        void SetOverlayVisible(bool visible);
+
+        static constexpr size_t FRAME_HISTORY = 1024;
+    }
+
+    class ScopedStageTimer
+    {
+    public:
+        explicit ScopedStageTimer(FrameStage stage) : m_Previous(FrameStats::GetCurrentStage()) { FrameStats::EnterStage(stage); }
+        ScopedStageTimer(const ScopedStageTimer&) = delete;
+        ~ScopedStageTimer() { FrameStats::LeaveStage(m_Previous); }
+    private:
+        FrameStage m_Previous;
+    };
+}
+
+#endif // _DCE_FRAME_STATS_H
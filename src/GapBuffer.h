@@ -3,12 +3,84 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <type_traits>
 
 #include "Core.h"
+#include "MemoryPool.h"
 
 namespace dce
 {
-    template<typename T>
+    // Allocators hand out raw blocks and report how large the block they
+    // returned really is, in bytes.
+    struct MallocAllocator
+    {
+        static void* Allocate(size_t size, size_t* o_Capacity) { *o_Capacity = size; return malloc(size); }
+        static void Free(void* block, size_t capacity) { (void)capacity; free(block); }
+    };
+
+    struct PoolAllocator
+    {
+        static void* Allocate(size_t size, size_t* o_Capacity) { return MemoryPool::Allocate(size, o_Capacity); }
+        static void Free(void* block, size_t capacity) { MemoryPool::Free(block, capacity); }
+    };
+
+    // Policies pick the capacity, in elements, to grow to once 'required'
+    // elements no longer fit, and the capacity to shrink to when the buffer is
+    // trimmed. Returning the current capacity from Shrink() keeps it as is.
+    struct GeometricGrowth
+    {
+        static size_t Grow(size_t capacity, size_t required, size_t elementSize)
+        {
+            (void)elementSize;
+            size_t grown = capacity + (capacity >> 1);
+            return grown > required ? grown : required + (required >> 1);
+        }
+
+        static size_t Shrink(size_t capacity, size_t size, size_t elementSize)
+        {
+            (void)size; (void)elementSize;
+            return capacity;
+        }
+    };
+
+    // Same as geometric growth but always ends on a page boundary, so large
+    // buffers never leave a partially used page behind.
+    struct PageAlignedGrowth
+    {
+        static constexpr size_t PAGE_SIZE = 0x1000ul;
+
+        static size_t Grow(size_t capacity, size_t required, size_t elementSize)
+        {
+            size_t bytes = GeometricGrowth::Grow(capacity, required, elementSize) * elementSize;
+            return ((bytes + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) / elementSize;
+        }
+
+        static size_t Shrink(size_t capacity, size_t size, size_t elementSize)
+        {
+            return GeometricGrowth::Shrink(capacity, size, elementSize);
+        }
+    };
+
+    // Grows like Growth, and gives memory back once the buffer is trimmed while
+    // using less than a quarter of its capacity, e.g. after undoing a huge paste.
+    template<typename Growth = GeometricGrowth>
+    struct ShrinkOnIdle
+    {
+        static size_t Grow(size_t capacity, size_t required, size_t elementSize)
+        {
+            return Growth::Grow(capacity, required, elementSize);
+        }
+
+        static size_t Shrink(size_t capacity, size_t size, size_t elementSize)
+        {
+            if(size >= (capacity >> 2))
+                return capacity;
+            size_t shrunk = Growth::Grow(0, size, elementSize);
+            return shrunk < capacity ? shrunk : capacity;
+        }
+    };
+
+    template<typename T, typename Allocator = PoolAllocator, typename Policy = GeometricGrowth>
     class GapBuffer
     {
     public:
@@ -17,18 +89,21 @@ namespace dce
             m_Size = 0;
             m_Capacity = ensuredCapacity >= 10ul ? ensuredCapacity : 10ul;
             m_GapPosition = 0;
-            m_Data = (T*)malloc(m_Capacity * sizeof(T));
+            m_Data = Allocate(m_Capacity, &m_Capacity);
             DCE_ASSURE_OR_EXIT(m_Data, "An error occurred during memory allocation.\n");
         }
 
         GapBuffer(const GapBuffer& copy)
         {
             m_Size = copy.m_Size;
-            m_Capacity = copy.m_Capacity;
             m_GapPosition = copy.m_GapPosition;
-            m_Data = (T*)malloc(m_Capacity * sizeof(T));
+            m_Data = Allocate(copy.m_Capacity, &m_Capacity);
             DCE_ASSURE_OR_EXIT(m_Data, "An error occurred during memory allocation.\n");
-            memcpy(m_Data, copy.m_Data, m_Capacity * sizeof(T));
+            // The capacity may have been rounded up, which moves the text after the gap.
+            size_t afterGap = m_Size - m_GapPosition;
+            memcpy((void*)m_Data, (const void*)copy.m_Data, m_GapPosition * sizeof(T));
+            memcpy((void*)(m_Data + m_Capacity - afterGap), (const void*)(copy.m_Data + copy.m_Capacity - afterGap),
+                   afterGap * sizeof(T));
         }
 
         GapBuffer(GapBuffer&& temp)
@@ -42,8 +117,7 @@ namespace dce
         
         ~GapBuffer()
         {
-            if(m_Data)
-                free(m_Data);
+            Allocator::Free(m_Data, m_Capacity * sizeof(T));
         }
 
         inline void Clear()
@@ -56,22 +130,28 @@ namespace dce
         {
             if(newCapacity < m_Capacity)
                 return false;
-            
-            T* newData = (T*)realloc(m_Data, newCapacity * sizeof(T));
-            if(!newData)
-                return false;
+            return Reallocate(newCapacity);
+        }
 
-            m_Data = newData;
-            T* loc = m_Data - m_Size + m_GapPosition;
-            memmove(loc + newCapacity, loc + m_Capacity, (m_Size - m_GapPosition) * sizeof(T));
-            m_Capacity = newCapacity;
-            return true;
+        // Lets the policy give back unused capacity, meant to be called when
+        // the buffer hasn't been edited for a while.
+        inline void Trim()
+        {
+            size_t newCapacity = GetTrimmedCapacity();
+            if(newCapacity < m_Capacity)
+                Reallocate(newCapacity);
+        }
+
+        // Whether Trim() would move the elements to a smaller block.
+        inline bool CanTrim() const
+        {
+            return GetTrimmedCapacity() < m_Capacity;
         }
 
         inline void Add(const T& obj, bool isBeforeGap)
         {
             if(m_Size >= m_Capacity &&
-               !EnsureCapacity(m_Capacity + (m_Capacity >> 1)))
+               !EnsureCapacity(Policy::Grow(m_Capacity, m_Size + 1, sizeof(T))))
             {
                 printf("An error occurred when reallocating memory.\n");
                 return;
@@ -87,18 +167,40 @@ namespace dce
         {
             size_t newSize = m_Size + count;
             if(newSize >= m_Capacity &&
-               !EnsureCapacity(newSize + (newSize >> 1)))
+               !EnsureCapacity(Policy::Grow(m_Capacity, newSize, sizeof(T))))
             {
                 printf("An error occurred when reallocating memory.\n");
                 return;
             }
             T* loc = m_Data + (isBeforeGap ? m_GapPosition : (m_Capacity - newSize + m_GapPosition));
-            for(size_t i = 0; i < count; ++i)
-                loc[i] = objArr[i];
+            if(std::is_trivially_copyable<T>::value)
+                memcpy((void*)loc, (const void*)objArr, count * sizeof(T));
+            else
+            {
+                for(size_t i = 0; i < count; ++i)
+                    loc[i] = objArr[i];
+            }
             m_GapPosition += count * isBeforeGap;
             m_Size = newSize;
         }
 
+        // Grows the buffer by count items before the gap and returns them
+        // uninitialized so they can be filled in place.
+        inline T* AddUninitialized(size_t count)
+        {
+            size_t newSize = m_Size + count;
+            if(newSize >= m_Capacity &&
+               !EnsureCapacity(Policy::Grow(m_Capacity, newSize, sizeof(T))))
+            {
+                printf("An error occurred when reallocating memory.\n");
+                return nullptr;
+            }
+            T* loc = m_Data + m_GapPosition;
+            m_GapPosition += count;
+            m_Size = newSize;
+            return loc;
+        }
+
         inline void Remove(size_t count, bool isBeforeGap)
         {
             DCE_ASSERT(count <= (isBeforeGap ? m_GapPosition : (m_Size - m_GapPosition)),
@@ -140,21 +242,14 @@ namespace dce
 
         GapBuffer& operator=(const GapBuffer& copy)
         {
-            if(m_Data)
-                free(m_Data);
-            m_Size = copy.m_Size;
-            m_Capacity = copy.m_Capacity;
-            m_GapPosition = copy.m_GapPosition;
-            m_Data = (T*)malloc(m_Capacity * sizeof(T));
-            DCE_ASSURE_OR_EXIT(m_Data, "An error occurred during memory allocation.\n");
-            memcpy(m_Data, copy.m_Data, m_Capacity * sizeof(T));
+            if(this != &copy)
+                *this = GapBuffer(copy);
             return *this;
         }
 
         GapBuffer& operator=(GapBuffer&& temp)
         {
-            if(m_Data)
-                free(m_Data);
+            Allocator::Free(m_Data, m_Capacity * sizeof(T));
             m_Size = temp.m_Size;
             m_Capacity = temp.m_Capacity;
             m_GapPosition = temp.m_GapPosition;
@@ -202,6 +297,36 @@ namespace dce
         inline size_t Capacity() const { return m_Capacity; }
         inline size_t GapPos() const { return m_GapPosition; } 
 
+    private:
+        inline size_t GetTrimmedCapacity() const
+        {
+            size_t newCapacity = Policy::Shrink(m_Capacity, m_Size, sizeof(T));
+            return newCapacity < m_Size ? m_Size : newCapacity;
+        }
+
+        // The allocator may round the capacity up.
+        static T* Allocate(size_t capacity, size_t* o_Capacity)
+        {
+            size_t bytes;
+            T* data = (T*)Allocator::Allocate(capacity * sizeof(T), &bytes);
+            *o_Capacity = bytes / sizeof(T);
+            return data;
+        }
+
+        bool Reallocate(size_t newCapacity)
+        {
+            T* newData = Allocate(newCapacity, &newCapacity);
+            if(!newData)
+                return false;
+
+            size_t afterGap = m_Size - m_GapPosition;
+            memcpy((void*)newData, (const void*)m_Data, m_GapPosition * sizeof(T));
+            memcpy((void*)(newData + newCapacity - afterGap), (const void*)(m_Data + m_Capacity - afterGap), afterGap * sizeof(T));
+            Allocator::Free(m_Data, m_Capacity * sizeof(T));
+            m_Data = newData;
+            m_Capacity = newCapacity;
+            return true;
+        }
     private:
         size_t m_Size;
         size_t m_Capacity;
@@ -0,0 +1,129 @@
+#include "GlyphLayout.h"
+#include "Hash.h"
+#include "Utf8.h"
+
+namespace dce
+{
+    LineLayoutCache::LineLayoutCache()
+    {
+        m_Params = {};
+        m_Frame = 0;
+        m_AtlasGeneration = 0;
+        m_Hits = 0;
+        m_Misses = 0;
+    }
+
+    void LineLayoutCache::BeginFrame(const LayoutParams& params)
+    {
+        if(!(params == m_Params))
+        {
+            Clear();
+            m_Params = params;
+            m_AtlasGeneration = params.TextFont->GetAtlasGeneration();
+        }
+
+        ++m_Frame;
+        if(m_Lines.size() <= MAX_LINES)
+            return;
+        for(auto it = m_Lines.begin(); it != m_Lines.end();)
+        {
+            if(it->second.LastUsed + 1 < m_Frame)
+                it = m_Lines.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void LineLayoutCache::Clear()
+    {
+        m_Lines.clear();
+    }
+
+    const LineLayout* LineLayoutCache::Get(const char* data, size_t length)
+    {
+        if(length > MAX_LINE_LENGTH)
+            return nullptr;
+        // Laying out an earlier line may have evicted glyphs of later ones.
+        if(m_Params.TextFont->GetAtlasGeneration() != m_AtlasGeneration)
+        {
+            Clear();
+            m_AtlasGeneration = m_Params.TextFont->GetAtlasGeneration();
+        }
+
+        LineLayout& layout = m_Lines[HashBytes(data, length)];
+        if(layout.Rows == 0 || layout.Length != length)
+        {
+            Layout(data, length, m_Params, layout);
+            ++m_Misses;
+        }
+        else
+            ++m_Hits;
+        layout.LastUsed = m_Frame;
+        return &layout;
+    }
+
+    void LineLayoutCache::Layout(const char* data, size_t length, const LayoutParams& params, LineLayout& o_Layout,
+                                 uint32_t maxRows, size_t cursorOffset, float* o_CursorX, float* o_CursorY)
+    {
+        Font* font = params.TextFont;
+        const float spaceSize = (float)font->GetFontMetrics().Space_Size;
+        float penX = params.StartX, penY = 0.0f;
+        uint32_t row = 0;
+        size_t column = 0;
+        o_Layout.Glyphs.clear();
+        o_Layout.Offsets.clear();
+        o_Layout.Length = (uint32_t)length;
+        if(cursorOffset == 0)
+        {
+            *o_CursorX = penX;
+            *o_CursorY = penY;
+        }
+
+        for(size_t i = 0, next; i < length && row < maxRows; i = next)
+        {
+            char c = data[i];
+            next = i + 1;
+            if(c == ' ')
+            {
+                penX += spaceSize;
+                ++column;
+            }
+            else if(c == '\t')
+            {
+                size_t size = TAB_SIZE - (column % TAB_SIZE);
+                penX += spaceSize * (float)size;
+                column += size;
+            }
+            else if((uint8_t)c < 0x80)
+            {
+                o_Layout.Glyphs.push_back({ penX, penY, font->GetGlyphIndex((uint32_t)c), params.Color });
+                o_Layout.Offsets.push_back((uint32_t)i);
+                penX += (float)font->GetCharMetrics(c).Advance;
+                ++column;
+            }
+            else
+            {
+                size_t sequenceLength;
+                uint32_t glyph = font->GetGlyphIndex(Utf8::Decode(data + i, length - i, &sequenceLength));
+                next = i + sequenceLength;
+                o_Layout.Glyphs.push_back({ penX, penY, glyph, params.Color });
+                o_Layout.Offsets.push_back((uint32_t)i);
+                penX += (float)font->GetGlyphMetrics(glyph).Advance;
+                ++column;
+            }
+
+            if(penX > params.WrapX)
+            {
+                penX = params.StartX;
+                penY += params.LineHeight;
+                ++row;
+            }
+            if(cursorOffset > i && cursorOffset <= next)
+            {
+                *o_CursorX = penX;
+                *o_CursorY = penY;
+            }
+        }
+        o_Layout.Rows = row + 1;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef _DCE_GLYPH_LAYOUT_H
+#define _DCE_GLYPH_LAYOUT_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "Core.h"
+#include "Font.h"
+
+namespace dce
+{
+    // What the renderer streams to glyph.vert for every glyph on screen.
+    struct GlyphInstance
+    {
+        float X, Y;
+        uint32_t Glyph;
+        uint32_t Color; // RGBA8, red in the lowest byte.
+    };
+    static_assert(sizeof(GlyphInstance) == 16, "Glyph instances are expected to be 16 bytes.");
+
+    // Everything besides a line's text that decides where its glyphs go.
+    struct LayoutParams
+    {
+        Font* TextFont;
+        float StartX;   // Pen position at the start of every row.
+        float WrapX;    // A row wraps once the pen is past this.
+        float LineHeight;
+        uint32_t Color;
+
+        inline bool operator==(const LayoutParams& other) const
+        {
+            return TextFont == other.TextFont && StartX == other.StartX && WrapX == other.WrapX &&
+                   LineHeight == other.LineHeight && Color == other.Color;
+        }
+    };
+
+    // Glyphs of one line without its newline. Y is relative to the baseline
+    // of the line's first row, which spans Rows rows after wrapping.
+    struct LineLayout
+    {
+        std::vector<GlyphInstance> Glyphs;
+        std::vector<uint32_t> Offsets; // Of the first byte of every glyph in the line.
+        uint32_t Rows;
+        uint32_t Length;
+        uint64_t LastUsed;
+    };
+
+    // Lays out lines once and hands the result back for as long as their
+    // text, the layout parameters and the font's atlas generation stay the
+    // same, so redrawing an unchanged screen only hashes the visible lines.
+    // Lines are looked up by the hash of their contents, entries not used for
+    // a frame are dropped once there are more than MAX_LINES of them.
+    class LineLayoutCache
+    {
+    public:
+        LineLayoutCache();
+
+        // Drops everything if the parameters changed since the last frame.
+        // Glyphs drawn out of the cache are not looked up again, so they need
+        // to be touched in the font to stay in its atlas.
+        void BeginFrame(const LayoutParams& params);
+        void Clear();
+        // Lines longer than MAX_LINE_LENGTH are not cached and return nullptr.
+        const LineLayout* Get(const char* data, size_t length);
+
+        inline size_t GetHits() const { return m_Hits; }
+        inline size_t GetMisses() const { return m_Misses; }
+
+        // Text is decoded as UTF-8, every codepoint taking up a column and tabs
+        // stopping every TAB_SIZE columns. Stops after maxRows rows, and if
+        // cursorOffset is inside the line, stores the pen position after the
+        // character holding byte cursorOffset - 1 in o_CursorX and o_CursorY.
+        static void Layout(const char* data, size_t length, const LayoutParams& params, LineLayout& o_Layout,
+                           uint32_t maxRows = UINT32_MAX, size_t cursorOffset = SIZE_MAX,
+                           float* o_CursorX = nullptr, float* o_CursorY = nullptr);
+    public:
+        static constexpr size_t MAX_LINES = 4096;
+        static constexpr size_t MAX_LINE_LENGTH = 4096;
+        static constexpr size_t TAB_SIZE = 4;
+    private:
+        std::unordered_map<uint64_t, LineLayout> m_Lines;
+        LayoutParams m_Params;
+        uint64_t m_Frame;
+        uint32_t m_AtlasGeneration;
+        size_t m_Hits, m_Misses;
+    };
+}
+
+#endif // _DCE_GLYPH_LAYOUT_H
@@ -0,0 +1,36 @@
+#ifndef _DCE_HASH_H
+#define _DCE_HASH_H
+
+#include <cstring>
+
+#include "Core.h"
+
+namespace dce
+{
+    // Fast 64-bit hash of a byte range, consumed a word at a time. Not meant
+    // to hold up against crafted input.
+    inline uint64_t HashBytes(const char* data, size_t size)
+    {
+        const uint64_t MULTIPLIER = 0x9e3779b97f4a7c15ull;
+        uint64_t hash = size * MULTIPLIER;
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * MULTIPLIER;
+            hash ^= hash >> 32;
+        }
+        if(i < size)
+        {
+            uint64_t word = 0;
+            memcpy(&word, data + i, size - i);
+            hash = (hash ^ word) * MULTIPLIER;
+            hash ^= hash >> 32;
+        }
+        hash *= MULTIPLIER;
+        return hash ^ (hash >> 29);
+    }
+}
+
+#endif // _DCE_HASH_H
@@ -0,0 +1,491 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Lexer.h"
+#include "Syntax.h"
+
+namespace dce
+{
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+    // Longer words are never looked up.
+    static constexpr size_t MAX_WORD_LENGTH = 32;
+    // Lexing in the background checks the deadline every time it got
+    // through this many bytes, counting every line as a few more.
+    static constexpr size_t DEADLINE_CHECK_INTERVAL = 0x4000ul;
+    static constexpr size_t LINE_WORK = 16;
+    // How long drawing waits for the lines above the visible ones to be
+    // lexed before it goes with the first one's old state.
+    static constexpr auto CATCH_UP_TIME = std::chrono::microseconds(1000);
+
+    static inline void Fill(HighlightKind* o_Kinds, size_t from, size_t to, HighlightKind kind)
+    {
+        if(o_Kinds)
+            std::fill(o_Kinds + from, o_Kinds + to, kind);
+    }
+
+    static inline bool StartsWith(const char* data, size_t position, size_t length, const char* prefix, size_t prefixLength)
+    {
+        return prefixLength && position + prefixLength <= length && memcmp(data + position, prefix, prefixLength) == 0;
+    }
+
+    Lexer::Lexer()
+    {
+        m_Rules = nullptr;
+        m_QuoteCount = 0;
+        m_LineCommentLength = 0;
+        m_CommentStartLength = 0;
+        m_CommentEndLength = 0;
+        m_Text = nullptr;
+        m_Lines = nullptr;
+        m_Task = Scheduler::NO_TASK;
+        m_ValidLines = 1;
+        m_LexedLines = 1;
+        m_DirtyEnd = 0;
+        m_GuessedLine = 0;
+        m_Guessed = false;
+        m_WindowStart = 0;
+    }
+
+    Lexer::~Lexer()
+    {
+        Scheduler::Cancel(m_Task);
+    }
+
+    void Lexer::SetRules(const LexRules* rules)
+    {
+        Reset();
+        m_Rules = rules;
+        m_Words.clear();
+        if(!rules)
+            return;
+
+        for(size_t c = 0; c < 256; ++c)
+        {
+            if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c >= 0x80)
+                m_Classes[c] = IDENT;
+            else if(c >= '0' && c <= '9')
+                m_Classes[c] = DIGIT;
+            else
+                m_Classes[c] = OTHER;
+            m_SymbolKinds[c] = HighlightKind::NONE;
+        }
+        for(const char* c = rules->Operators; c && *c; ++c)
+        {
+            m_Classes[(uint8_t)*c] = SYMBOL;
+            m_SymbolKinds[(uint8_t)*c] = HighlightKind::OPERATOR;
+        }
+        for(const char* c = rules->Delimiters; c && *c; ++c)
+        {
+            m_Classes[(uint8_t)*c] = SYMBOL;
+            m_SymbolKinds[(uint8_t)*c] = HighlightKind::DELIMITER;
+        }
+        if(rules->Directives)
+            m_Classes[(uint8_t)'#'] = DIRECTIVE;
+        for(const char* c = rules->Quotes; c && *c; ++c)
+            m_Classes[(uint8_t)*c] = QUOTE;
+        m_QuoteCount = rules->Quotes ? strlen(rules->Quotes) : 0;
+        // Characters that don't end up starting a comment are looked up in
+        // m_SymbolKinds.
+        m_LineCommentLength = rules->LineComment ? strlen(rules->LineComment) : 0;
+        m_CommentStartLength = rules->BlockCommentStart ? strlen(rules->BlockCommentStart) : 0;
+        m_CommentEndLength = rules->BlockCommentEnd ? strlen(rules->BlockCommentEnd) : 0;
+        if(m_LineCommentLength)
+            m_Classes[(uint8_t)rules->LineComment[0]] = COMMENT;
+        if(m_CommentStartLength && m_CommentEndLength)
+            m_Classes[(uint8_t)rules->BlockCommentStart[0]] = COMMENT;
+
+        size_t wordCount = 0;
+        for(const char* const* list : { rules->Keywords, rules->Types, rules->Constants })
+        {
+            for(const char* const* word = list; word && *word; ++word)
+                ++wordCount;
+        }
+        size_t tableSize = 16;
+        while(tableSize < wordCount * 4)
+            tableSize <<= 1;
+        m_Words.assign(tableSize, { nullptr, 0, HighlightKind::NONE });
+        AddWords(rules->Keywords, HighlightKind::KEYWORD);
+        AddWords(rules->Types, HighlightKind::TYPE);
+        AddWords(rules->Constants, HighlightKind::CONSTANT);
+    }
+
+    void Lexer::Reset()
+    {
+        Scheduler::Cancel(m_Task);
+        m_Task = Scheduler::NO_TASK;
+        m_Text = nullptr;
+        m_Lines = nullptr;
+        m_ValidLines = 1;
+        m_LexedLines = 1;
+        m_DirtyEnd = 0;
+        m_Guessed = false;
+        m_Window.clear();
+    }
+
+    void Lexer::OnInsert(const LineIndex& lines, size_t position, const char* data, size_t count)
+    {
+        if(!m_Rules)
+            return;
+        size_t added = 0;
+        for(const char* cur = data, *end = data + count; (cur = (const char*)memchr(cur, '\n', (size_t)(end - cur))); ++cur)
+            ++added;
+        OnEdit(lines.GetLineOf(position), added, 0);
+    }
+
+    void Lexer::OnErase(const LineIndex& lines, size_t position, size_t count)
+    {
+        if(!m_Rules)
+            return;
+        size_t line = lines.GetLineOf(position);
+        OnEdit(line, 0, lines.GetLineOf(position + count) - line);
+    }
+
+    void Lexer::OnEdit(size_t line, size_t added, size_t removed)
+    {
+        m_Window.clear();
+        if(m_ValidLines >= m_LexedLines)
+            m_DirtyEnd = 0;
+
+        // The edited line still starts in the same state, the ones after it
+        // move along with the newlines.
+        if(m_LexedLines > line + 1 + removed)
+            m_LexedLines = m_LexedLines - removed + added;
+        else if(m_LexedLines > line + 1)
+            m_LexedLines = line + 1;
+        if(m_DirtyEnd > line + removed)
+            m_DirtyEnd = m_DirtyEnd - removed + added;
+        else if(m_DirtyEnd > line)
+            m_DirtyEnd = line;
+        m_DirtyEnd = std::max(m_DirtyEnd, line + added);
+        m_ValidLines = std::min(m_ValidLines, line + 1);
+    }
+
+    bool Lexer::Update()
+    {
+        if(!m_Guessed || m_ValidLines <= m_GuessedLine)
+            return false;
+        m_Guessed = false;
+        return true;
+    }
+
+    const HighlightKind* Lexer::Highlight(const TextBuffer& text, LineIndex& lines, size_t start, size_t size)
+    {
+        if(!m_Rules)
+            return nullptr;
+        if(m_Text != &text)
+            m_Window.clear();
+        m_Text = &text;
+        m_Lines = &lines;
+
+        size_t line = lines.GetLineOf(start);
+        if(line >= m_ValidLines)
+            LexLines(line + 1, Scheduler::Clock::now() + CATCH_UP_TIME);
+        uint8_t state = NORMAL;
+        m_Guessed = false;
+        if(line > 0)
+        {
+            state = lines.GetTag(line);
+            // Still to be lexed, drawn with whatever state the line had
+            // before the edits for now.
+            if(line >= m_ValidLines)
+            {
+                m_Guessed = true;
+                m_GuessedLine = line;
+                if(state >= STRING + m_QuoteCount)
+                    state = NORMAL;
+            }
+        }
+
+        size_t lineStart = lines.GetLineStart(line);
+        m_Visible.resize(start + size - lineStart);
+        text.Read(lineStart, m_Visible.size(), m_Visible.data());
+        m_Kinds.assign(m_Visible.size(), HighlightKind::NONE);
+        const char* data = m_Visible.data();
+        for(size_t from = 0; from < m_Visible.size(); )
+        {
+            const char* newline = (const char*)memchr(data + from, '\n', m_Visible.size() - from);
+            size_t to = newline ? (size_t)(newline - data) + 1 : m_Visible.size();
+            state = LexLine(data + from, to - from, state, m_Kinds.data() + from);
+            from = to;
+        }
+
+        if(m_ValidLines < lines.GetLineCount() && m_Task == Scheduler::NO_TASK)
+            m_Task = Scheduler::Post([this](Scheduler::Clock::time_point deadline) { return LexInBackground(deadline); });
+        return m_Kinds.data() + (start - lineStart);
+    }
+
+    bool Lexer::LexLines(size_t endLine, Scheduler::Clock::time_point deadline)
+    {
+        LineIndex& lines = *m_Lines;
+        endLine = std::min(endLine, lines.GetLineCount());
+        while(m_ValidLines < endLine)
+        {
+            // Picks up after the last line that's known to start right.
+            size_t line = m_ValidLines - 1;
+            size_t position = lines.GetLineStart(line);
+            uint8_t state = NORMAL;
+            size_t work = 0;
+            bool timedOut = false;
+            lines.VisitLines(line, [&](uint8_t& tag, size_t length)
+            {
+                if(line == m_ValidLines)
+                {
+                    // The rest was lexed from this very state before.
+                    if(line > m_DirtyEnd && line < m_LexedLines && tag == state)
+                    {
+                        m_ValidLines = m_LexedLines;
+                        return false;
+                    }
+                    tag = state;
+                    m_LexedLines = std::max(m_LexedLines, ++m_ValidLines);
+                    if(m_ValidLines >= endLine)
+                        return false;
+                }
+                else if(line > 0)
+                    state = tag;
+
+                work += length + LINE_WORK;
+                if(work >= DEADLINE_CHECK_INTERVAL)
+                {
+                    work = 0;
+                    if(Scheduler::Clock::now() >= deadline)
+                    {
+                        timedOut = true;
+                        return false;
+                    }
+                }
+                size_t lexed = std::min(length, MAX_LEXED_LINE);
+                state = LexLine(ReadText(position, lexed), lexed, state, nullptr);
+                position += length;
+                ++line;
+                return true;
+            });
+            if(timedOut)
+                return false;
+        }
+        return true;
+    }
+
+    TaskStatus Lexer::LexInBackground(Scheduler::Clock::time_point deadline)
+    {
+        if(!LexLines(m_Lines->GetLineCount(), deadline))
+            return TaskStatus::YIELDED;
+        m_Task = Scheduler::NO_TASK;
+        return TaskStatus::DONE;
+    }
+
+    const char* Lexer::ReadText(size_t position, size_t size)
+    {
+        // Lines are read a window at a time, most are far shorter.
+        if(position < m_WindowStart || position + size > m_WindowStart + m_Window.size())
+        {
+            m_WindowStart = position;
+            m_Window.resize(std::min(std::max(size, LEX_WINDOW_SIZE), m_Text->Size() - position));
+            m_Text->Read(position, m_Window.size(), m_Window.data());
+        }
+        return m_Window.data() + (position - m_WindowStart);
+    }
+
+    uint8_t Lexer::LexLine(const char* data, size_t length, uint8_t state, HighlightKind* o_Kinds) const
+    {
+        const LexRules& rules = *m_Rules;
+        size_t i = 0;
+        if(state == BLOCK_COMMENT)
+        {
+            i = FindCommentEnd(data, 0, length);
+            if(i == NOT_FOUND)
+            {
+                Fill(o_Kinds, 0, length, HighlightKind::COMMENT);
+                return BLOCK_COMMENT;
+            }
+            Fill(o_Kinds, 0, i, HighlightKind::COMMENT);
+        }
+        else if(state >= STRING)
+        {
+            char quote = rules.Quotes[state - STRING];
+            bool continues;
+            i = FindStringEnd(data, 0, length, quote, &continues);
+            if(i == NOT_FOUND)
+            {
+                Fill(o_Kinds, 0, length, HighlightKind::STRING);
+                return continues || IsMultiline(quote) ? state : NORMAL;
+            }
+            Fill(o_Kinds, 0, i, HighlightKind::STRING);
+        }
+
+        while(i < length)
+        {
+            uint8_t c = (uint8_t)data[i];
+            switch(m_Classes[c])
+            {
+            case IDENT:
+            {
+                size_t end = i + 1;
+                while(end < length && (m_Classes[(uint8_t)data[end]] == IDENT || m_Classes[(uint8_t)data[end]] == DIGIT))
+                    ++end;
+                if(o_Kinds)
+                    Fill(o_Kinds, i, end, GetWordKind(data, i, end, length));
+                i = end;
+                break;
+            }
+            case DIGIT:
+            {
+                size_t end = i + 1;
+                while(end < length && (m_Classes[(uint8_t)data[end]] == IDENT || m_Classes[(uint8_t)data[end]] == DIGIT ||
+                                       data[end] == '.'))
+                    ++end;
+                Fill(o_Kinds, i, end, HighlightKind::NUMBER);
+                i = end;
+                break;
+            }
+            case QUOTE:
+            {
+                bool continues;
+                size_t end = FindStringEnd(data, i + 1, length, (char)c, &continues);
+                if(end == NOT_FOUND)
+                {
+                    Fill(o_Kinds, i, length, HighlightKind::STRING);
+                    if(continues || IsMultiline((char)c))
+                        return (uint8_t)(STRING + (strchr(rules.Quotes, c) - rules.Quotes));
+                    return NORMAL;
+                }
+                Fill(o_Kinds, i, end, HighlightKind::STRING);
+                i = end;
+                break;
+            }
+            case COMMENT:
+            {
+                if(StartsWith(data, i, length, rules.BlockCommentStart, m_CommentStartLength))
+                {
+                    size_t end = FindCommentEnd(data, i + m_CommentStartLength, length);
+                    if(end == NOT_FOUND)
+                    {
+                        Fill(o_Kinds, i, length, HighlightKind::COMMENT);
+                        return BLOCK_COMMENT;
+                    }
+                    Fill(o_Kinds, i, end, HighlightKind::COMMENT);
+                    i = end;
+                }
+                else if(StartsWith(data, i, length, rules.LineComment, m_LineCommentLength))
+                {
+                    Fill(o_Kinds, i, length, HighlightKind::COMMENT);
+                    return NORMAL;
+                }
+                else
+                {
+                    Fill(o_Kinds, i, i + 1, m_SymbolKinds[c]);
+                    ++i;
+                }
+                break;
+            }
+            case DIRECTIVE:
+            {
+                // Covers the directive's name too, like "# include".
+                size_t end = i + 1;
+                while(end < length && (data[end] == ' ' || data[end] == '\t'))
+                    ++end;
+                while(end < length && m_Classes[(uint8_t)data[end]] == IDENT)
+                    ++end;
+                Fill(o_Kinds, i, end, HighlightKind::KEYWORD);
+                i = end;
+                break;
+            }
+            case SYMBOL:
+                Fill(o_Kinds, i, i + 1, m_SymbolKinds[c]);
+                ++i;
+                break;
+            default:
+                ++i;
+                break;
+            }
+        }
+        return NORMAL;
+    }
+
+    bool Lexer::IsMultiline(char quote) const
+    {
+        return m_Rules->MultilineQuotes && strchr(m_Rules->MultilineQuotes, quote);
+    }
+
+    size_t Lexer::FindStringEnd(const char* data, size_t from, size_t length, char quote, bool* o_Continues) const
+    {
+        // A backslash right before the newline carries any string over.
+        *o_Continues = false;
+        for(size_t i = from; i < length; ++i)
+        {
+            if(data[i] == quote)
+                return i + 1;
+            if(data[i] == '\\' && ++i < length && data[i] == '\n')
+            {
+                *o_Continues = true;
+                break;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    size_t Lexer::FindCommentEnd(const char* data, size_t from, size_t length) const
+    {
+        const char* end = m_Rules->BlockCommentEnd;
+        while(from + m_CommentEndLength <= length)
+        {
+            const char* found = (const char*)memchr(data + from, end[0], length - from - m_CommentEndLength + 1);
+            if(!found)
+                break;
+            size_t position = (size_t)(found - data);
+            if(memcmp(found, end, m_CommentEndLength) == 0)
+                return position + m_CommentEndLength;
+            from = position + 1;
+        }
+        return NOT_FOUND;
+    }
+
+    HighlightKind Lexer::GetWordKind(const char* data, size_t start, size_t end, size_t length) const
+    {
+        size_t wordLength = end - start;
+        if(wordLength <= MAX_WORD_LENGTH && !m_Words.empty())
+        {
+            size_t mask = m_Words.size() - 1;
+            for(size_t slot = HashWord(data + start, wordLength) & mask; m_Words[slot].Text; slot = (slot + 1) & mask)
+            {
+                const Word& word = m_Words[slot];
+                if(word.Length == wordLength && memcmp(word.Text, data + start, wordLength) == 0)
+                    return word.Kind;
+            }
+        }
+        if(!m_Rules->CNames)
+            return HighlightKind::NONE;
+
+        size_t next = end;
+        while(next < length && (data[next] == ' ' || data[next] == '\t'))
+            ++next;
+        if(next < length && data[next] == '(')
+            return HighlightKind::FUNCTION;
+        bool caps = wordLength > 1;
+        for(size_t i = start; i < end && caps; ++i)
+            caps = !(data[i] >= 'a' && data[i] <= 'z');
+        return caps ? HighlightKind::CONSTANT : HighlightKind::NONE;
+    }
+
+    void Lexer::AddWords(const char* const* words, HighlightKind kind)
+    {
+        size_t mask = m_Words.size() - 1;
+        for(const char* const* word = words; word && *word; ++word)
+        {
+            size_t length = strlen(*word);
+            size_t slot = HashWord(*word, length) & mask;
+            while(m_Words[slot].Text)
+                slot = (slot + 1) & mask;
+            m_Words[slot] = { *word, length, kind };
+        }
+    }
+
+    // FNV-1a
+    uint32_t Lexer::HashWord(const char* word, size_t length)
+    {
+        uint32_t hash = 2166136261u;
+        for(size_t i = 0; i < length; ++i)
+            hash = (hash ^ (uint8_t)word[i]) * 16777619u;
+        return hash;
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef _DCE_LEXER_H
+#define _DCE_LEXER_H
+
+#include <vector>
+
+#include "Core.h"
+#include "LineIndex.h"
+#include "Scheduler.h"
+#include "TextBuffer.h"
+
+namespace dce
+{
+    enum class HighlightKind : uint8_t;
+
+    // What the lexer needs to know about a language. Lists of words are
+    // terminated by a nullptr.
+    struct LexRules
+    {
+        const char* LineComment;
+        const char* BlockCommentStart;
+        const char* BlockCommentEnd;
+        const char* Quotes;
+        const char* MultilineQuotes;    // Strings that go on past the end of a line.
+        const char* Operators;
+        const char* Delimiters;
+        const char* const* Keywords;
+        const char* const* Types;
+        const char* const* Constants;
+        bool Directives;    // '#' starts a preprocessor directive.
+        bool CNames;        // Words followed by '(' are functions, ones in all caps constants.
+    };
+
+    // Highlights by looking up every byte's class in a table, for files too
+    // large to parse and languages without a grammar. The only thing carried
+    // over from one line to the next is a state byte, which is kept as the
+    // line's tag in the line index. After an edit, lines are lexed again from
+    // the edited one until one ends in the state the next line already had,
+    // the rest are lexed by a Scheduler task. Drawing only lexes the visible
+    // lines, starting from the first one's state.
+    class Lexer
+    {
+    public:
+        Lexer();
+        Lexer(const Lexer&) = delete;
+        ~Lexer();
+
+        // Nothing is highlighted without rules.
+        void SetRules(const LexRules* rules);
+        // Forgets every line's state, needs to happen before the text buffer
+        // gets replaced or reloaded.
+        void Reset();
+        // Both go before the line index is changed.
+        void OnInsert(const LineIndex& lines, size_t position, const char* data, size_t count);
+        void OnErase(const LineIndex& lines, size_t position, size_t count);
+        // Whether lines that were drawn before their state was known have
+        // been lexed since.
+        bool Update();
+        // Kind of every byte from start up to start + size, or nullptr
+        // without rules.
+        const HighlightKind* Highlight(const TextBuffer& text, LineIndex& lines, size_t start, size_t size);
+    public:
+        // States a line can start in, strings go on from STRING with the
+        // index of their quote.
+        static constexpr uint8_t NORMAL = 0;
+        static constexpr uint8_t BLOCK_COMMENT = 1;
+        static constexpr uint8_t STRING = 2;
+        // Only this much of longer lines is looked at to find where they end.
+        static constexpr size_t MAX_LEXED_LINE = 0x100000ul;
+        static constexpr size_t LEX_WINDOW_SIZE = 0x10000ul;
+    private:
+        enum CharClass : uint8_t
+        {
+            OTHER,
+            IDENT,
+            DIGIT,
+            SYMBOL,
+            QUOTE,
+            COMMENT,
+            DIRECTIVE
+        };
+
+        struct Word
+        {
+            const char* Text;
+            size_t Length;
+            HighlightKind Kind;
+        };
+
+        void OnEdit(size_t line, size_t added, size_t removed);
+        // Lexes until the states of all lines before endLine are known or
+        // the deadline passes, returns whether they are.
+        bool LexLines(size_t endLine, Scheduler::Clock::time_point deadline);
+        TaskStatus LexInBackground(Scheduler::Clock::time_point deadline);
+        const char* ReadText(size_t position, size_t size);
+        // Returns the state the next line starts in. Kinds are only written
+        // if o_Kinds isn't nullptr.
+        uint8_t LexLine(const char* data, size_t length, uint8_t state, HighlightKind* o_Kinds) const;
+        bool IsMultiline(char quote) const;
+        size_t FindStringEnd(const char* data, size_t from, size_t length, char quote, bool* o_Continues) const;
+        size_t FindCommentEnd(const char* data, size_t from, size_t length) const;
+        HighlightKind GetWordKind(const char* data, size_t start, size_t end, size_t length) const;
+        void AddWords(const char* const* words, HighlightKind kind);
+        static uint32_t HashWord(const char* word, size_t length);
+    private:
+        const LexRules* m_Rules;
+        CharClass m_Classes[256];
+        HighlightKind m_SymbolKinds[256];
+        std::vector<Word> m_Words; // Open addressing, the size is a power of two.
+        size_t m_QuoteCount;
+        size_t m_LineCommentLength;
+        size_t m_CommentStartLength;
+        size_t m_CommentEndLength;
+
+        // Set by Highlight() for the task to lex.
+        const TextBuffer* m_Text;
+        LineIndex* m_Lines;
+        Scheduler::TaskID m_Task;
+        // The states of the lines before m_ValidLines are right. Those of the
+        // lines up to m_LexedLines were before the latest edits, and are
+        // again once a line past m_DirtyEnd, the last edited one, ends in the
+        // state the next one has.
+        size_t m_ValidLines;
+        size_t m_LexedLines;
+        size_t m_DirtyEnd;
+        size_t m_GuessedLine;
+        bool m_Guessed;
+
+        std::vector<char> m_Window;
+        size_t m_WindowStart;
+        std::vector<char> m_Visible;
+        std::vector<HighlightKind> m_Kinds;
+    };
+}
+
+#endif // _DCE_LEXER_H
@@ -0,0 +1,392 @@
+#include <cstring>
+#include <thread>
+
+#include "LineIndex.h"
+
+namespace dce
+{
+    LineIndex::LineIndex()
+    {
+        m_Seed = 0x6A09E667u;
+        Clear();
+    }
+
+    void LineIndex::Clear()
+    {
+        m_Lines.resize(1);
+        m_Lines[0] = { 0, 0, 0, 0, 0, 0 };
+        m_Tags.resize(1);
+        m_FreeLines.clear();
+        m_Root = NewLine(0);
+    }
+
+    void LineIndex::Build(const size_t* lengths, size_t count)
+    {
+        if(count == 0)
+        {
+            Clear();
+            return;
+        }
+
+        m_Lines.resize(count + 1);
+        m_Tags.assign(count + 1, NO_TAG);
+        m_FreeLines.clear();
+
+        // Priorities decrease with the heap index of each node in the balanced
+        // tree, which keeps the heap property while still spreading them over
+        // the whole range like the random priorities of later insertions.
+        uint32_t step = (uint32_t)(UINT32_MAX / (2 * (uint64_t)count + 1));
+        m_Root = BuildRange(lengths, 0, count, 1, step ? step : 1, BUILD_PARALLEL_DEPTH);
+    }
+
+    uint32_t LineIndex::BuildRange(const size_t* lengths, size_t lo, size_t hi, uint64_t heapIndex,
+                                   uint32_t step, int parallelDepth)
+    {
+        if(lo >= hi)
+            return 0;
+
+        size_t mid = lo + ((hi - lo) >> 1);
+        uint32_t left, right;
+        if(parallelDepth > 0 && hi - lo >= BUILD_PARALLEL_THRESHOLD)
+        {
+            std::thread worker([&]()
+            {
+                left = BuildRange(lengths, lo, mid, heapIndex << 1, step, parallelDepth - 1);
+            });
+            right = BuildRange(lengths, mid + 1, hi, (heapIndex << 1) + 1, step, parallelDepth - 1);
+            worker.join();
+        }
+        else
+        {
+            left = BuildRange(lengths, lo, mid, heapIndex << 1, step, 0);
+            right = BuildRange(lengths, mid + 1, hi, (heapIndex << 1) + 1, step, 0);
+        }
+
+        // Nodes are laid out in text order, which also keeps neighbouring
+        // lines close together in memory.
+        uint32_t node = (uint32_t)(mid + 1);
+        uint64_t priority = (uint64_t)step * heapIndex;
+        m_Lines[node] = { lengths[mid], 0, 0, left, right,
+                          priority < UINT32_MAX ? UINT32_MAX - (uint32_t)priority : 0 };
+        Update(node);
+        return node;
+    }
+
+    void LineIndex::SplitLastLine(const size_t* lengths, size_t count)
+    {
+        if(count == 0)
+            return;
+
+        size_t total = 0;
+        for(size_t i = 0; i < count; ++i)
+            total += lengths[i];
+
+        uint32_t left, last;
+        Split(m_Root, GetLineCount() - 1, &left, &last);
+        DCE_ASSERT(total <= m_Lines[last].Length, "Attempted to split %lu bytes off of a %lu byte line.\n",
+                   total, m_Lines[last].Length);
+        m_Lines[last].Length -= total;
+        Update(last);
+        uint32_t carved = BuildSubtree(lengths, count);
+        m_Tags[GetFirst(carved)] = m_Tags[last];
+        m_Tags[last] = NO_TAG;
+        m_Root = Merge(Merge(left, carved), last);
+    }
+
+    void LineIndex::OnInsert(size_t position, const char* data, size_t count)
+    {
+        if(count == 0)
+            return;
+
+        size_t line = GetLineOf(position);
+        const char* newline = (const char*)memchr(data, '\n', count);
+        if(!newline)
+        {
+            AddToLength(line, (int64_t)count);
+            return;
+        }
+
+        // The edited line now ends at the first inserted newline, every other
+        // newline starts a new line and the last new line also takes whatever
+        // followed the insertion point.
+        size_t offset = position - GetLineStart(line);
+        size_t length = GetLineLength(line);
+        AddToLength(line, (int64_t)(offset + (size_t)(newline - data) + 1) - (int64_t)length);
+
+        const char* cur = newline + 1;
+        const char* end = data + count;
+        uint32_t inserted = 0;
+        while((newline = (const char*)memchr(cur, '\n', (size_t)(end - cur))))
+        {
+            inserted = Merge(inserted, NewLine((size_t)(newline - cur) + 1));
+            cur = newline + 1;
+        }
+        inserted = Merge(inserted, NewLine((size_t)(end - cur) + length - offset));
+
+        uint32_t left, right;
+        Split(m_Root, line + 1, &left, &right);
+        m_Root = Merge(Merge(left, inserted), right);
+    }
+
+    void LineIndex::OnErase(size_t position, size_t count)
+    {
+        if(count == 0)
+            return;
+
+        DCE_ASSERT(position + count <= GetTextSize(), "Attempted to erase out of bounds %lu! Valid range is 0 - %lu.\n",
+                   position + count, GetTextSize());
+        size_t first = GetLineOf(position);
+        size_t last = GetLineOf(position + count);
+        if(first == last)
+        {
+            AddToLength(first, -(int64_t)count);
+            return;
+        }
+
+        // Every line touched by the erase collapses into a single line.
+        uint32_t left, mid, right;
+        Split(m_Root, first, &left, &mid);
+        Split(mid, last - first + 1, &mid, &right);
+        size_t length = m_Lines[mid].SubtreeLength - count;
+        uint8_t tag = m_Tags[GetFirst(mid)];
+        FreeLines(mid);
+        uint32_t merged = NewLine(length);
+        m_Tags[merged] = tag;
+        m_Root = Merge(Merge(left, merged), right);
+    }
+
+    size_t LineIndex::GetLineStart(size_t line) const
+    {
+        if(line >= GetLineCount())
+            return GetTextSize();
+
+        size_t start = 0;
+        uint32_t node = m_Root;
+        while(node)
+        {
+            const Line& l = m_Lines[node];
+            uint32_t leftCount = m_Lines[l.Left].Count;
+            if(line < leftCount)
+            {
+                node = l.Left;
+                continue;
+            }
+            start += m_Lines[l.Left].SubtreeLength;
+            if(line == leftCount)
+                break;
+            line -= leftCount + 1;
+            start += l.Length;
+            node = l.Right;
+        }
+        return start;
+    }
+
+    size_t LineIndex::GetLineLength(size_t line) const
+    {
+        DCE_ASSERT(line < GetLineCount(), "Attempted to access line out of bounds %lu! Valid range is 0 - %lu.\n",
+                   line, GetLineCount() - 1);
+        uint32_t node = m_Root;
+        while(node)
+        {
+            const Line& l = m_Lines[node];
+            uint32_t leftCount = m_Lines[l.Left].Count;
+            if(line < leftCount)
+                node = l.Left;
+            else if(line == leftCount)
+                return l.Length;
+            else
+            {
+                line -= leftCount + 1;
+                node = l.Right;
+            }
+        }
+        return 0;
+    }
+
+    size_t LineIndex::GetLineOf(size_t position) const
+    {
+        size_t line = 0;
+        uint32_t node = m_Root;
+        while(node)
+        {
+            const Line& l = m_Lines[node];
+            size_t leftLength = m_Lines[l.Left].SubtreeLength;
+            if(position < leftLength)
+            {
+                node = l.Left;
+                continue;
+            }
+            position -= leftLength;
+            line += m_Lines[l.Left].Count;
+            if(position < l.Length)
+                return line;
+            position -= l.Length;
+            ++line;
+            node = l.Right;
+        }
+        // Only reached for the end of the text, which belongs to the last line.
+        return GetLineCount() - 1;
+    }
+
+    uint8_t LineIndex::GetTag(size_t line) const
+    {
+        DCE_ASSERT(line < GetLineCount(), "Attempted to access line out of bounds %lu! Valid range is 0 - %lu.\n",
+                   line, GetLineCount() - 1);
+        uint32_t node = m_Root;
+        while(node)
+        {
+            const Line& l = m_Lines[node];
+            uint32_t leftCount = m_Lines[l.Left].Count;
+            if(line < leftCount)
+                node = l.Left;
+            else if(line == leftCount)
+                return m_Tags[node];
+            else
+            {
+                line -= leftCount + 1;
+                node = l.Right;
+            }
+        }
+        return NO_TAG;
+    }
+
+    // Linear time treap construction with random priorities from an already
+    // ordered sequence: the stack holds the right spine, and a node's subtree
+    // is final once it gets popped off of it.
+    uint32_t LineIndex::BuildSubtree(const size_t* lengths, size_t count)
+    {
+        std::vector<uint32_t> spine;
+        for(size_t i = 0; i < count; ++i)
+        {
+            uint32_t node = NewLine(lengths[i]);
+            uint32_t last = 0;
+            while(!spine.empty() && m_Lines[spine.back()].Priority < m_Lines[node].Priority)
+            {
+                last = spine.back();
+                spine.pop_back();
+                Update(last);
+            }
+            m_Lines[node].Left = last;
+            if(!spine.empty())
+                m_Lines[spine.back()].Right = node;
+            spine.push_back(node);
+        }
+        for(size_t i = spine.size(); i > 0; )
+            Update(spine[--i]);
+        return spine.empty() ? 0 : spine.front();
+    }
+
+    uint32_t LineIndex::NewLine(size_t length)
+    {
+        uint32_t index;
+        if(!m_FreeLines.empty())
+        {
+            index = m_FreeLines.back();
+            m_FreeLines.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)m_Lines.size();
+            m_Lines.emplace_back();
+            m_Tags.emplace_back();
+        }
+        m_Lines[index] = { length, length, 1, 0, 0, NextPriority() };
+        m_Tags[index] = NO_TAG;
+        return index;
+    }
+
+    void LineIndex::FreeLines(uint32_t node)
+    {
+        if(!node)
+            return;
+        FreeLines(m_Lines[node].Left);
+        FreeLines(m_Lines[node].Right);
+        m_FreeLines.push_back(node);
+    }
+
+    uint32_t LineIndex::GetFirst(uint32_t node) const
+    {
+        while(m_Lines[node].Left)
+            node = m_Lines[node].Left;
+        return node;
+    }
+
+    void LineIndex::Split(uint32_t node, size_t count, uint32_t* o_Left, uint32_t* o_Right)
+    {
+        if(!node)
+        {
+            *o_Left = 0;
+            *o_Right = 0;
+            return;
+        }
+
+        uint32_t l, r;
+        size_t leftCount = m_Lines[m_Lines[node].Left].Count;
+        if(count <= leftCount)
+        {
+            Split(m_Lines[node].Left, count, &l, &r);
+            m_Lines[node].Left = r;
+            Update(node);
+            *o_Left = l;
+            *o_Right = node;
+        }
+        else
+        {
+            Split(m_Lines[node].Right, count - leftCount - 1, &l, &r);
+            m_Lines[node].Right = l;
+            Update(node);
+            *o_Left = node;
+            *o_Right = r;
+        }
+    }
+
+    uint32_t LineIndex::Merge(uint32_t left, uint32_t right)
+    {
+        if(!left)
+            return right;
+        if(!right)
+            return left;
+
+        if(m_Lines[left].Priority > m_Lines[right].Priority)
+        {
+            m_Lines[left].Right = Merge(m_Lines[left].Right, right);
+            Update(left);
+            return left;
+        }
+        m_Lines[right].Left = Merge(left, m_Lines[right].Left);
+        Update(right);
+        return right;
+    }
+
+    void LineIndex::AddToLength(size_t line, int64_t delta)
+    {
+        uint32_t node = m_Root;
+        while(node)
+        {
+            Line& l = m_Lines[node];
+            l.SubtreeLength += (size_t)delta;
+            uint32_t leftCount = m_Lines[l.Left].Count;
+            if(line < leftCount)
+                node = l.Left;
+            else if(line == leftCount)
+            {
+                l.Length += (size_t)delta;
+                return;
+            }
+            else
+            {
+                line -= leftCount + 1;
+                node = l.Right;
+            }
+        }
+    }
+
+    uint32_t LineIndex::NextPriority()
+    {
+        // xorshift32, priorities only need to be well spread, not secure.
+        m_Seed ^= m_Seed << 13;
+        m_Seed ^= m_Seed >> 17;
+        m_Seed ^= m_Seed << 5;
+        return m_Seed;
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef _DCE_LINE_INDEX_H
+#define _DCE_LINE_INDEX_H
+
+#include <vector>
+
+#include "Core.h"
+
+namespace dce
+{
+    // Keeps the length of every line (including its trailing newline) in an
+    // implicit treap with subtree sums, so lines never store absolute offsets
+    // and an edit only touches O(log n) nodes. Line numbers are 0 based and
+    // there is always at least one (possibly empty) line.
+    // Every line also carries a tag byte for whoever needs to keep something
+    // per line, like a lexer its state. A tag stays with where its line
+    // starts: lines merged by an erase keep the first one's tag and lines
+    // that start somewhere new get NO_TAG.
+    class LineIndex
+    {
+    public:
+        LineIndex();
+
+        void Clear();
+        // Replaces the index with 'count' lines of the given lengths. Every
+        // line except the last is expected to end in a newline.
+        void Build(const size_t* lengths, size_t count);
+        // Carves 'count' complete lines of the given lengths off the front of
+        // the last line, used to grow the index while a file is still loading.
+        void SplitLastLine(const size_t* lengths, size_t count);
+        // Makes room for lineCount lines in total without reallocating.
+        inline void Reserve(size_t lineCount)
+        {
+            m_Lines.reserve(lineCount + 1);
+            m_Tags.reserve(lineCount + 1);
+        }
+        inline size_t GetCapacity() const { return m_Lines.capacity() - 1; }
+        void OnInsert(size_t position, const char* data, size_t count);
+        void OnErase(size_t position, size_t count);
+
+        // Accepts line == GetLineCount(), which returns the total text size.
+        size_t GetLineStart(size_t line) const;
+        size_t GetLineLength(size_t line) const;
+        size_t GetLineOf(size_t position) const;
+        uint8_t GetTag(size_t line) const;
+        // Calls visit(uint8_t& tag, size_t length) for the lines from first
+        // on in order, until it returns false or the lines run out. Costs
+        // O(log n) for the first line and amortized O(1) for the rest.
+        template<typename Visitor>
+        void VisitLines(size_t first, Visitor visit);
+        inline size_t GetLineCount() const { return m_Lines[m_Root].Count; }
+        inline size_t GetTextSize() const { return m_Lines[m_Root].SubtreeLength; }
+        inline size_t GetMemoryUsage() const { return m_Lines.capacity() * (sizeof(Line) + sizeof(uint8_t)); }
+    public:
+        static constexpr uint8_t NO_TAG = 0xFF;
+        static constexpr int BUILD_PARALLEL_DEPTH = 3;
+        static constexpr size_t BUILD_PARALLEL_THRESHOLD = 0x40000ul;
+    private:
+        struct Line
+        {
+            size_t Length;
+            size_t SubtreeLength;
+            uint32_t Count;
+            uint32_t Left, Right;
+            uint32_t Priority;
+        };
+
+        uint32_t BuildRange(const size_t* lengths, size_t lo, size_t hi, uint64_t heapIndex,
+                            uint32_t step, int parallelDepth);
+        uint32_t BuildSubtree(const size_t* lengths, size_t count);
+        uint32_t NewLine(size_t length);
+        void FreeLines(uint32_t node);
+        uint32_t GetFirst(uint32_t node) const;
+        void Split(uint32_t node, size_t count, uint32_t* o_Left, uint32_t* o_Right);
+        uint32_t Merge(uint32_t left, uint32_t right);
+        void AddToLength(size_t line, int64_t delta);
+        uint32_t NextPriority();
+
+        inline void Update(uint32_t node)
+        {
+            Line& l = m_Lines[node];
+            l.SubtreeLength = m_Lines[l.Left].SubtreeLength + l.Length + m_Lines[l.Right].SubtreeLength;
+            l.Count = m_Lines[l.Left].Count + 1 + m_Lines[l.Right].Count;
+        }
+    private:
+        std::vector<Line> m_Lines; // Index 0 is an empty sentinel used as the null child.
+        std::vector<uint8_t> m_Tags; // Parallel to m_Lines, kept apart so they don't pad every node.
+        std::vector<uint32_t> m_FreeLines;
+        std::vector<uint32_t> m_VisitStack;
+        uint32_t m_Root;
+        uint32_t m_Seed;
+    };
+
+    template<typename Visitor>
+    void LineIndex::VisitLines(size_t first, Visitor visit)
+    {
+        // The stack holds every node on the way down whose line comes after
+        // the current one, same as an in-order walk that started at the root.
+        m_VisitStack.clear();
+        uint32_t node = m_Root;
+        while(node)
+        {
+            const Line& l = m_Lines[node];
+            uint32_t leftCount = m_Lines[l.Left].Count;
+            if(first <= leftCount)
+            {
+                m_VisitStack.push_back(node);
+                if(first == leftCount)
+                    break;
+                node = l.Left;
+            }
+            else
+            {
+                first -= leftCount + 1;
+                node = l.Right;
+            }
+        }
+        while(!m_VisitStack.empty())
+        {
+            node = m_VisitStack.back();
+            m_VisitStack.pop_back();
+            if(!visit(m_Tags[node], m_Lines[node].Length))
+                return;
+            for(node = m_Lines[node].Right; node; node = m_Lines[node].Left)
+                m_VisitStack.push_back(node);
+        }
+    }
+}
+
+#endif // _DCE_LINE_INDEX_H
@@ -0,0 +1,89 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MappedFile.h"
+
+namespace dce
+{
+    MappedFile::MappedFile(MappedFile&& temp)
+    {
+        m_Data = temp.m_Data;
+        m_Size = temp.m_Size;
+        temp.m_Data = nullptr;
+        temp.m_Size = 0;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    bool MappedFile::Open(const std::string& filepath)
+    {
+        Close();
+        int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            return false;
+
+        struct stat statbuf;
+        if(fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file.
+        close(fd);
+        if(data == MAP_FAILED)
+            return false;
+
+        m_Data = (const char*)data;
+        m_Size = (size_t)statbuf.st_size;
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if(m_Data)
+            munmap((void*)m_Data, m_Size);
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+    void MappedFile::AdviseSequential()
+    {
+        if(m_Data)
+            madvise((void*)m_Data, m_Size, MADV_SEQUENTIAL);
+    }
+
+    void MappedFile::DropResidentPages()
+    {
+        if(m_Data)
+            DropResidentPages(m_Data, m_Size);
+    }
+
+    void MappedFile::DropResidentPages(const char* data, size_t size)
+    {
+        // madvise wants a page aligned start.
+        uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)data & ~(pageSize - 1);
+        size += (uintptr_t)data - begin;
+        madvise((void*)begin, size, MADV_DONTNEED);
+        madvise((void*)begin, size, MADV_NORMAL);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& temp)
+    {
+        if(this == &temp)
+            return *this;
+        Close();
+        m_Data = temp.m_Data;
+        m_Size = temp.m_Size;
+        temp.m_Data = nullptr;
+        temp.m_Size = 0;
+        return *this;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef _DCE_MAPPED_FILE_H
+#define _DCE_MAPPED_FILE_H
+
+#include <string>
+
+#include "Core.h"
+
+namespace dce
+{
+    // Read-only private mapping of a whole file. The mapping stays valid even if
+    // the file is renamed over or deleted, but truncating it from another
+    // process makes accesses past the new end fault.
+    class MappedFile
+    {
+    public:
+        MappedFile() : m_Data(nullptr), m_Size(0) {}
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&& temp);
+        ~MappedFile();
+
+        bool Open(const std::string& filepath);
+        void Close();
+        void AdviseSequential();
+        // Drops the pages from this process' resident set, they are faulted
+        // back in from the page cache the next time they are touched.
+        void DropResidentPages();
+        // Same for a range inside any read-only file mapping.
+        static void DropResidentPages(const char* data, size_t size);
+
+        MappedFile& operator=(MappedFile&& temp);
+
+        inline const char* Data() const { return m_Data; }
+        inline size_t Size() const { return m_Size; }
+        inline bool IsOpen() const { return m_Data != nullptr; }
+    private:
+        const char* m_Data;
+        size_t m_Size;
+    };
+}
+
+#endif // _DCE_MAPPED_FILE_H
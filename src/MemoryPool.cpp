@@ -0,0 +1,83 @@
+#include <mutex>
+#include <vector>
+
+#include "MemoryPool.h"
+
+namespace dce
+{
+    namespace MemoryPool
+    {
+        struct PoolState
+        {
+            std::mutex Mutex;
+            std::vector<void*> FreeBlocks[MAX_SIZE_CLASS + 1];
+            size_t CachedBytes = 0;
+        };
+
+        // Never destroyed, buffers that are static themselves may still give
+        // their blocks back while the program exits.
+        static PoolState& GetState()
+        {
+            static PoolState* state = new PoolState();
+            return *state;
+        }
+
+        static int GetSizeClass(size_t size)
+        {
+            int sizeClass = MIN_SIZE_CLASS;
+            while(((size_t)1 << sizeClass) < size)
+                ++sizeClass;
+            return sizeClass;
+        }
+
+        void* Allocate(size_t size, size_t* o_Capacity)
+        {
+            if(size > MAX_POOLED_SIZE)
+            {
+                *o_Capacity = size;
+                return malloc(size);
+            }
+
+            int sizeClass = GetSizeClass(size);
+            *o_Capacity = (size_t)1 << sizeClass;
+            {
+                PoolState& state = GetState();
+                std::lock_guard<std::mutex> lock(state.Mutex);
+                std::vector<void*>& freeBlocks = state.FreeBlocks[sizeClass];
+                if(!freeBlocks.empty())
+                {
+                    void* block = freeBlocks.back();
+                    freeBlocks.pop_back();
+                    state.CachedBytes -= *o_Capacity;
+                    return block;
+                }
+            }
+            return malloc(*o_Capacity);
+        }
+
+        void Free(void* block, size_t capacity)
+        {
+            if(!block)
+                return;
+            if(capacity <= MAX_POOLED_SIZE)
+            {
+                PoolState& state = GetState();
+                std::lock_guard<std::mutex> lock(state.Mutex);
+                if(state.CachedBytes + capacity <= MAX_CACHED_BYTES)
+                {
+                    state.FreeBlocks[GetSizeClass(capacity)].push_back(block);
+                    state.CachedBytes += capacity;
+                    return;
+                }
+            }
+            free(block);
+        }
+
+        size_t GetCachedBytes()
+        {
+            PoolState& state = GetState();
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            return state.CachedBytes;
+        }
+    }
+}
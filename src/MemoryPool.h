@@ -0,0 +1,27 @@
+#ifndef _DCE_MEMORY_POOL_H
+#define _DCE_MEMORY_POOL_H
+
+#include "Core.h"
+
+namespace dce
+{
+    // Process wide cache of freed blocks sorted into power of two size classes,
+    // shared by every open buffer. Buffers that come and go keep reusing the
+    // same blocks instead of leaving differently sized holes all over the heap.
+    // Blocks above MAX_POOLED_SIZE go straight to malloc, which maps them.
+    namespace MemoryPool
+    {
+        // Returns a block of at least 'size' bytes, its real size is written to
+        // o_Capacity and has to be given back to Free().
+        void* Allocate(size_t size, size_t* o_Capacity);
+        void Free(void* block, size_t capacity);
+        size_t GetCachedBytes();
+
+        static constexpr int MIN_SIZE_CLASS = 6;
+        static constexpr int MAX_SIZE_CLASS = 26;
+        static constexpr size_t MAX_POOLED_SIZE = 1ul << MAX_SIZE_CLASS;
+        static constexpr size_t MAX_CACHED_BYTES = 0x10000000ul;
+    }
+}
+
+#endif // _DCE_MEMORY_POOL_H
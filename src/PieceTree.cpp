@@ -0,0 +1,259 @@
+#include <cstring>
+#include <utility>
+
+#include "MemoryPool.h"
+#include "PieceTree.h"
+
+namespace dce
+{
+    PieceTree::PieceTree()
+    {
+        m_Pieces.push_back({ nullptr, 0, 0, 0, 0, 0 });
+        m_AddBlockStart = nullptr;
+        m_AddHead = nullptr;
+        m_AddRemaining = 0;
+        m_Original = nullptr;
+        m_Root = 0;
+        m_Seed = 0x9E3779B9u;
+    }
+
+    PieceTree::~PieceTree()
+    {
+        Clear();
+    }
+
+    void PieceTree::Clear()
+    {
+        for(const AddBlock& block : m_AddBlocks)
+            MemoryPool::Free(block.Data, block.Capacity);
+        m_AddBlocks.clear();
+        if(m_Original)
+            free(m_Original);
+        m_Mapping.Close();
+
+        m_Pieces.resize(1);
+        m_FreePieces.clear();
+        m_AddBlockStart = nullptr;
+        m_AddHead = nullptr;
+        m_AddRemaining = 0;
+        m_Original = nullptr;
+        m_Root = 0;
+    }
+
+    char* PieceTree::Load(size_t size)
+    {
+        Clear();
+        if(size == 0)
+            return nullptr;
+        m_Original = (char*)malloc(size);
+        DCE_ASSURE_OR_EXIT(m_Original, "An error occurred during memory allocation.\n");
+        m_Root = NewPiece(m_Original, size);
+        return m_Original;
+    }
+
+    bool PieceTree::LoadMapped(MappedFile& file)
+    {
+        Clear();
+        m_Mapping = std::move(file);
+        if(m_Mapping.Size())
+            m_Root = NewPiece(m_Mapping.Data(), m_Mapping.Size());
+        return true;
+    }
+
+    void PieceTree::Insert(size_t position, const char* data, size_t count)
+    {
+        DCE_ASSERT(position <= Size(), "Attempted to insert out of bounds %lu! Valid range is 0 - %lu.\n",
+                   position, Size());
+        if(count == 0)
+            return;
+
+        uint32_t left, right;
+        Split(m_Root, position, &left, &right);
+        if(!ExtendLastPiece(left, data, count))
+            left = Merge(left, NewPiece(StoreAdded(data, count), count));
+        m_Root = Merge(left, right);
+    }
+
+    void PieceTree::Erase(size_t position, size_t count)
+    {
+        DCE_ASSERT(position + count <= Size(), "Attempted to erase out of bounds %lu! Valid range is 0 - %lu.\n",
+                   position + count, Size());
+        if(count == 0)
+            return;
+
+        uint32_t left, mid, right;
+        Split(m_Root, position, &left, &mid);
+        Split(mid, count, &mid, &right);
+        FreePieces(mid);
+        m_Root = Merge(left, right);
+    }
+
+    TextSpan PieceTree::SpanAt(size_t index) const
+    {
+        uint32_t node = m_Root;
+        while(node)
+        {
+            const Piece& p = m_Pieces[node];
+            size_t leftLength = m_Pieces[p.Left].SubtreeLength;
+            if(index < leftLength)
+                node = p.Left;
+            else if(index < leftLength + p.Length)
+            {
+                index -= leftLength;
+                return { p.Data + index, p.Length - index };
+            }
+            else
+            {
+                index -= leftLength + p.Length;
+                node = p.Right;
+            }
+        }
+        return { nullptr, 0 };
+    }
+
+    uint32_t PieceTree::NewPiece(const char* data, size_t length)
+    {
+        uint32_t index;
+        if(!m_FreePieces.empty())
+        {
+            index = m_FreePieces.back();
+            m_FreePieces.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)m_Pieces.size();
+            m_Pieces.emplace_back();
+        }
+
+        // xorshift32, priorities only need to be well spread, not secure.
+        m_Seed ^= m_Seed << 13;
+        m_Seed ^= m_Seed >> 17;
+        m_Seed ^= m_Seed << 5;
+        m_Pieces[index] = { data, length, length, 0, 0, m_Seed };
+        return index;
+    }
+
+    void PieceTree::FreePieces(uint32_t node)
+    {
+        if(!node)
+            return;
+        FreePieces(m_Pieces[node].Left);
+        FreePieces(m_Pieces[node].Right);
+        m_FreePieces.push_back(node);
+    }
+
+    // Splits the subtree at node so that the first 'position' characters end
+    // up in o_Left and the rest in o_Right, cutting a piece in two if needed.
+    void PieceTree::Split(uint32_t node, size_t position, uint32_t* o_Left, uint32_t* o_Right)
+    {
+        if(!node)
+        {
+            *o_Left = 0;
+            *o_Right = 0;
+            return;
+        }
+
+        size_t leftLength = m_Pieces[m_Pieces[node].Left].SubtreeLength;
+        size_t length = m_Pieces[node].Length;
+        uint32_t l, r;
+        if(position <= leftLength)
+        {
+            Split(m_Pieces[node].Left, position, &l, &r);
+            m_Pieces[node].Left = r;
+            Update(node);
+            *o_Left = l;
+            *o_Right = node;
+        }
+        else if(position >= leftLength + length)
+        {
+            Split(m_Pieces[node].Right, position - leftLength - length, &l, &r);
+            m_Pieces[node].Right = l;
+            Update(node);
+            *o_Left = node;
+            *o_Right = r;
+        }
+        else
+        {
+            size_t offset = position - leftLength;
+            uint32_t tail = NewPiece(m_Pieces[node].Data + offset, length - offset);
+            uint32_t right = m_Pieces[node].Right;
+            m_Pieces[node].Length = offset;
+            m_Pieces[node].Right = 0;
+            Update(node);
+            *o_Left = node;
+            *o_Right = Merge(tail, right);
+        }
+    }
+
+    uint32_t PieceTree::Merge(uint32_t left, uint32_t right)
+    {
+        if(!left)
+            return right;
+        if(!right)
+            return left;
+
+        if(m_Pieces[left].Priority > m_Pieces[right].Priority)
+        {
+            m_Pieces[left].Right = Merge(m_Pieces[left].Right, right);
+            Update(left);
+            return left;
+        }
+        m_Pieces[right].Left = Merge(left, m_Pieces[right].Left);
+        Update(right);
+        return right;
+    }
+
+    // Consecutive keystrokes land right after the previous insertion in the add
+    // block, so the last piece can grow in place instead of adding a new one.
+    bool PieceTree::ExtendLastPiece(uint32_t root, const char* data, size_t count)
+    {
+        if(!root || count > m_AddRemaining)
+            return false;
+
+        uint32_t last = root;
+        while(m_Pieces[last].Right)
+            last = m_Pieces[last].Right;
+        const Piece& p = m_Pieces[last];
+        if(p.Data < m_AddBlockStart || p.Data + p.Length != m_AddHead)
+            return false;
+
+        memcpy(m_AddHead, data, count);
+        m_AddHead += count;
+        m_AddRemaining -= count;
+        for(uint32_t node = root; node; node = m_Pieces[node].Right)
+            m_Pieces[node].SubtreeLength += count;
+        m_Pieces[last].Length += count;
+        return true;
+    }
+
+    const char* PieceTree::StoreAdded(const char* data, size_t count)
+    {
+        // Large insertions (pastes) get a block of their own so they don't
+        // waste the remainder of the shared add block.
+        if(count > (ADD_BLOCK_SIZE >> 2))
+        {
+            size_t capacity;
+            char* block = (char*)MemoryPool::Allocate(count, &capacity);
+            DCE_ASSURE_OR_EXIT(block, "An error occurred during memory allocation.\n");
+            m_AddBlocks.push_back({ block, capacity });
+            memcpy(block, data, count);
+            return block;
+        }
+
+        if(count > m_AddRemaining)
+        {
+            size_t capacity;
+            m_AddBlockStart = (char*)MemoryPool::Allocate(ADD_BLOCK_SIZE, &capacity);
+            DCE_ASSURE_OR_EXIT(m_AddBlockStart, "An error occurred during memory allocation.\n");
+            m_AddBlocks.push_back({ m_AddBlockStart, capacity });
+            m_AddHead = m_AddBlockStart;
+            m_AddRemaining = capacity;
+        }
+
+        char* dest = m_AddHead;
+        memcpy(dest, data, count);
+        m_AddHead += count;
+        m_AddRemaining -= count;
+        return dest;
+    }
+}
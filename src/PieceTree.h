@@ -0,0 +1,78 @@
+#ifndef _DCE_PIECE_TREE_H
+#define _DCE_PIECE_TREE_H
+
+#include <vector>
+
+#include "TextBuffer.h"
+
+namespace dce
+{
+    // Piece table whose pieces are kept in an implicit treap ordered by text
+    // position, so edits and lookups cost O(log n) in the number of pieces no
+    // matter where they happen in the file. Pieces point either into the block
+    // handed out by Load() (or the file mapping given to LoadMapped()) or into
+    // append-only add blocks, none of which ever move once written.
+    class PieceTree : public TextBuffer
+    {
+    public:
+        PieceTree();
+        PieceTree(const PieceTree&) = delete;
+        ~PieceTree() override;
+
+        void Clear() override;
+        char* Load(size_t size) override;
+        bool LoadMapped(MappedFile& file) override;
+        void Insert(size_t position, const char* data, size_t count) override;
+        void Erase(size_t position, size_t count) override;
+        char At(size_t index) const override { return *SpanAt(index).Data; }
+        TextSpan SpanAt(size_t index) const override;
+        size_t Size() const override { return m_Pieces[m_Root].SubtreeLength; }
+        TextBackend GetBackend() const override { return TextBackend::PIECE_TREE; }
+        bool HasStableSpans() const override { return true; }
+
+        inline size_t GetPieceCount() const { return m_Pieces.size() - 1 - m_FreePieces.size(); }
+    public:
+        static constexpr size_t ADD_BLOCK_SIZE = 0x10000ul;
+    private:
+        struct Piece
+        {
+            const char* Data;
+            size_t Length;
+            size_t SubtreeLength;
+            uint32_t Left, Right;
+            uint32_t Priority;
+        };
+
+        struct AddBlock
+        {
+            char* Data;
+            size_t Capacity;
+        };
+
+        uint32_t NewPiece(const char* data, size_t length);
+        void FreePieces(uint32_t node);
+        void Split(uint32_t node, size_t position, uint32_t* o_Left, uint32_t* o_Right);
+        uint32_t Merge(uint32_t left, uint32_t right);
+        bool ExtendLastPiece(uint32_t root, const char* data, size_t count);
+        const char* StoreAdded(const char* data, size_t count);
+
+        inline void Update(uint32_t node)
+        {
+            Piece& p = m_Pieces[node];
+            p.SubtreeLength = m_Pieces[p.Left].SubtreeLength + p.Length + m_Pieces[p.Right].SubtreeLength;
+        }
+    private:
+        std::vector<Piece> m_Pieces; // Index 0 is an empty sentinel used as the null child.
+        std::vector<uint32_t> m_FreePieces;
+        std::vector<AddBlock> m_AddBlocks; // Allocated from the shared MemoryPool.
+        char* m_AddBlockStart;
+        char* m_AddHead;
+        size_t m_AddRemaining;
+        char* m_Original;
+        MappedFile m_Mapping;
+        uint32_t m_Root;
+        uint32_t m_Seed;
+    };
+}
+
+#endif // _DCE_PIECE_TREE_H
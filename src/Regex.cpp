@@ -0,0 +1,690 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Regex.h"
+
+namespace dce
+{
+    static constexpr size_t UNBOUNDED = SIZE_MAX;
+
+    static inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static inline bool IsWordByte(char c)
+    {
+        return IsDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static inline int HexValue(char c)
+    {
+        if(IsDigit(c))
+            return c - '0';
+        if(c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    Regex::Regex()
+    {
+        m_Start = 0;
+        memset(m_Classes, 0, sizeof(m_Classes));
+        m_ClassCount = 1;
+        memset(m_ClassBytes, 0, sizeof(m_ClassBytes));
+        m_Pattern = nullptr;
+        m_Position = 0;
+        m_Error = nullptr;
+        m_Anchored.Unanchored = false;
+        m_Unanchored.Unanchored = true;
+        ResetDfa(m_Anchored);
+        ResetDfa(m_Unanchored);
+        m_Visit = 0;
+    }
+
+    bool Regex::Compile(const std::string& pattern, std::string* o_Error)
+    {
+        m_Program.clear();
+        m_Sets.clear();
+        m_Pattern = &pattern;
+        m_Position = 0;
+        m_Error = o_Error;
+
+        Fragment fragment;
+        bool compiled = ParseAlternation(&fragment);
+        if(compiled && m_Position < pattern.size())
+            compiled = Fail("unmatched ')'");
+        m_Pattern = nullptr;
+        m_Error = nullptr;
+        if(!compiled)
+        {
+            m_Program.clear();
+            return false;
+        }
+        Patch(fragment.Outs, Emit(Op::MATCH));
+        m_Start = fragment.Start;
+
+        BuildByteClasses();
+        ResetDfa(m_Anchored);
+        ResetDfa(m_Unanchored);
+        m_Visited.assign(m_Program.size(), 0);
+        m_Visit = 0;
+        return true;
+    }
+
+    void Regex::FindAll(const char* data, size_t size, size_t base, std::vector<RegexMatch>& o_Matches)
+    {
+        // The unanchored DFA only tells which lines have a match, those are
+        // then looked at one start at a time. The tables are read through
+        // locals, only adding a state moves them.
+        Dfa& dfa = m_Unanchored;
+        int32_t lineStartState = GetStart(dfa, true);
+        const int32_t* next = dfa.Next.data();
+        const uint8_t* flags = dfa.Flags.data();
+        size_t lineStart = 0;
+        int32_t state = lineStartState;
+        for(size_t i = 0; i < size; ++i)
+        {
+            uint8_t c = (uint8_t)data[i];
+            if(c == '\n')
+            {
+                if(flags[state] & MATCHES_AT_END)
+                    FindInLine(data + lineStart, i - lineStart, base + lineStart, o_Matches);
+                lineStart = i + 1;
+                state = lineStartState;
+                continue;
+            }
+            int32_t following = next[(size_t)state + m_Classes[c]];
+            if(following < 0)
+            {
+                following = AddTransition(dfa, state, c);
+                // Dropping the cache drops the start state with the rest.
+                if(dfa.Starts[1] < 0)
+                    lineStartState = GetStart(dfa, true);
+                next = dfa.Next.data();
+                flags = dfa.Flags.data();
+            }
+            state = following;
+            if(flags[state] & MATCHES)
+            {
+                const char* newline = (const char*)memchr(data + i + 1, '\n', size - i - 1);
+                size_t lineEnd = newline ? (size_t)(newline - data) : size;
+                FindInLine(data + lineStart, lineEnd - lineStart, base + lineStart, o_Matches);
+                i = lineEnd;
+                lineStart = lineEnd + 1;
+                state = GetStart(dfa, true);
+                next = dfa.Next.data();
+                flags = dfa.Flags.data();
+            }
+        }
+        if(lineStart < size && (flags[state] & MATCHES_AT_END))
+            FindInLine(data + lineStart, size - lineStart, base + lineStart, o_Matches);
+    }
+
+    bool Regex::ParseAlternation(Fragment* o_Fragment)
+    {
+        const std::string& pattern = *m_Pattern;
+        Fragment left;
+        if(!ParseConcatenation(&left))
+            return false;
+        while(m_Position < pattern.size() && pattern[m_Position] == '|')
+        {
+            ++m_Position;
+            Fragment right;
+            if(!ParseConcatenation(&right))
+                return false;
+            uint32_t split = Emit(Op::SPLIT);
+            m_Program[split].X = left.Start;
+            m_Program[split].Y = right.Start;
+            left.Start = split;
+            left.Outs.insert(left.Outs.end(), right.Outs.begin(), right.Outs.end());
+        }
+        *o_Fragment = std::move(left);
+        return true;
+    }
+
+    bool Regex::ParseConcatenation(Fragment* o_Fragment)
+    {
+        const std::string& pattern = *m_Pattern;
+        Fragment result;
+        bool empty = true;
+        while(m_Position < pattern.size() && pattern[m_Position] != '|' && pattern[m_Position] != ')')
+        {
+            Fragment next;
+            if(!ParseRepetition(&next))
+                return false;
+            result = empty ? std::move(next) : Concatenate(std::move(result), std::move(next));
+            empty = false;
+        }
+        *o_Fragment = empty ? Empty() : std::move(result);
+        return true;
+    }
+
+    bool Regex::ParseRepetition(Fragment* o_Fragment)
+    {
+        const std::string& pattern = *m_Pattern;
+        size_t atomStart = m_Position;
+        Fragment atom;
+        if(!ParseAtom(&atom))
+            return false;
+        size_t atomEnd = m_Position;
+        if(m_Position >= pattern.size())
+        {
+            *o_Fragment = std::move(atom);
+            return true;
+        }
+
+        size_t min, max;
+        char c = pattern[m_Position];
+        if(c == '*')
+            min = 0, max = UNBOUNDED;
+        else if(c == '+')
+            min = 1, max = UNBOUNDED;
+        else if(c == '?')
+            min = 0, max = 1;
+        else if(c == '{' && m_Position + 1 < pattern.size() && IsDigit(pattern[m_Position + 1]))
+        {
+            size_t position = m_Position + 1;
+            auto parseCount = [&]()
+            {
+                size_t count = 0;
+                for(; position < pattern.size() && IsDigit(pattern[position]); ++position)
+                    count = std::min(count * 10 + (size_t)(pattern[position] - '0'), MAX_REPEAT + 1);
+                return count;
+            };
+            min = max = parseCount();
+            if(position < pattern.size() && pattern[position] == ',')
+            {
+                ++position;
+                max = position < pattern.size() && IsDigit(pattern[position]) ? parseCount() : UNBOUNDED;
+            }
+            // Anything else is a literal brace.
+            if(position >= pattern.size() || pattern[position] != '}')
+            {
+                *o_Fragment = std::move(atom);
+                return true;
+            }
+            if(min > MAX_REPEAT || (max != UNBOUNDED && max > MAX_REPEAT))
+                return Fail("repetition count too large");
+            if(max < min)
+                return Fail("bad repetition range");
+            m_Position = position;
+        }
+        else
+        {
+            *o_Fragment = std::move(atom);
+            return true;
+        }
+        ++m_Position;
+        // Whether it's lazy makes no difference to the longest match.
+        if(m_Position < pattern.size() && pattern[m_Position] == '?')
+            ++m_Position;
+        if(m_Position < pattern.size() && (pattern[m_Position] == '*' || pattern[m_Position] == '+'
+                                           || pattern[m_Position] == '?'))
+            return Fail("nested quantifier");
+        size_t repetitionEnd = m_Position;
+
+        // Every copy of the atom past the first is parsed again.
+        auto copyAtom = [&](Fragment* o_Copy)
+        {
+            m_Position = atomStart;
+            bool parsed = ParseAtom(o_Copy);
+            m_Position = atomEnd;
+            return parsed;
+        };
+        Fragment result;
+        bool empty = true;
+        size_t copies = max == UNBOUNDED ? std::max(min, (size_t)1) : max;
+        for(size_t i = 0; i < copies; ++i)
+        {
+            Fragment copy;
+            if(i == 0)
+                copy = std::move(atom);
+            else if(!copyAtom(&copy))
+                return false;
+            if(m_Program.size() > MAX_PROGRAM_SIZE)
+                return Fail("pattern too large");
+
+            if(max == UNBOUNDED && i == copies - 1)
+            {
+                // The last copy loops back on itself, skipped over if none are needed.
+                uint32_t split = Emit(Op::SPLIT);
+                Patch(copy.Outs, split);
+                m_Program[split].X = copy.Start;
+                copy.Outs = { split * 2 + 1 };
+                if(min == 0)
+                    copy.Start = split;
+            }
+            else if(i >= min)
+            {
+                uint32_t split = Emit(Op::SPLIT);
+                m_Program[split].X = copy.Start;
+                copy.Start = split;
+                copy.Outs.push_back(split * 2 + 1);
+            }
+            result = empty ? std::move(copy) : Concatenate(std::move(result), std::move(copy));
+            empty = false;
+        }
+        m_Position = repetitionEnd;
+        *o_Fragment = empty ? Empty() : std::move(result);
+        return true;
+    }
+
+    bool Regex::ParseAtom(Fragment* o_Fragment)
+    {
+        const std::string& pattern = *m_Pattern;
+        char c = pattern[m_Position];
+        std::bitset<256> set;
+        switch(c)
+        {
+        case '(':
+            ++m_Position;
+            if(pattern.compare(m_Position, 2, "?:") == 0)
+                m_Position += 2;
+            if(!ParseAlternation(o_Fragment))
+                return false;
+            if(m_Position >= pattern.size() || pattern[m_Position] != ')')
+                return Fail("missing ')'");
+            ++m_Position;
+            return true;
+        case '*':
+        case '+':
+        case '?':
+            return Fail("nothing to repeat");
+        case '^':
+        case '$':
+        {
+            ++m_Position;
+            uint32_t anchor = Emit(c == '^' ? Op::LINE_START : Op::LINE_END);
+            *o_Fragment = { anchor, { anchor * 2 } };
+            return true;
+        }
+        case '[':
+            ++m_Position;
+            if(!ParseClass(set))
+                return false;
+            break;
+        case '.':
+            ++m_Position;
+            set.set();
+            set.reset('\n');
+            break;
+        case '\\':
+            ++m_Position;
+            if(!ParseEscape(set))
+                return false;
+            break;
+        default:
+            ++m_Position;
+            set.set((uint8_t)c);
+            break;
+        }
+
+        if(m_Sets.size() > UINT16_MAX)
+            return Fail("pattern too large");
+        m_Sets.push_back(set);
+        uint32_t bytes = Emit(Op::BYTES, (uint16_t)(m_Sets.size() - 1));
+        *o_Fragment = { bytes, { bytes * 2 } };
+        return true;
+    }
+
+    bool Regex::ParseClass(std::bitset<256>& o_Set)
+    {
+        const std::string& pattern = *m_Pattern;
+        bool negated = m_Position < pattern.size() && pattern[m_Position] == '^';
+        if(negated)
+            ++m_Position;
+        bool first = true;
+        while(true)
+        {
+            if(m_Position >= pattern.size())
+                return Fail("missing ']'");
+            char c = pattern[m_Position];
+            if(c == ']' && !first)
+                break;
+            first = false;
+            ++m_Position;
+            if(c == '\\')
+            {
+                std::bitset<256> escaped;
+                if(!ParseEscape(escaped))
+                    return false;
+                o_Set |= escaped;
+                continue;
+            }
+            if(m_Position + 1 < pattern.size() && pattern[m_Position] == '-' && pattern[m_Position + 1] != ']')
+            {
+                char last = pattern[m_Position + 1];
+                if((uint8_t)last < (uint8_t)c)
+                    return Fail("bad class range");
+                for(unsigned b = (uint8_t)c; b <= (uint8_t)last; ++b)
+                    o_Set.set(b);
+                m_Position += 2;
+            }
+            else
+                o_Set.set((uint8_t)c);
+        }
+        ++m_Position;
+        if(negated)
+        {
+            o_Set.flip();
+            o_Set.reset('\n');
+        }
+        return true;
+    }
+
+    bool Regex::ParseEscape(std::bitset<256>& o_Set)
+    {
+        const std::string& pattern = *m_Pattern;
+        if(m_Position >= pattern.size())
+            return Fail("trailing '\\'");
+        char c = pattern[m_Position++];
+        switch(c)
+        {
+        case 'd':
+        case 'D':
+            for(char b = '0'; b <= '9'; ++b)
+                o_Set.set((uint8_t)b);
+            break;
+        case 'w':
+        case 'W':
+            for(unsigned b = 0; b < 256; ++b)
+                o_Set[b] = IsWordByte((char)b);
+            break;
+        case 's':
+        case 'S':
+            for(char b : { ' ', '\t', '\n', '\r', '\f', '\v' })
+                o_Set.set((uint8_t)b);
+            break;
+        case 't':
+            o_Set.set('\t');
+            return true;
+        case 'n':
+            o_Set.set('\n');
+            return true;
+        case 'r':
+            o_Set.set('\r');
+            return true;
+        case 'f':
+            o_Set.set('\f');
+            return true;
+        case 'v':
+            o_Set.set('\v');
+            return true;
+        case 'x':
+        {
+            int high = m_Position < pattern.size() ? HexValue(pattern[m_Position]) : -1;
+            int low = m_Position + 1 < pattern.size() ? HexValue(pattern[m_Position + 1]) : -1;
+            if(high < 0 || low < 0)
+                return Fail("bad \\x escape");
+            m_Position += 2;
+            o_Set.set((size_t)(high * 16 + low));
+            return true;
+        }
+        default:
+            if(IsWordByte(c))
+                return Fail("unknown escape");
+            o_Set.set((uint8_t)c);
+            return true;
+        }
+        // The upper case ones are negated.
+        if(c >= 'A' && c <= 'Z')
+        {
+            o_Set.flip();
+            o_Set.reset('\n');
+        }
+        return true;
+    }
+
+    bool Regex::Fail(const char* error)
+    {
+        if(m_Error)
+            *m_Error = std::string(error) + " at " + std::to_string(m_Position);
+        return false;
+    }
+
+    uint32_t Regex::Emit(Op code, uint16_t set)
+    {
+        m_Program.push_back({ code, set, 0, 0 });
+        return (uint32_t)(m_Program.size() - 1);
+    }
+
+    void Regex::Patch(const std::vector<uint32_t>& outs, uint32_t target)
+    {
+        for(uint32_t out : outs)
+        {
+            Inst& inst = m_Program[out / 2];
+            (out & 1 ? inst.Y : inst.X) = target;
+        }
+    }
+
+    Regex::Fragment Regex::Concatenate(Fragment first, Fragment second)
+    {
+        Patch(first.Outs, second.Start);
+        return { first.Start, std::move(second.Outs) };
+    }
+
+    Regex::Fragment Regex::Empty()
+    {
+        uint32_t jump = Emit(Op::JUMP);
+        return { jump, { jump * 2 } };
+    }
+
+    // Bytes that no set tells apart share a class, and with it a column in
+    // the transition table. Newlines always get one of their own.
+    void Regex::BuildByteClasses()
+    {
+        uint16_t classes[256] = {};
+        size_t classCount = 1;
+        auto refine = [&](const std::bitset<256>& set)
+        {
+            uint16_t split[256][2];
+            memset(split, 0xFF, sizeof(split));
+            size_t count = 0;
+            for(unsigned b = 0; b < 256; ++b)
+            {
+                uint16_t& id = split[classes[b]][set[b]];
+                if(id == UINT16_MAX)
+                    id = (uint16_t)count++;
+                classes[b] = id;
+            }
+            classCount = count;
+        };
+        std::bitset<256> newline;
+        newline.set('\n');
+        refine(newline);
+        for(const std::bitset<256>& set : m_Sets)
+        {
+            if(classCount == 256)
+                break;
+            refine(set);
+        }
+
+        m_ClassCount = classCount;
+        for(int b = 255; b >= 0; --b)
+        {
+            m_Classes[b] = (uint8_t)classes[b];
+            m_ClassBytes[classes[b]] = (uint8_t)b;
+        }
+    }
+
+    void Regex::ResetDfa(Dfa& dfa)
+    {
+        dfa.Ids.clear();
+        dfa.Sets.clear();
+        dfa.Flags.clear();
+        dfa.Next.clear();
+        dfa.Starts[0] = dfa.Starts[1] = -1;
+    }
+
+    int32_t Regex::GetStart(Dfa& dfa, bool lineStart)
+    {
+        if(dfa.Starts[lineStart] < 0)
+        {
+            ++m_Visit;
+            m_Scratch.clear();
+            AddClosure(m_Start, lineStart, false, m_Scratch);
+            std::sort(m_Scratch.begin(), m_Scratch.end());
+            int32_t start = AddState(dfa, m_Scratch);
+            dfa.Starts[lineStart] = start;
+        }
+        return dfa.Starts[lineStart];
+    }
+
+    int32_t Regex::AddTransition(Dfa& dfa, int32_t state, uint8_t c)
+    {
+        // Any byte of the class goes the same way.
+        uint8_t byte = m_ClassBytes[m_Classes[c]];
+        ++m_Visit;
+        m_Scratch.clear();
+        for(uint32_t pc : dfa.Sets[(size_t)state / m_ClassCount])
+        {
+            const Inst& inst = m_Program[pc];
+            if(inst.Code == Op::BYTES && m_Sets[inst.Set][byte])
+                AddClosure(inst.X, false, false, m_Scratch);
+        }
+        if(dfa.Unanchored)
+            AddClosure(m_Start, false, false, m_Scratch);
+        std::sort(m_Scratch.begin(), m_Scratch.end());
+
+        size_t stateCount = dfa.Sets.size();
+        int32_t next = AddState(dfa, m_Scratch);
+        // The cache was dropped, state is gone with it.
+        if(dfa.Sets.size() >= stateCount)
+            dfa.Next[(size_t)state + m_Classes[c]] = next;
+        return next;
+    }
+
+    int32_t Regex::AddState(Dfa& dfa, std::vector<uint32_t>& set)
+    {
+        auto it = dfa.Ids.find(set);
+        if(it != dfa.Ids.end())
+            return it->second;
+        if(dfa.Sets.size() >= MAX_DFA_STATES)
+            ResetDfa(dfa);
+
+        uint8_t flags = set.empty() ? DEAD : 0;
+        std::vector<uint32_t> atEnd;
+        ++m_Visit;
+        for(uint32_t pc : set)
+        {
+            if(m_Program[pc].Code == Op::MATCH)
+                flags |= MATCHES | MATCHES_AT_END;
+            else if(m_Program[pc].Code == Op::LINE_END)
+                AddClosure(m_Program[pc].X, false, true, atEnd);
+        }
+        for(uint32_t pc : atEnd)
+        {
+            if(m_Program[pc].Code == Op::MATCH)
+                flags |= MATCHES_AT_END;
+        }
+
+        int32_t row = (int32_t)dfa.Next.size();
+        dfa.Ids.emplace(set, row);
+        dfa.Sets.push_back(set);
+        dfa.Flags.resize(dfa.Flags.size() + m_ClassCount, 0);
+        dfa.Flags[row] = flags;
+        dfa.Next.resize(dfa.Next.size() + m_ClassCount, -1);
+        return row;
+    }
+
+    void Regex::AddClosure(uint32_t pc, bool lineStart, bool lineEnd, std::vector<uint32_t>& o_Set)
+    {
+        m_Stack.push_back(pc);
+        while(!m_Stack.empty())
+        {
+            uint32_t current = m_Stack.back();
+            m_Stack.pop_back();
+            if(m_Visited[current] == m_Visit)
+                continue;
+            m_Visited[current] = m_Visit;
+            const Inst& inst = m_Program[current];
+            switch(inst.Code)
+            {
+            case Op::BYTES:
+            case Op::MATCH:
+                o_Set.push_back(current);
+                break;
+            case Op::SPLIT:
+                m_Stack.push_back(inst.Y);
+                m_Stack.push_back(inst.X);
+                break;
+            case Op::JUMP:
+                m_Stack.push_back(inst.X);
+                break;
+            case Op::LINE_START:
+                if(lineStart)
+                    m_Stack.push_back(inst.X);
+                break;
+            case Op::LINE_END:
+                // Kept, whether the line ends here is only known later.
+                if(lineEnd)
+                    m_Stack.push_back(inst.X);
+                else
+                    o_Set.push_back(current);
+                break;
+            }
+        }
+    }
+
+    void Regex::FindInLine(const char* line, size_t size, size_t base, std::vector<RegexMatch>& o_Matches)
+    {
+        size_t position = 0;
+        while(position < size)
+        {
+            // Where the first match from here on ends, the leftmost one
+            // starts no later than that.
+            int32_t state = GetStart(m_Unanchored, position == 0);
+            size_t end = (m_Unanchored.Flags[state] & MATCHES) ? position : UNBOUNDED;
+            size_t i = position;
+            for(; end == UNBOUNDED && i < size; ++i)
+            {
+                state = Step(m_Unanchored, state, (uint8_t)line[i]);
+                if(m_Unanchored.Flags[state] & MATCHES)
+                    end = i + 1;
+            }
+            if(end == UNBOUNDED)
+            {
+                if(!(m_Unanchored.Flags[state] & MATCHES_AT_END))
+                    break;
+                end = size;
+            }
+
+            bool found = false;
+            for(size_t start = position; start <= end && start < size; ++start)
+            {
+                int64_t length = MatchAt(line, size, start);
+                if(length > 0)
+                {
+                    o_Matches.push_back({ base + start, base + start + (size_t)length });
+                    position = start + (size_t)length;
+                    found = true;
+                    break;
+                }
+            }
+            // Only empty matches up to there.
+            if(!found)
+                position = end + 1;
+        }
+    }
+
+    int64_t Regex::MatchAt(const char* line, size_t size, size_t start)
+    {
+        int32_t state = GetStart(m_Anchored, start == 0);
+        int64_t longest = (m_Anchored.Flags[state] & MATCHES) ? 0 : -1;
+        for(size_t i = start; i < size; ++i)
+        {
+            state = Step(m_Anchored, state, (uint8_t)line[i]);
+            uint8_t flags = m_Anchored.Flags[state];
+            if(flags & DEAD)
+                return longest;
+            if(flags & MATCHES)
+                longest = (int64_t)(i + 1 - start);
+        }
+        if(m_Anchored.Flags[state] & MATCHES_AT_END)
+            longest = (int64_t)(size - start);
+        return longest;
+    }
+}
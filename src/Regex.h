@@ -0,0 +1,137 @@
+#ifndef _DCE_REGEX_H
+#define _DCE_REGEX_H
+
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Core.h"
+
+namespace dce
+{
+    struct RegexMatch
+    {
+        size_t Start;
+        size_t End;
+    };
+
+    // Regular expressions over bytes, compiled to an NFA that is turned into
+    // a DFA lazily, one state at a time as the text needs them. Matches never
+    // span lines, they're the leftmost-longest non-empty ones of each line.
+    // Supports literals, '.', classes with ranges, \d \w \s and their
+    // negations, ^ and $ at line ends, groups, '|', '*', '+', '?' and {m,n}.
+    // The DFA is cached in the object, so every thread needs a copy of its own.
+    class Regex
+    {
+    public:
+        Regex();
+
+        // Prints nothing, o_Error tells what's wrong with the pattern.
+        bool Compile(const std::string& pattern, std::string* o_Error);
+        inline bool IsCompiled() const { return !m_Program.empty(); }
+        // Appends the matches in data, which has to start at the beginning
+        // of a line and end at the end of one, offset by base.
+        void FindAll(const char* data, size_t size, size_t base, std::vector<RegexMatch>& o_Matches);
+    public:
+        static constexpr size_t MAX_PROGRAM_SIZE = 0x4000ul;
+        static constexpr size_t MAX_REPEAT = 1000;
+        // The cache is dropped and built again once it gets this large.
+        static constexpr size_t MAX_DFA_STATES = 0x1000ul;
+    private:
+        enum class Op : uint8_t
+        {
+            BYTES,
+            SPLIT,
+            JUMP,
+            LINE_START,
+            LINE_END,
+            MATCH
+        };
+
+        struct Inst
+        {
+            Op Code;
+            uint16_t Set;
+            uint32_t X, Y;
+        };
+
+        // An unfinished piece of the program, Outs are the jumps out of it
+        // still to be pointed somewhere, as twice the instruction plus one
+        // for its Y.
+        struct Fragment
+        {
+            uint32_t Start;
+            std::vector<uint32_t> Outs;
+        };
+
+        enum StateFlags : uint8_t
+        {
+            MATCHES = 1,        // A match ends right here.
+            MATCHES_AT_END = 2, // It does if the line ends here.
+            DEAD = 4            // No match can end anywhere past here.
+        };
+
+        struct Dfa
+        {
+            bool Unanchored;
+            std::map<std::vector<uint32_t>, int32_t> Ids;
+            std::vector<std::vector<uint32_t>> Sets;
+            // States are the offsets of their rows in Next, which has one
+            // column per byte class, -1 until the transition is known.
+            // Flags are kept at the same offsets.
+            std::vector<uint8_t> Flags;
+            std::vector<int32_t> Next;
+            int32_t Starts[2];  // Mid line and at the start of one.
+        };
+
+        bool ParseAlternation(Fragment* o_Fragment);
+        bool ParseConcatenation(Fragment* o_Fragment);
+        bool ParseRepetition(Fragment* o_Fragment);
+        bool ParseAtom(Fragment* o_Fragment);
+        bool ParseClass(std::bitset<256>& o_Set);
+        bool ParseEscape(std::bitset<256>& o_Set);
+        bool Fail(const char* error);
+        uint32_t Emit(Op code, uint16_t set = 0);
+        void Patch(const std::vector<uint32_t>& outs, uint32_t target);
+        Fragment Concatenate(Fragment first, Fragment second);
+        Fragment Empty();
+        void BuildByteClasses();
+
+        void ResetDfa(Dfa& dfa);
+        int32_t GetStart(Dfa& dfa, bool lineStart);
+        inline int32_t Step(Dfa& dfa, int32_t state, uint8_t c)
+        {
+            int32_t next = dfa.Next[(size_t)state + m_Classes[c]];
+            return next >= 0 ? next : AddTransition(dfa, state, c);
+        }
+        int32_t AddTransition(Dfa& dfa, int32_t state, uint8_t c);
+        int32_t AddState(Dfa& dfa, std::vector<uint32_t>& set);
+        void AddClosure(uint32_t pc, bool lineStart, bool lineEnd, std::vector<uint32_t>& o_Set);
+        // Matches in a single line, without its newline.
+        void FindInLine(const char* line, size_t size, size_t base, std::vector<RegexMatch>& o_Matches);
+        // Length of the longest match starting at start, or -1 if none does.
+        int64_t MatchAt(const char* line, size_t size, size_t start);
+    private:
+        std::vector<Inst> m_Program;
+        std::vector<std::bitset<256>> m_Sets;
+        uint32_t m_Start;
+        uint8_t m_Classes[256];
+        size_t m_ClassCount;
+        uint8_t m_ClassBytes[256];  // One byte of every class.
+
+        // While compiling.
+        const std::string* m_Pattern;
+        size_t m_Position;
+        std::string* m_Error;
+
+        Dfa m_Anchored;
+        Dfa m_Unanchored;
+        std::vector<uint32_t> m_Visited;
+        uint32_t m_Visit;
+        std::vector<uint32_t> m_Stack;
+        std::vector<uint32_t> m_Scratch;
+    };
+}
+
+#endif // _DCE_REGEX_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include <glad/glad.h>
@@ -7,12 +8,18 @@
 #include "Renderer.h"
 #include "FileManager.h"
 #include "Font.h"
+#include "FrameStats.h"
+#include "GlyphLayout.h"
+#include "StreamBuffer.h"
+#include "Utf8.h"
 #include "Window.h"
 
 
 #define MAX_QUAD_COUNT 1000ull
 #define MAX_VERTEX_COUNT (MAX_QUAD_COUNT * 4ull)
 #define MAX_INDEX_COUNT (MAX_QUAD_COUNT * 6ull)
+#define VERTEX_STREAM_REGION_SIZE 0x80000ull
+#define GLYPH_STREAM_REGION_SIZE 0x400000ull
 
 namespace dce
 {
@@ -25,6 +32,39 @@ namespace dce
             float TexCoordX, TexCoordY;
         };
 
+        // Laid out as GlyphQuad in glyph.vert.
+        struct GlyphQuad
+        {
+            float TexRect[4];
+            float Rect[4];
+        };
+
+        static constexpr uint32_t PackColor(float r, float g, float b, float a)
+        {
+            return (uint32_t)(r * 255.0f + 0.5f) | (uint32_t)(g * 255.0f + 0.5f) << 8 |
+                   (uint32_t)(b * 255.0f + 0.5f) << 16 | (uint32_t)(a * 255.0f + 0.5f) << 24;
+        }
+
+        static constexpr uint32_t TEXT_COLOR = PackColor(1.0f, 1.0f, 1.0f, 1.0f);
+        static constexpr uint32_t GUTTER_TEXT_COLOR = PackColor(0.863f, 0.91f, 0.655f, 1.0f);
+        // Indexed by HighlightKind.
+        static constexpr uint32_t HIGHLIGHT_COLORS[(size_t)HighlightKind::COUNT] =
+        {
+            TEXT_COLOR,
+            PackColor(0.776f, 0.471f, 0.867f, 1.0f), // KEYWORD
+            PackColor(0.776f, 0.776f, 0.776f, 1.0f), // OPERATOR
+            PackColor(0.6f, 0.6f, 0.6f, 1.0f),       // DELIMITER
+            PackColor(0.596f, 0.765f, 0.475f, 1.0f), // STRING
+            PackColor(0.82f, 0.604f, 0.4f, 1.0f),    // NUMBER
+            PackColor(0.898f, 0.753f, 0.482f, 1.0f), // CONSTANT
+            PackColor(0.337f, 0.714f, 0.761f, 1.0f), // TYPE
+            PackColor(0.38f, 0.686f, 0.937f, 1.0f),  // FUNCTION
+            PackColor(0.878f, 0.424f, 0.459f, 1.0f), // PROPERTY
+            PackColor(0.878f, 0.424f, 0.459f, 1.0f), // LABEL
+            PackColor(0.443f, 0.494f, 0.561f, 1.0f), // COMMENT
+            PackColor(1.0f, 0.835f, 0.0f, 1.0f)      // MATCH
+        };
+
         // FORWARD DECLARATIONS;
         namespace 
         {
@@ -36,17 +76,36 @@ namespace dce
 
         static GLuint s_TextVertexArrayID = 0;
 
-        static GLuint s_VertexBufferID = 0;
         static GLuint s_IndexBufferID = 0;
-        static TextVertex s_VertexData[MAX_VERTEX_COUNT];
-        static TextVertex* s_VertexInsert = NULL;
-        static uint32_t s_QuadCount = 0;
+        // Solid quads and glyphs are written straight into these, every
+        // DrawBatched() draws what was added since the last one.
+        static StreamBuffer s_VertexStream;
+        static StreamBuffer s_GlyphStream;
+
+        static GLuint s_GlyphVertexArrayID = 0;
+        static GLuint s_GlyphMetricsBufferID = 0;
+
+        static LineLayoutCache s_LayoutCache;
+        static LineLayout s_UncachedLayout;
+        static LineLayout s_CursorLayout;
+        static std::vector<char> s_LineData;
+        static std::vector<char> s_PrefetchData;
+        static std::vector<HighlightKind> s_MatchHighlights;
 
         static GLuint s_TextShaderID = 0;
+        static GLuint s_SdfTextShaderID = 0;
         static GLuint s_BasicShaderID = 0;
 
         static size_t s_LinesDrawn = 0;
 
+        // Without a context every draw goes to a null sink: layout still runs
+        // in full and quads are counted, but nothing reaches OpenGL.
+        static bool s_Headless = false;
+        static float s_ViewportWidth = 0.0f, s_ViewportHeight = 0.0f;
+        static float s_FramebufferWidth = 0.0f, s_FramebufferHeight = 0.0f;
+        static float s_Zoom = 1.0f;
+        static size_t s_QuadsDrawn = 0;
+
         struct
         {
             float ScaleX, ScaleY;
@@ -75,11 +134,11 @@ namespace dce
             printf("OpenGL Vendor %s\n", glGetString(GL_VENDOR));
             printf("OpenGL Renderer %s\n", glGetString(GL_RENDERER));
 
-            s_VertexInsert = s_VertexData;
+            if(!s_VertexStream.Init(VERTEX_STREAM_REGION_SIZE, false) ||
+                    !s_GlyphStream.Init(GLYPH_STREAM_REGION_SIZE, false))
+                return false;
 
             glCreateVertexArrays(1, &s_TextVertexArrayID);
-            glCreateBuffers(1, &s_VertexBufferID);
-            glNamedBufferData(s_VertexBufferID, sizeof(s_VertexData), nullptr, GL_DYNAMIC_DRAW);
             glCreateBuffers(1, &s_IndexBufferID);
             {
                 uint32_t indices[MAX_INDEX_COUNT];
@@ -99,7 +158,7 @@ namespace dce
             }
 
             glBindVertexArray(s_TextVertexArrayID);
-            glBindBuffer(GL_ARRAY_BUFFER, s_VertexBufferID);
+            glBindBuffer(GL_ARRAY_BUFFER, s_VertexStream.GetRendererID());
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_IndexBufferID);
             glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (const void*)0);
             glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (const void*)8);
@@ -108,39 +167,68 @@ namespace dce
             glEnableVertexArrayAttrib(s_TextVertexArrayID, 1);
             glEnableVertexArrayAttrib(s_TextVertexArrayID, 2);
 
+            glCreateVertexArrays(1, &s_GlyphVertexArrayID);
+            glVertexArrayBindingDivisor(s_GlyphVertexArrayID, 0, 1);
+            glVertexArrayAttribFormat(s_GlyphVertexArrayID, 0, 2, GL_FLOAT, GL_FALSE, offsetof(GlyphInstance, X));
+            glVertexArrayAttribIFormat(s_GlyphVertexArrayID, 1, 1, GL_UNSIGNED_INT, offsetof(GlyphInstance, Glyph));
+            glVertexArrayAttribFormat(s_GlyphVertexArrayID, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(GlyphInstance, Color));
+            for(GLuint attrib = 0; attrib < 3; ++attrib)
+            {
+                glVertexArrayAttribBinding(s_GlyphVertexArrayID, attrib, 0);
+                glEnableVertexArrayAttrib(s_GlyphVertexArrayID, attrib);
+            }
+            glVertexArrayVertexBuffer(s_GlyphVertexArrayID, 0, s_GlyphStream.GetRendererID(), 0, sizeof(GlyphInstance));
+            glCreateBuffers(1, &s_GlyphMetricsBufferID);
+            glNamedBufferStorage(s_GlyphMetricsBufferID, Font::MAX_GLYPHS * sizeof(GlyphQuad), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, s_GlyphMetricsBufferID);
+
 
             {
                 char* vert_src = ExtractShaderFromFile("assets/shaders/base.vert");
+                char* glyph_vert_src = ExtractShaderFromFile("assets/shaders/glyph.vert");
                 char* text_frag_src = ExtractShaderFromFile("assets/shaders/text_basic.frag");
+                char* sdf_text_frag_src = ExtractShaderFromFile("assets/shaders/text_sdf.frag");
                 char* solid_frag_src = ExtractShaderFromFile("assets/shaders/solid_basic.frag");
 
                 s_TextShaderID = glCreateProgram();
+                s_SdfTextShaderID = glCreateProgram();
                 s_BasicShaderID = glCreateProgram();
                 GLuint vert_shader_id = glCreateShader(GL_VERTEX_SHADER);
+                GLuint glyph_vert_shader_id = glCreateShader(GL_VERTEX_SHADER);
                 GLuint text_frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+                GLuint sdf_text_frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
                 GLuint solid_frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
 
                 if(!CompileShader(vert_shader_id, vert_src, GL_VERTEX_SHADER) ||
+                        !CompileShader(glyph_vert_shader_id, glyph_vert_src, GL_VERTEX_SHADER) ||
                         !CompileShader(text_frag_shader_id, text_frag_src, GL_FRAGMENT_SHADER) ||
+                        !CompileShader(sdf_text_frag_shader_id, sdf_text_frag_src, GL_FRAGMENT_SHADER) ||
                         !CompileShader(solid_frag_shader_id, solid_frag_src, GL_FRAGMENT_SHADER))
                 {
                     glDeleteProgram(s_TextShaderID);
+                    glDeleteProgram(s_SdfTextShaderID);
                     glDeleteProgram(s_BasicShaderID);
                     return false;
                 }
-                glAttachShader(s_TextShaderID, vert_shader_id);
+                glAttachShader(s_TextShaderID, glyph_vert_shader_id);
                 glAttachShader(s_TextShaderID, text_frag_shader_id);
+                glAttachShader(s_SdfTextShaderID, glyph_vert_shader_id);
+                glAttachShader(s_SdfTextShaderID, sdf_text_frag_shader_id);
                 glAttachShader(s_BasicShaderID, vert_shader_id);
                 glAttachShader(s_BasicShaderID, solid_frag_shader_id);
 
-                bool linkStatus = LinkShader(s_TextShaderID) && LinkShader(s_BasicShaderID);
+                bool linkStatus = LinkShader(s_TextShaderID) && LinkShader(s_SdfTextShaderID) && LinkShader(s_BasicShaderID);
 
                 glDeleteShader(vert_shader_id);
+                glDeleteShader(glyph_vert_shader_id);
                 glDeleteShader(text_frag_shader_id);
+                glDeleteShader(sdf_text_frag_shader_id);
                 glDeleteShader(solid_frag_shader_id);
 
                 free(vert_src);
+                free(glyph_vert_src);
                 free(text_frag_src);
+                free(sdf_text_frag_src);
                 free(solid_frag_src);
 
                 if(!linkStatus)
@@ -155,36 +243,117 @@ namespace dce
             return true;
         }
 
+        void InitHeadless()
+        {
+            s_Headless = true;
+            s_VertexStream.Init(VERTEX_STREAM_REGION_SIZE, true);
+            s_GlyphStream.Init(GLYPH_STREAM_REGION_SIZE, true);
+            printf("Renderer running headless, nothing will be drawn.\n");
+        }
+
+        // Draws everything queued so far, solid quads first and glyphs on top.
         void DrawBatched()
         {
-            glNamedBufferSubData(s_VertexBufferID, 0, (long)s_VertexInsert - (long)s_VertexData, s_VertexData);
+            if(uint32_t bytes = (uint32_t)s_VertexStream.GetBatchSize())
+            {
+                uint32_t count = bytes / (4 * sizeof(TextVertex));
+                if(!s_Headless)
+                {
+                    ScopedStageTimer timer(FrameStage::DRAW);
+                    glUseProgram(s_BasicShaderID);
+                    glBindVertexArray(s_TextVertexArrayID);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, count * 6, GL_UNSIGNED_INT, NULL,
+                            (GLint)(s_VertexStream.GetBatchOffset() / sizeof(TextVertex)));
+                }
+                s_VertexStream.EndBatch();
+                FrameStats::AddDrawCall(count, bytes);
+                s_QuadsDrawn += count;
+            }
+            if(uint32_t bytes = (uint32_t)s_GlyphStream.GetBatchSize())
+            {
+                uint32_t count = bytes / sizeof(GlyphInstance);
+                Editor::GetRegularFont()->FlushUploads();
+                if(!s_Headless)
+                {
+                    ScopedStageTimer timer(FrameStage::DRAW);
+                    const bool sdf = Editor::GetRegularFont()->GetRenderMode() == FontRenderMode::SDF;
+                    glUseProgram(sdf ? s_SdfTextShaderID : s_TextShaderID);
+                    glBindVertexArray(s_GlyphVertexArrayID);
+                    glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, count,
+                            (GLuint)(s_GlyphStream.GetBatchOffset() / sizeof(GlyphInstance)));
+                }
+                s_GlyphStream.EndBatch();
+                FrameStats::AddDrawCall(count, bytes);
+                s_QuadsDrawn += count;
+            }
+        }
 
-            glDrawElements(GL_TRIANGLES, s_QuadCount * 6, GL_UNSIGNED_INT, NULL);
+        void EndFrame()
+        {
+            DrawBatched();
+            s_VertexStream.NextRegion();
+            s_GlyphStream.NextRegion();
+            Editor::GetRegularFont()->NextFrame();
+        }
 
-            s_QuadCount = 0;
-            s_VertexInsert = s_VertexData;
+        void UpdateGlyphMetrics(uint32_t first, const CharMetrics* metrics, size_t count)
+        {
+            if(s_Headless)
+                return;
+
+            std::vector<GlyphQuad> quads(count);
+            for(size_t i = 0; i < count; ++i)
+            {
+                const CharMetrics& m = metrics[i];
+                // Glyphs that failed to load end up as empty quads.
+                if(m.Bottom_Left_X < 0.0f)
+                    continue;
+                quads[i] =
+                {
+                    { m.Bottom_Left_X, m.Bottom_Left_Y, m.Top_Right_X, m.Top_Right_Y },
+                    { (float)m.Bearing_X, (float)m.Size_Y - (float)m.Bearing_Y, (float)m.Size_X, -(float)m.Size_Y }
+                };
+            }
+            glNamedBufferSubData(s_GlyphMetricsBufferID, first * sizeof(GlyphQuad), quads.size() * sizeof(GlyphQuad), quads.data());
         }
 
         void Clear()
         {
-            glClear(GL_COLOR_BUFFER_BIT);
+            if(!s_Headless)
+                glClear(GL_COLOR_BUFFER_BIT);
         }
 
         void SetClearColor(float r, float g, float b)
         {
-            glClearColor(r, g, b, 1.0f);
+            if(!s_Headless)
+                glClearColor(r, g, b, 1.0f);
         }
 
         void UpdateProjection(float width, float height)
         {
+            s_FramebufferWidth = width;
+            s_FramebufferHeight = height;
+            s_ViewportWidth = width / s_Zoom;
+            s_ViewportHeight = height / s_Zoom;
+            s_UniformBufferStruct.ScaleX = 2.0f / s_ViewportWidth;
+            s_UniformBufferStruct.ScaleY = -2.0f / s_ViewportHeight;
+            if(s_Headless)
+                return;
             glViewport(0, 0, (GLsizei)width, (GLsizei)height);
-            s_UniformBufferStruct.ScaleX = 2.0f / width;
-            s_UniformBufferStruct.ScaleY = -2.0f / height;
             glNamedBufferSubData(s_UniformBuffer, 0, sizeof(s_UniformBufferStruct), &s_UniformBufferStruct);
         }
 
+        void SetZoom(float zoom)
+        {
+            s_Zoom = zoom;
+            if(s_FramebufferWidth > 0.0f && s_FramebufferHeight > 0.0f)
+                UpdateProjection(s_FramebufferWidth, s_FramebufferHeight);
+        }
+
         void UpdateFontTexture(uint32_t rendererID, int offX, int offY, int width, int height, const void* data)
         {
+            if(s_Headless)
+                return;
             glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             glTextureSubImage2D(
                     rendererID,
@@ -199,7 +368,7 @@ namespace dce
                     );
         }
 
-        uint32_t CreateFontTexture(uint32_t width, uint32_t height)
+        uint32_t CreateFontTexture(uint32_t width, uint32_t height, bool linearFiltering)
         {
             const size_t MAX_TEX_SIZE = 4096UL * 4096UL;
             if((size_t)width * (size_t)height > MAX_TEX_SIZE)
@@ -212,18 +381,18 @@ namespace dce
                 printf("Values of 0 are not allowed for width and height.\n");
                 return 0;
             }
+            if(s_Headless)
+                return 0;
 
             uint32_t rendererID;
             glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             glCreateTextures(GL_TEXTURE_2D, 1, &rendererID);
             glTextureStorage2D(rendererID, 1, GL_R8, width, height);
-            std::vector<uint8_t> temp((size_t)width * (size_t)height);
-            memset(temp.data(), 0, (size_t)width * (size_t)height);
+            glClearTexImage(rendererID, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
 
-            glTextureSubImage2D(rendererID, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, temp.data());
-
-            glTextureParameteri(rendererID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTextureParameteri(rendererID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            const GLint filter = linearFiltering ? GL_LINEAR : GL_NEAREST;
+            glTextureParameteri(rendererID, GL_TEXTURE_MIN_FILTER, filter);
+            glTextureParameteri(rendererID, GL_TEXTURE_MAG_FILTER, filter);
 
             glTextureParameteri(rendererID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
             glTextureParameteri(rendererID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -235,11 +404,22 @@ namespace dce
             return rendererID;
         }
 
+        void DestroyFontTexture(uint32_t rendererID)
+        {
+            if(!s_Headless && rendererID)
+                glDeleteTextures(1, &rendererID);
+        }
+
         size_t GetLastLineCountDrawn()
         {
             return s_LinesDrawn;
         }
 
+        size_t GetQuadsDrawn()
+        {
+            return s_QuadsDrawn;
+        }
+
 
         void DrawQuad(float x, float y,
                       float r, float g, float b, float a,
@@ -247,38 +427,92 @@ namespace dce
                       float topRightTexCoordX, float topRightTexCoordY,
                       float width, float height)
         {
-            s_VertexInsert[0] = (TextVertex)
+            if(s_VertexStream.GetBatchSize() >= MAX_VERTEX_COUNT * sizeof(TextVertex))
+                DrawBatched();
+            TextVertex* vertices = (TextVertex*)s_VertexStream.Allocate(4 * sizeof(TextVertex));
+            if(!vertices)
+            {
+                DrawBatched();
+                s_VertexStream.NextRegion();
+                vertices = (TextVertex*)s_VertexStream.Allocate(4 * sizeof(TextVertex));
+            }
+            vertices[0] = (TextVertex)
             {
                 x, y,
                 r, g, b, a,
                 botLeftTexCoordX, botLeftTexCoordY
             };
-            s_VertexInsert[1] = (TextVertex)
+            vertices[1] = (TextVertex)
             {
                 x + width, y,
                 r, g, b, a,
                 topRightTexCoordX, botLeftTexCoordY
             };
-            s_VertexInsert[2] = (TextVertex)
+            vertices[2] = (TextVertex)
             {
                 x + width, y + height,
                 r, g, b, a,
                 topRightTexCoordX, topRightTexCoordY
             };
-            s_VertexInsert[3] = (TextVertex)
+            vertices[3] = (TextVertex)
             {
                 x, y + height,
                 r, g, b, a,
                 botLeftTexCoordX, topRightTexCoordY
             };
-            ++s_QuadCount;
-            s_VertexInsert += 4;
+        }
+
+        static inline void DrawGlyph(float x, float y, uint32_t glyph, uint32_t color)
+        {
+            GlyphInstance* instance = (GlyphInstance*)s_GlyphStream.Allocate(sizeof(GlyphInstance));
+            if(!instance)
+            {
+                DrawBatched();
+                s_GlyphStream.NextRegion();
+                instance = (GlyphInstance*)s_GlyphStream.Allocate(sizeof(GlyphInstance));
+            }
+            *instance = { x, y, glyph, color };
+        }
+
+        // Copies glyphs laid out relative to a baseline, up to the first one
+        // below the viewport. Glyphs among the first highlightCount bytes of
+        // the line are colored by their kind in highlights.
+        static void DrawLayout(const LineLayout& layout, float baseline, const HighlightKind* highlights = nullptr,
+                               size_t highlightCount = 0)
+        {
+            Font* regularFont = Editor::GetRegularFont();
+            const GlyphInstance* glyph = layout.Glyphs.data();
+            const GlyphInstance* end = std::lower_bound(glyph, glyph + layout.Glyphs.size(), s_ViewportHeight - baseline,
+                    [](const GlyphInstance& instance, float y) { return instance.Y < y; });
+            while(glyph != end)
+            {
+                size_t count = std::min((size_t)(end - glyph), s_GlyphStream.GetRemaining() / sizeof(GlyphInstance));
+                if(count == 0)
+                {
+                    DrawBatched();
+                    s_GlyphStream.NextRegion();
+                    continue;
+                }
+
+                GlyphInstance* dest = (GlyphInstance*)s_GlyphStream.Allocate(count * sizeof(GlyphInstance));
+                for(size_t i = 0; i < count; ++i, ++glyph)
+                {
+                    regularFont->TouchGlyph(glyph->Glyph);
+                    dest[i] = *glyph;
+                    dest[i].Y += baseline;
+                    if(!highlights)
+                        continue;
+                    uint32_t offset = layout.Offsets[glyph - layout.Glyphs.data()];
+                    if(offset < highlightCount && highlights[offset] != HighlightKind::NONE)
+                        dest[i].Color = HIGHLIGHT_COLORS[(size_t)highlights[offset]];
+                }
+            }
         }
 
         static void DrawBasicText(const char* text, float* pen_X, float* pen_Y,
                 float xNewlineBeg, float yIncr)
         {
-            const Font* regularFont = Editor::GetRegularFont();
+            Font* regularFont = Editor::GetRegularFont();
             const FontMetrics& fm = regularFont->GetFontMetrics();
             size_t lineCharCnt = 0;
             for(; *text; ++text)
@@ -292,7 +526,7 @@ namespace dce
                 else if(c == '\t')
                 {
                     int size = 4 - (lineCharCnt & 3);
-                    pen_X += fm.Space_Size * size;
+                    *pen_X += fm.Space_Size * size;
                     lineCharCnt += size;
                 }
                 else if(c == '\n')
@@ -303,63 +537,77 @@ namespace dce
                 }
                 else
                 {
-                    const CharMetrics& metrics = regularFont->GetCharMetrics(c);
-                    float x = *pen_X + (float)metrics.Bearing_X;
-                    float y = *pen_Y + (float)metrics.Size_Y - (float)metrics.Bearing_Y;
-                    DrawQuad(x, y,
-                             1.0f, 1.0f, 1.0f, 1.0f,
-                             metrics.Bottom_Left_X, metrics.Bottom_Left_Y,
-                             metrics.Top_Right_X, metrics.Top_Right_Y,
-                             (float)metrics.Size_X, -(float)metrics.Size_Y);
-
+                    // Decoding stops at the terminator, which is never a
+                    // continuation byte.
+                    size_t sequenceLength;
+                    uint32_t glyph = regularFont->GetGlyphIndex(Utf8::Decode(text, 4, &sequenceLength));
+                    text += sequenceLength - 1;
+                    DrawGlyph(*pen_X, *pen_Y, glyph, TEXT_COLOR);
                     ++lineCharCnt;
-                    *pen_X += metrics.Advance;
+                    *pen_X += regularFont->GetGlyphMetrics(glyph).Advance;
                 }
             }
         }
 
         static void RenderCursor(float x, float y)
         {
-            int& cursorTimer = Editor::GetCursorTimer();
-            if(cursorTimer < 0)
-                cursorTimer = DCE_CURSOR_BLINK_THRESHOLD;
-            const Font* regularFont = Editor::GetRegularFont();
+            Font* regularFont = Editor::GetRegularFont();
             const FontMetrics& fm = regularFont->GetFontMetrics();
             y -= fm.Descender;
             DrawQuad(x, y,
-                    1.0f, 1.0f, 1.0f, (cursorTimer < (DCE_CURSOR_BLINK_THRESHOLD >> 1) ? 0.0f : 1.0f),
+                    1.0f, 1.0f, 1.0f, Editor::IsCursorVisible() ? 1.0f : 0.0f,
                     0.0f, 0.0f,
                     0.0f, 0.0f,
                     2.0f, -((float)Editor::GetFontSize() - fm.Descender));
-            --cursorTimer;
         }
 
         static void RenderLineNum(float x, float y, size_t lineNum)
         {
-            const CharMetrics* numMetrics = &Editor::GetRegularFont()->GetCharMetrics('0');
+            ScopedStageTimer timer(FrameStage::GUTTER);
+            Font* regularFont = Editor::GetRegularFont();
+            const uint32_t zeroGlyph = regularFont->GetGlyphIndex('0');
+            const float advance = (float)regularFont->GetCharMetrics('0').Advance;
             while(lineNum)
             {
-                if(s_QuadCount >= MAX_QUAD_COUNT)
-                    DrawBatched();
                 size_t rem = lineNum % 10;
                 lineNum /= 10;
-                x -= numMetrics->Advance;
-                DrawQuad(x + (float)numMetrics[rem].Bearing_X, y + (float)numMetrics[rem].Size_Y - (float)numMetrics[rem].Bearing_Y,
-                        0.863f, 0.91f, 0.655f, 1.0f,
-                        numMetrics[rem].Bottom_Left_X, numMetrics[rem].Bottom_Left_Y,
-                        numMetrics[rem].Top_Right_X, numMetrics[rem].Top_Right_Y,
-                        (float)numMetrics[rem].Size_X, -(float)numMetrics[rem].Size_Y);
+                x -= advance;
+                DrawGlyph(x, y, zeroGlyph + (uint32_t)rem, GUTTER_TEXT_COLOR);
             }
         }
 
+        // Only the matches that overlap the visible bytes are looked at, they
+        // get laid over a copy of the syntax highlights.
+        template<typename Search>
+        static const HighlightKind* HighlightMatches(const Search& search, size_t start, size_t size,
+                                                     const HighlightKind* highlights)
+        {
+            size_t index = search.FindOverlapping(start);
+            if(index == search.GetMatchCount() || search.GetMatch(index) >= start + size)
+                return highlights;
+
+            if(highlights)
+                s_MatchHighlights.assign(highlights, highlights + size);
+            else
+                s_MatchHighlights.assign(size, HighlightKind::NONE);
+            for(; index < search.GetMatchCount() && search.GetMatch(index) < start + size; ++index)
+            {
+                size_t match = search.GetMatch(index);
+                size_t from = match > start ? match - start : 0;
+                size_t to = std::min(size, search.GetMatchEnd(index) - start);
+                std::fill(s_MatchHighlights.begin() + from, s_MatchHighlights.begin() + to, HighlightKind::MATCH);
+            }
+            return s_MatchHighlights.data();
+        }
+
         void RenderEditor()
         {
             // TODO: Make this customizable along with text color.
-            const Font* regularFont = Editor::GetRegularFont();
+            Font* regularFont = Editor::GetRegularFont();
             float curs_X, curs_Y;
             const float START_X = (float)regularFont->GetCharMetrics('0').Advance;
             {
-                glUseProgram(s_BasicShaderID);
+                ScopedStageTimer timer(FrameStage::GUTTER);
                 DrawQuad(0.0f, 0.0f,
                         0.2f, 0.2f, 0.2f, 1.0f,
                         0.0f, 0.0f, 0.0f, 0.0f,
@@ -368,87 +616,90 @@ namespace dce
             }
             // RENDER ACTUAL TEXT AND EVENTUALLY LINE NUMBERS
             {
-                glUseProgram(s_TextShaderID);
-                const FontMetrics& fm = regularFont->GetFontMetrics();
-                float pen_X = START_X * 5.0f, pen_Y = Editor::GetLineHeight();
-                curs_X = pen_X;
+                ScopedStageTimer timer(FrameStage::TEXT);
+                const float lineHeight = Editor::GetLineHeight();
+                const LayoutParams params = { regularFont, START_X * 5.0f, s_ViewportWidth - lineHeight, lineHeight, TEXT_COLOR };
+                s_LayoutCache.BeginFrame(params);
+                float pen_Y = lineHeight;
+                curs_X = params.StartX;
                 curs_Y = pen_Y;
 
-                const EditorStorage& storage = Editor::GetStorage();
-                const GapBuffer<char>& charData = storage.GetCharData();
-                const GapBuffer<size_t>& lineData = storage.GetLineData();
-                const EditorWindow* win = Editor::GetWindow();
-
-                size_t cameraStart = storage.GetCameraStartLine() - 1;
-                size_t start = lineData[cameraStart];
-
-                size_t lineCharCnt = 0;
+                EditorStorage& storage = Editor::GetStorage();
+                const TextBuffer& text = storage.GetText();
+                const LineIndex& lines = storage.GetLines();
+                const size_t cursor = storage.GetCursor();
+                size_t line = storage.GetCameraStartLine() - 1;
                 size_t lineNum = storage.GetCameraStartLine();
-                RenderLineNum(START_X * 4.0f, pen_Y, lineNum);
-                for(size_t i = start; i < charData.Size() && 
-                    pen_Y < (float)win->GetHeight(); ++i)
+                // Glyphs new to the atlas are rasterized for every line that
+                // may be visible at once, as many as fit unwrapped, instead of
+                // one by one as layout finds them. The same bytes are
+                // highlighted.
+                const size_t visibleStart = lines.GetLineStart(line);
+                const HighlightKind* highlights;
                 {
-
-                    if(s_QuadCount >= MAX_QUAD_COUNT)
-                        DrawBatched();
-
-                    char c = charData[i];
-
-                    if(c == ' ')
-                    {
-                        ++lineCharCnt;
-                        pen_X += fm.Space_Size;
-                    }
-                    else if(c == '\t')
-                    {
-                        int size = 4 - (lineCharCnt & 3);
-                        pen_X += fm.Space_Size * size;
-                        lineCharCnt += size;
-                    }
-                    else if(c == '\n')
-                    {
-                        pen_X = START_X * 5.0f;
-                        pen_Y += Editor::GetLineHeight();
-                        lineCharCnt = 0;
-                        ++lineNum;
-                        RenderLineNum(START_X * 4.0f, pen_Y, lineNum);
-                    }
-                    else
+                    size_t endLine = std::min(lines.GetLineCount(), line + (size_t)(s_ViewportHeight / lineHeight) + 1);
+                    size_t maxLength = (endLine - line) * ((size_t)s_ViewportWidth + 1);
+                    s_PrefetchData.resize(std::min(lines.GetLineStart(endLine) - visibleStart, maxLength));
+                    text.Read(visibleStart, s_PrefetchData.size(), s_PrefetchData.data());
+                    regularFont->Prefetch(s_PrefetchData.data(), s_PrefetchData.size());
+                    highlights = storage.GetSyntax().Highlight(text, storage.GetLines(), visibleStart, s_PrefetchData.size());
+                    highlights = HighlightMatches(storage.GetSearch(), visibleStart, s_PrefetchData.size(), highlights);
+                    highlights = HighlightMatches(storage.GetRegexSearch(), visibleStart, s_PrefetchData.size(), highlights);
+                }
+                while(true)
+                {
+                    RenderLineNum(START_X * 4.0f, pen_Y, lineNum);
+                    bool isLast = line + 1 >= lines.GetLineCount();
+                    size_t start = lines.GetLineStart(line);
+                    size_t length = lines.GetLineLength(line) - (isLast ? 0 : 1);
+
+                    // Only what can still fit on screen is read of lines too
+                    // long to cache, assuming every character is at least a
+                    // pixel wide.
+                    uint32_t maxRows = (uint32_t)((s_ViewportHeight - pen_Y) / lineHeight) + 1;
+                    size_t readLength = length;
+                    if(length > LineLayoutCache::MAX_LINE_LENGTH)
+                        readLength = std::min(length, (size_t)maxRows * ((size_t)s_ViewportWidth + 1));
+                    s_LineData.resize(readLength);
+                    text.Read(start, readLength, s_LineData.data());
+
+                    const LineLayout* layout = readLength == length ? s_LayoutCache.Get(s_LineData.data(), length) : nullptr;
+                    if(!layout)
                     {
-                        const CharMetrics& metrics = regularFont->GetCharMetrics(c);
-                        float x = pen_X + (float)metrics.Bearing_X;
-                        float y = pen_Y + (float)metrics.Size_Y - (float)metrics.Bearing_Y;
-                        DrawQuad(x, y,
-                                1.0f, 1.0f, 1.0f, 1.0f,
-                                metrics.Bottom_Left_X, metrics.Bottom_Left_Y,
-                                metrics.Top_Right_X, metrics.Top_Right_Y,
-                                (float)metrics.Size_X, -(float)metrics.Size_Y);
-
-                        pen_X += metrics.Advance;
-                        ++lineCharCnt;
+                        LineLayoutCache::Layout(s_LineData.data(), readLength, params, s_UncachedLayout, maxRows);
+                        layout = &s_UncachedLayout;
                     }
-                    if((pen_X + Editor::GetLineHeight()) * s_UniformBufferStruct.ScaleX > 2.0f)
+                    if(cursor >= start && cursor - start <= readLength)
                     {
-                        pen_X = START_X * 5.0f;
-                        pen_Y += Editor::GetLineHeight();
+                        float x = curs_X, y = curs_Y - pen_Y;
+                        LineLayoutCache::Layout(s_LineData.data(), cursor - start, params, s_CursorLayout, maxRows,
+                                                cursor - start, &x, &y);
+                        curs_X = x;
+                        curs_Y = pen_Y + y;
                     }
+                    size_t highlightOffset = std::min(start - visibleStart, s_PrefetchData.size());
+                    DrawLayout(*layout, pen_Y, highlights ? highlights + highlightOffset : nullptr,
+                               s_PrefetchData.size() - highlightOffset);
 
-                    if(i+1 == charData.GapPos())
+                    float lastRow = pen_Y + (float)(layout->Rows - 1) * lineHeight;
+                    if(isLast || lastRow >= s_ViewportHeight)
                     {
-                        curs_X = pen_X;
-                        curs_Y = pen_Y;
+                        pen_Y = lastRow;
+                        break;
                     }
+                    pen_Y = lastRow + lineHeight;
+                    ++lineNum;
+                    if(pen_Y >= s_ViewportHeight)
+                        break;
+                    ++line;
                 }
-                const CharMetrics& tilda = regularFont->GetCharMetrics('~');
+                const uint32_t tildaGlyph = regularFont->GetGlyphIndex('~');
+                const float tildaX = START_X * 4.0f - (float)regularFont->GetCharMetrics('~').Advance;
                 pen_Y += Editor::GetLineHeight();
-                while(pen_Y < (float)win->GetHeight())
+                ScopedStageTimer gutterTimer(FrameStage::GUTTER);
+                while(pen_Y < s_ViewportHeight)
                 {
-                    DrawQuad(START_X * 4.0f - (float)tilda.Advance + (float)tilda.Bearing_X, 
-                            pen_Y + (float)tilda.Size_Y - (float)tilda.Bearing_Y,
-                            0.863f, 0.91f, 0.655f, 1.0f,
-                            tilda.Bottom_Left_X, tilda.Bottom_Left_Y,
-                            tilda.Top_Right_X, tilda.Top_Right_Y,
-                            (float)tilda.Size_X, -(float)tilda.Size_Y);
+                    DrawGlyph(tildaX, pen_Y, tildaGlyph, GUTTER_TEXT_COLOR);
                     pen_Y += Editor::GetLineHeight();
                     ++lineNum;
                 }
@@ -457,10 +708,82 @@ namespace dce
             }
             // RENDER CURSOR
             {
-                glUseProgram(s_BasicShaderID);
+                ScopedStageTimer timer(FrameStage::CURSOR);
                 RenderCursor(curs_X, curs_Y);
                 DrawBatched();
             }
+            // RENDER LOADING PROGRESS
+            if(FileMan::IsLoading(Editor::GetStorage()))
+            {
+                ScopedStageTimer timer(FrameStage::OVERLAY);
+                float width = s_ViewportWidth;
+                float height = s_ViewportHeight;
+                DrawQuad(0.0f, height,
+                        0.863f, 0.91f, 0.655f, 1.0f,
+                        0.0f, 0.0f, 0.0f, 0.0f,
+                        width * FileMan::GetLoadProgress(Editor::GetStorage()), -4.0f);
+                DrawBatched();
+
+                char status[32];
+                snprintf(status, sizeof(status), "Indexing %d%%", (int)(FileMan::GetLoadProgress(Editor::GetStorage()) * 100.0f));
+                float pen_X = width - START_X * 14.0f, pen_Y = height - 8.0f;
+                DrawBasicText(status, &pen_X, &pen_Y, pen_X, 0.0f);
+                DrawBatched();
+            }
+        }
+
+        template<typename Search>
+        static void FormatFindStatus(const Search& search, char* o_Status, size_t size)
+        {
+            size_t count = search.GetMatchCount();
+            if(search.GetQuery().empty())
+                o_Status[0] = '\0';
+            else if(search.IsSearching())
+                snprintf(o_Status, size, "   %lu so far, searching...", count);
+            else if(count == 0)
+                snprintf(o_Status, size, "   no matches");
+            else
+            {
+                // Counts the match the cursor is on, or the first one after it.
+                size_t current = std::min(search.FindNext(Editor::GetStorage().GetCursor()), count - 1);
+                snprintf(o_Status, size, "   %lu of %lu", current + 1, count);
+            }
+        }
+
+        // Along the bottom, over the text.
+        void RenderFindBar(bool regex)
+        {
+            ScopedStageTimer timer(FrameStage::OVERLAY);
+            const EditorStorage& storage = Editor::GetStorage();
+            const float lineHeight = Editor::GetLineHeight();
+            DrawQuad(0.0f, s_ViewportHeight,
+                    0.15f, 0.15f, 0.15f, 1.0f,
+                    0.0f, 0.0f, 0.0f, 0.0f,
+                    s_ViewportWidth, -lineHeight * 1.2f);
+            DrawBatched();
+
+            char status[128];
+            const std::string* query;
+            if(regex)
+            {
+                const RegexSearch& search = storage.GetRegexSearch();
+                query = &search.GetQuery();
+                if(search.GetError().empty())
+                    FormatFindStatus(search, status, sizeof(status));
+                else
+                    snprintf(status, sizeof(status), "   %s", search.GetError().c_str());
+            }
+            else
+            {
+                query = &storage.GetSearch().GetQuery();
+                FormatFindStatus(storage.GetSearch(), status, sizeof(status));
+            }
+            float pen_X = 0.0f, pen_Y = s_ViewportHeight - lineHeight * 0.3f;
+            DrawBasicText(regex ? "Regex: " : "Find: ", &pen_X, &pen_Y, 0.0f, 0.0f);
+            DrawBasicText(query->c_str(), &pen_X, &pen_Y, 0.0f, 0.0f);
+            RenderCursor(pen_X, pen_Y);
+            DrawBasicText(status, &pen_X, &pen_Y, 0.0f, 0.0f);
+            DrawBatched();
         }
 
         void RenderFileManager(size_t selected)
@@ -468,7 +791,7 @@ namespace dce
             float curs_X = 0.0f, curs_Y = 0.0f;
             float curs_Width = 0.0f;
             {
-                glUseProgram(s_TextShaderID);
+                ScopedStageTimer timer(FrameStage::FILE_LIST);
                 float pen_X = 0.0f, pen_Y = Editor::GetLineHeight();
                 DrawBasicText("ALL FILES\n\n", &pen_X, &pen_Y, 0.0f, Editor::GetLineHeight());
                 curs_X = pen_X;
@@ -490,7 +813,7 @@ namespace dce
                 DrawBatched();
             }
             {
-                glUseProgram(s_BasicShaderID);
+                ScopedStageTimer timer(FrameStage::CURSOR);
                 const FontMetrics& fm = Editor::GetRegularFont()->GetFontMetrics();
                 DrawQuad(curs_X, curs_Y - fm.Descender,
                         1.0f, 1.0f, 1.0f, 0.4f,
@@ -500,6 +823,52 @@ namespace dce
             }
         }
 
+        // Stats of the frames before this one, in the top right corner.
+        void RenderFrameStats()
+        {
+            ScopedStageTimer timer(FrameStage::OVERLAY);
+            FrameStats::Summary summary;
+            FrameStats::Summarize(summary);
+
+            char stats[512];
+            int length = snprintf(stats, sizeof(stats),
+                    "p50 %.2f ms  p99 %.2f ms  max %.2f ms\n"
+                    "%.1f draws  %.0f quads  %.1f KB\n",
+                    summary.P50, summary.P99, summary.Max,
+                    summary.DrawCalls, summary.Quads, summary.BytesUploaded / 1024.0f);
+            for(size_t stage = 0; stage < (size_t)FrameStage::COUNT && length < (int)sizeof(stats); ++stage)
+            {
+                length += snprintf(stats + length, sizeof(stats) - length, "%s %.3f%s",
+                        FrameStats::GetStageName((FrameStage)stage), summary.StageAverages[stage],
+                        stage % 3 == 2 ? "\n" : "  ");
+            }
+
+            const float SCALE = 0.5f;
+            const float lineHeight = Editor::GetLineHeight() * SCALE;
+            const float width = (float)Editor::GetRegularFont()->GetCharMetrics('0').Advance * 46.0f * SCALE;
+            const float left = s_ViewportWidth - width;
+            DrawQuad(left, 0.0f,
+                    0.0f, 0.0f, 0.0f, 0.7f,
+                    0.0f, 0.0f, 0.0f, 0.0f,
+                    width, lineHeight * 6.5f);
+            DrawBatched();
+
+            // The font only comes in one size, so the text is drawn at full
+            // size into a projection scaled down around the top left corner.
+            float pen_X = left / SCALE, pen_Y = Editor::GetLineHeight();
+            float scaleX = s_UniformBufferStruct.ScaleX, scaleY = s_UniformBufferStruct.ScaleY;
+            s_UniformBufferStruct.ScaleX *= SCALE;
+            s_UniformBufferStruct.ScaleY *= SCALE;
+            if(!s_Headless)
+                glNamedBufferSubData(s_UniformBuffer, 0, sizeof(s_UniformBufferStruct), &s_UniformBufferStruct);
+            DrawBasicText(stats, &pen_X, &pen_Y, pen_X, Editor::GetLineHeight());
+            DrawBatched();
+            s_UniformBufferStruct.ScaleX = scaleX;
+            s_UniformBufferStruct.ScaleY = scaleY;
+            if(!s_Headless)
+                glNamedBufferSubData(s_UniformBuffer, 0, sizeof(s_UniformBufferStruct), &s_UniformBufferStruct);
+        }
+
         namespace 
         {
             bool CompileShader(GLuint shader_id, const char* shader_src, GLenum type)
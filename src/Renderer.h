@@ -8,14 +8,30 @@ namespace dce
     namespace Renderer
     {
         bool Init();
+        void InitHeadless();
         void Clear();
         void SetClearColor(float r, float g, float b);
         void UpdateProjection(float width, float height);
+        // Everything is drawn zoom times as large, the viewport shrinking by as
+        // much in the units the editor lays text out in.
+        void SetZoom(float zoom);
         void UpdateFontTexture(uint32_t rendererID, int offX, int offY, int width, int height, const void* data);
-        uint32_t CreateFontTexture(uint32_t width, uint32_t height);
+        uint32_t CreateFontTexture(uint32_t width, uint32_t height, bool linearFiltering = false);
+        void DestroyFontTexture(uint32_t rendererID);
+        // Hands the atlas layout of count glyphs starting at index first to the
+        // glyph shader, which can address up to Font::MAX_GLYPHS of them.
+        void UpdateGlyphMetrics(uint32_t first, const CharMetrics* metrics, size_t count);
         size_t GetLastLineCountDrawn();
+        size_t GetQuadsDrawn();
         void RenderEditor();
+        // The query, a regular expression's if regex is set, and how many
+        // matches it has so far.
+        void RenderFindBar(bool regex);
         void RenderFileManager(size_t selected);
+        void RenderFrameStats();
+        // Draws whatever is still queued and moves the stream buffers on to
+        // the next frame's region, call once per frame before swapping.
+        void EndFrame();
     }
 }
 
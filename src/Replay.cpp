@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Replay.h"
+
+namespace dce
+{
+    namespace Replay
+    {
+        static FILE* s_RecordFile = nullptr;
+
+        bool LoadScript(const std::string& filepath, std::vector<KeyEvent>& o_Events)
+        {
+            FILE* file = fopen(filepath.c_str(), "r");
+            if(!file)
+            {
+                printf("Unable to open replay script: %s\n", filepath.c_str());
+                return false;
+            }
+
+            char line[256];
+            size_t lineNum = 0;
+            bool ok = true;
+            while(fgets(line, sizeof(line), file))
+            {
+                ++lineNum;
+                const char* start = line + strspn(line, " \t");
+                if(*start == '#' || *start == '\n' || *start == '\0')
+                    continue;
+
+                double time;
+                int code, mods;
+                char repeat = '\0';
+                if(sscanf(start, "%lf %d %d %c", &time, &code, &mods, &repeat) < 3)
+                {
+                    printf("Malformed replay event on line %lu of %s.\n", lineNum, filepath.c_str());
+                    ok = false;
+                    break;
+                }
+                o_Events.push_back({ time, (KeyCode)code, mods, repeat == 'r' });
+            }
+            fclose(file);
+
+            std::stable_sort(o_Events.begin(), o_Events.end(),
+                             [](const KeyEvent& a, const KeyEvent& b) { return a.Time < b.Time; });
+            return ok;
+        }
+
+        bool StartRecording(const std::string& filepath)
+        {
+            StopRecording();
+            s_RecordFile = fopen(filepath.c_str(), "w");
+            if(!s_RecordFile)
+            {
+                printf("Unable to open file to record keys to: %s\n", filepath.c_str());
+                return false;
+            }
+            fprintf(s_RecordFile, "# <seconds> <key code> <mods> [r]\n");
+            return true;
+        }
+
+        void RecordKey(const KeyEvent& event)
+        {
+            if(!s_RecordFile)
+                return;
+            fprintf(s_RecordFile, "%.6f %d %d%s\n", event.Time, (int)event.Code, event.Mods, event.Repeat ? " r" : "");
+        }
+
+        void StopRecording()
+        {
+            if(!s_RecordFile)
+                return;
+            fclose(s_RecordFile);
+            s_RecordFile = nullptr;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef _DCE_REPLAY_H
+#define _DCE_REPLAY_H
+
+#include <string>
+#include <vector>
+
+#include "Core.h"
+#include "KeyCodes.h"
+
+namespace dce
+{
+    struct KeyEvent
+    {
+        double Time; // Seconds since the start of the session.
+        KeyCode Code;
+        int Mods;
+        bool Repeat;
+    };
+
+    // Key traces are plain text, one event per line:
+    //     <seconds> <key code> <mods> [r]
+    // where 'r' marks a key repeat. Empty lines and lines starting with '#'
+    // are ignored. --record writes this format, --replay reads it.
+    namespace Replay
+    {
+        bool LoadScript(const std::string& filepath, std::vector<KeyEvent>& o_Events);
+        bool StartRecording(const std::string& filepath);
+        void RecordKey(const KeyEvent& event);
+        void StopRecording();
+    }
+}
+
+#endif // _DCE_REPLAY_H
@@ -0,0 +1,83 @@
+#include <list>
+
+#include "Scheduler.h"
+
+namespace dce
+{
+    namespace Scheduler
+    {
+        struct ScheduledTask
+        {
+            TaskID ID;
+            Task Function;
+            TaskStatus Status;
+        };
+
+        // A list, so tasks can post others while they run. Never destroyed,
+        // buffers with static lifetime cancel their tasks on their way out.
+        static std::list<ScheduledTask>& s_Tasks = *new std::list<ScheduledTask>();
+        static TaskID s_NextID = NO_TASK + 1;
+
+        TaskID Post(Task task)
+        {
+            s_Tasks.push_back({ s_NextID, std::move(task), TaskStatus::YIELDED });
+            return s_NextID++;
+        }
+
+        void Cancel(TaskID id)
+        {
+            // Only marked, the task may be the one running right now.
+            for(ScheduledTask& task : s_Tasks)
+            {
+                if(task.ID == id)
+                    task.Status = TaskStatus::DONE;
+            }
+        }
+
+        void Run(Clock::time_point deadline)
+        {
+            // Whichever task got cut off last time goes last, so one that
+            // could use every frame doesn't starve the others.
+            if(!s_Tasks.empty() && s_Tasks.front().Status == TaskStatus::YIELDED)
+                s_Tasks.splice(s_Tasks.end(), s_Tasks, s_Tasks.begin());
+
+            // Blocked tasks get a single turn, the rest as many as there's
+            // time for.
+            bool firstPass = true;
+            bool yielded = true;
+            while(yielded)
+            {
+                yielded = false;
+                for(auto it = s_Tasks.begin(); it != s_Tasks.end(); )
+                {
+                    if(it->Status == TaskStatus::DONE)
+                    {
+                        it = s_Tasks.erase(it);
+                        continue;
+                    }
+                    if(Clock::now() >= deadline)
+                        return;
+                    if(firstPass || it->Status == TaskStatus::YIELDED)
+                    {
+                        TaskStatus status = it->Function(deadline);
+                        if(it->Status != TaskStatus::DONE)
+                            it->Status = status;
+                        yielded |= it->Status == TaskStatus::YIELDED;
+                    }
+                    ++it;
+                }
+                firstPass = false;
+            }
+        }
+
+        bool HasWork()
+        {
+            for(const ScheduledTask& task : s_Tasks)
+            {
+                if(task.Status == TaskStatus::YIELDED)
+                    return true;
+            }
+            return false;
+        }
+    }
+}
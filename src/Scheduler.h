@@ -0,0 +1,43 @@
+#ifndef _DCE_SCHEDULER_H
+#define _DCE_SCHEDULER_H
+
+#include <chrono>
+#include <functional>
+
+#include "Core.h"
+
+namespace dce
+{
+    enum class TaskStatus : uint8_t
+    {
+        DONE,
+        YIELDED,    // Ran out of time with more left to do.
+        BLOCKED     // Waiting on a worker thread, which wakes the editor once it's done.
+    };
+
+    // Cooperative tasks that run on the main thread in whatever time a frame
+    // has left once it's drawn. A task does a slice of its work at a time,
+    // checking the deadline it's given as it goes, and returns whether it's
+    // done. Blocked tasks only get to check on what they wait for once per
+    // Run() and don't keep the editor from going to sleep. Work that can't be
+    // broken up into slices that short belongs on a worker thread.
+    namespace Scheduler
+    {
+        typedef std::chrono::steady_clock Clock;
+        typedef std::function<TaskStatus(Clock::time_point deadline)> Task;
+        typedef uint64_t TaskID;
+
+        TaskID Post(Task task);
+        // Drops a task before it's done, ids of finished tasks are ignored.
+        void Cancel(TaskID id);
+        // Takes turns running the tasks until each is done or blocked, or the
+        // deadline passes. Nothing is started past the deadline.
+        void Run(Clock::time_point deadline);
+        // Whether there are tasks that could use more time right now.
+        bool HasWork();
+
+        static constexpr TaskID NO_TASK = 0;
+    }
+}
+
+#endif // _DCE_SCHEDULER_H
@@ -0,0 +1,742 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+#include "Search.h"
+#include "Editor.h"
+#include "TextScan.h"
+#include "WorkerPool.h"
+
+namespace dce
+{
+    TextSearch::TextSearch()
+    {
+        m_Text = nullptr;
+        m_Task = Scheduler::NO_TASK;
+        m_Phase = SearchPhase::IDLE;
+        m_Changed = false;
+        m_MatchedLength = 0;
+        m_NarrowNext = 0;
+        m_ScanPosition = 0;
+    }
+
+    TextSearch::~TextSearch()
+    {
+        Scheduler::Cancel(m_Task);
+    }
+
+    void TextSearch::SetQuery(const TextBuffer& text, const std::string& query)
+    {
+        if(query.empty())
+        {
+            Clear();
+            return;
+        }
+        if(&text == m_Text && query == m_Query)
+            return;
+
+        bool extended = &text == m_Text && !m_Query.empty() && query.size() > m_Query.size()
+            && query.compare(0, m_Query.size(), m_Query) == 0;
+        m_Text = &text;
+        m_Query = query;
+        if(!extended)
+        {
+            Restart();
+            return;
+        }
+
+        // Every match of the longer query is one of the shorter one, only
+        // those get checked. Matches that were already checked against an
+        // earlier extension are checked again, they're few by then.
+        m_Found.clear();
+        m_NarrowNext = 0;
+        m_Phase = SearchPhase::NARROWING;
+        StartTask();
+    }
+
+    void TextSearch::Clear()
+    {
+        Scheduler::Cancel(m_Task);
+        m_Task = Scheduler::NO_TASK;
+        m_Text = nullptr;
+        m_Query.clear();
+        m_Changed |= !m_Matches.empty();
+        m_Matches.clear();
+        m_Found.clear();
+        m_Phase = SearchPhase::IDLE;
+        m_MatchedLength = 0;
+        m_ScanPosition = 0;
+    }
+
+    void TextSearch::OnInsert(size_t position, size_t count)
+    {
+        if(m_Query.empty())
+            return;
+        if(m_Phase == SearchPhase::NARROWING)
+        {
+            Restart();
+            return;
+        }
+
+        // Matches that took in the position are broken, the ones after it moved.
+        size_t length = m_MatchedLength;
+        size_t first = position >= length ? position - length + 1 : 0;
+        auto from = std::lower_bound(m_Matches.begin(), m_Matches.end(), first);
+        auto to = std::lower_bound(from, m_Matches.end(), position);
+        m_Changed |= from != to;
+        for(auto it = to; it != m_Matches.end(); ++it)
+            *it += count;
+        size_t index = m_Matches.erase(from, to) - m_Matches.begin();
+
+        // Only the text before the scan position is searched here, the task
+        // gets to the rest.
+        size_t scanned = m_Text->Size();
+        if(m_Phase == SearchPhase::SCANNING)
+        {
+            if(position < m_ScanPosition)
+                m_ScanPosition += count;
+            scanned = m_ScanPosition;
+        }
+        else
+            m_ScanPosition = scanned;
+
+        m_Found.clear();
+        FindIn(first, std::min(position + count, scanned), m_Found);
+        m_Matches.insert(m_Matches.begin() + index, m_Found.begin(), m_Found.end());
+        m_Changed |= !m_Found.empty();
+    }
+
+    void TextSearch::OnErase(size_t position, size_t count)
+    {
+        if(m_Query.empty())
+            return;
+        if(m_Phase == SearchPhase::NARROWING)
+        {
+            Restart();
+            return;
+        }
+
+        size_t length = m_MatchedLength;
+        size_t first = position >= length ? position - length + 1 : 0;
+        auto from = std::lower_bound(m_Matches.begin(), m_Matches.end(), first);
+        auto to = std::lower_bound(from, m_Matches.end(), position + count);
+        m_Changed |= from != to;
+        for(auto it = to; it != m_Matches.end(); ++it)
+            *it -= count;
+        size_t index = m_Matches.erase(from, to) - m_Matches.begin();
+
+        size_t scanned = m_Text->Size();
+        if(m_Phase == SearchPhase::SCANNING)
+        {
+            if(position < m_ScanPosition)
+                m_ScanPosition = m_ScanPosition - position > count ? m_ScanPosition - count : position;
+            scanned = m_ScanPosition;
+        }
+        else
+            m_ScanPosition = scanned;
+
+        m_Found.clear();
+        FindIn(first, std::min(position, scanned), m_Found);
+        m_Matches.insert(m_Matches.begin() + index, m_Found.begin(), m_Found.end());
+        m_Changed |= !m_Found.empty();
+    }
+
+    bool TextSearch::Update()
+    {
+        bool changed = m_Changed;
+        m_Changed = false;
+        return changed;
+    }
+
+    size_t TextSearch::FindNext(size_t position) const
+    {
+        return std::lower_bound(m_Matches.begin(), m_Matches.end(), position) - m_Matches.begin();
+    }
+
+    size_t TextSearch::FindPrevious(size_t position) const
+    {
+        size_t index = FindNext(position);
+        return index ? index - 1 : m_Matches.size();
+    }
+
+    size_t TextSearch::FindOverlapping(size_t position) const
+    {
+        size_t length = m_MatchedLength;
+        return FindNext(position >= length ? position - length + 1 : 0);
+    }
+
+    void TextSearch::Restart()
+    {
+        m_Changed |= !m_Matches.empty();
+        m_Matches.clear();
+        m_Found.clear();
+        m_MatchedLength = m_Query.size();
+        m_ScanPosition = 0;
+        m_Phase = SearchPhase::SCANNING;
+        StartTask();
+    }
+
+    void TextSearch::StartTask()
+    {
+        if(m_Task == Scheduler::NO_TASK)
+            m_Task = Scheduler::Post([this](Scheduler::Clock::time_point deadline) { return Search(deadline); });
+    }
+
+    TaskStatus TextSearch::Search(Scheduler::Clock::time_point deadline)
+    {
+        if(m_Phase == SearchPhase::NARROWING && !Narrow(deadline))
+            return TaskStatus::YIELDED;
+        if(m_Phase == SearchPhase::SCANNING && !Scan(deadline))
+            return TaskStatus::YIELDED;
+        m_Task = Scheduler::NO_TASK;
+        return TaskStatus::DONE;
+    }
+
+    bool TextSearch::Narrow(Scheduler::Clock::time_point deadline)
+    {
+        const char* rest = m_Query.data() + m_MatchedLength;
+        size_t restLength = m_Query.size() - m_MatchedLength;
+        m_Window.resize(restLength);
+        while(m_NarrowNext < m_Matches.size())
+        {
+            size_t end = std::min(m_Matches.size(), m_NarrowNext + NARROW_SLICE_SIZE);
+            for(; m_NarrowNext < end; ++m_NarrowNext)
+            {
+                size_t match = m_Matches[m_NarrowNext];
+                if(m_Text->Read(match + m_MatchedLength, restLength, m_Window.data()) == restLength
+                   && memcmp(m_Window.data(), rest, restLength) == 0)
+                    m_Found.push_back(match);
+            }
+            if(m_NarrowNext < m_Matches.size() && Scheduler::Clock::now() >= deadline)
+                return false;
+        }
+
+        // The old matches stay up until all of them are checked.
+        m_Changed = true;
+        m_Matches.swap(m_Found);
+        m_Found.clear();
+        m_MatchedLength = m_Query.size();
+        // A scan that was cut short by the longer query goes on with it.
+        m_Phase = m_ScanPosition < m_Text->Size() ? SearchPhase::SCANNING : SearchPhase::IDLE;
+        return true;
+    }
+
+    bool TextSearch::Scan(Scheduler::Clock::time_point deadline)
+    {
+        size_t size = m_Text->Size();
+        while(m_ScanPosition < size)
+        {
+            size_t end = std::min(size, m_ScanPosition + SEARCH_SLICE_SIZE);
+            size_t found = m_Matches.size();
+            FindIn(m_ScanPosition, end, m_Matches);
+            m_Changed |= m_Matches.size() != found;
+            m_ScanPosition = end;
+            if(m_ScanPosition < size && Scheduler::Clock::now() >= deadline)
+                return false;
+        }
+        // Done searching shows, even without new matches.
+        m_Changed = true;
+        m_Phase = SearchPhase::IDLE;
+        return true;
+    }
+
+    void TextSearch::FindIn(size_t start, size_t end, std::vector<size_t>& o_Matches)
+    {
+        const TextBuffer& text = *m_Text;
+        const char* query = m_Query.data();
+        size_t length = m_Query.size();
+        // Matches starting before end can run this far.
+        size_t limit = std::min(text.Size(), end + length - 1);
+        size_t position = start;
+        while(position < end)
+        {
+            TextSpan span = text.SpanAt(position);
+            size_t spanEnd = position + span.Size;
+            TextScan::FindAll(span.Data, std::min(spanEnd, limit) - position, query, length, position, o_Matches);
+            if(spanEnd >= limit)
+                break;
+
+            // Matches that go on into the next span are looked for in a copy
+            // of the bytes on both sides of the boundary.
+            size_t windowStart = std::max(position, spanEnd >= length ? spanEnd - length + 1 : 0);
+            size_t windowEnd = std::min(limit, spanEnd + length - 1);
+            size_t stop = std::min(spanEnd, end);
+            if(windowStart < stop)
+            {
+                m_Window.resize(windowEnd - windowStart);
+                text.Read(windowStart, m_Window.size(), m_Window.data());
+                size_t found = o_Matches.size();
+                TextScan::FindAll(m_Window.data(), m_Window.size(), query, length, windowStart, o_Matches);
+                // Those starting in the next span are found with it.
+                while(o_Matches.size() > found && o_Matches.back() >= stop)
+                    o_Matches.pop_back();
+            }
+            position = spanEnd;
+        }
+    }
+
+    // Shared by the main thread and the workers, which hold on to it until
+    // they're done even if the search has moved on.
+    struct RegexSearch::Job
+    {
+        std::vector<TextSpan> Spans;
+        std::vector<size_t> SpanStarts;
+        std::unique_ptr<char[]> Copy;
+        std::vector<size_t> ChunkStarts;    // One past the last chunk is the end.
+        Regex Pattern;
+
+        std::atomic<size_t> NextChunk{ 0 };
+        std::atomic<bool> Cancelled{ false };
+        std::mutex Lock;
+        std::condition_variable Stopped;
+        size_t Running = 0;
+        std::vector<std::vector<RegexMatch>> Results;
+        std::vector<uint8_t> Done;
+    };
+
+    // Bytes from start up to end of the snapshot, in place if they lie in a
+    // single span.
+    static const char* ReadSnapshot(const std::vector<TextSpan>& spans, const std::vector<size_t>& spanStarts,
+                                    size_t start, size_t end, std::vector<char>& o_Buffer)
+    {
+        size_t span = std::upper_bound(spanStarts.begin(), spanStarts.end(), start) - spanStarts.begin() - 1;
+        if(end - spanStarts[span] <= spans[span].Size)
+            return spans[span].Data + (start - spanStarts[span]);
+
+        o_Buffer.resize(end - start);
+        for(size_t position = start; position < end; ++span)
+        {
+            size_t offset = position - spanStarts[span];
+            size_t count = std::min(spans[span].Size - offset, end - position);
+            memcpy(o_Buffer.data() + (position - start), spans[span].Data + offset, count);
+            position += count;
+        }
+        return o_Buffer.data();
+    }
+
+    RegexSearch::RegexSearch()
+    {
+        m_Text = nullptr;
+        m_Lines = nullptr;
+        m_Task = Scheduler::NO_TASK;
+        m_Phase = SearchPhase::IDLE;
+        m_Changed = false;
+        m_CopyPosition = 0;
+        m_NextChunk = 0;
+        m_UnindexedBytes = 0;
+    }
+
+    RegexSearch::~RegexSearch()
+    {
+        Clear();
+    }
+
+    void RegexSearch::SetQuery(const TextBuffer& text, const LineIndex& lines, const std::string& pattern)
+    {
+        if(pattern.empty())
+        {
+            Clear();
+            return;
+        }
+        if(&text == m_Text && pattern == m_Query)
+            return;
+
+        // The old workers stop after the chunk they're on, the snapshot
+        // stays valid until then.
+        Cancel(false);
+        m_Text = &text;
+        m_Lines = &lines;
+        m_Query = pattern;
+        m_Changed |= !m_Matches.empty();
+        m_Matches.clear();
+        m_Error.clear();
+        if(!m_Regex.Compile(pattern, &m_Error))
+        {
+            m_Phase = SearchPhase::IDLE;
+            m_Changed = true;
+            return;
+        }
+        m_Phase = text.HasStableSpans() ? SearchPhase::STARTING : SearchPhase::COPYING;
+        m_CopyPosition = 0;
+        StartTask();
+    }
+
+    void RegexSearch::Clear()
+    {
+        Cancel(true);
+        Scheduler::Cancel(m_Task);
+        m_Task = Scheduler::NO_TASK;
+        m_Text = nullptr;
+        m_Lines = nullptr;
+        m_Query.clear();
+        m_Error.clear();
+        m_Changed |= !m_Matches.empty();
+        m_Matches.clear();
+        m_Phase = SearchPhase::IDLE;
+    }
+
+    void RegexSearch::OnInsert(size_t position, size_t count)
+    {
+        if(!m_Text || !m_Error.empty())
+            return;
+        if(m_Phase == SearchPhase::COPYING || m_Phase == SearchPhase::STARTING)
+        {
+            Restart();
+            return;
+        }
+
+        auto from = std::lower_bound(m_Matches.begin(), m_Matches.end(), position,
+                                     [](const RegexMatch& match, size_t value) { return match.Start < value; });
+        for(auto it = from; it != m_Matches.end(); ++it)
+        {
+            it->Start += count;
+            it->End += count;
+        }
+        if(m_Job)
+        {
+            m_Edits.push_back({ position, count, true });
+            for(RegexMatch& range : m_Searched)
+            {
+                if(range.Start >= position)
+                    range.Start += count;
+                if(range.End > position)
+                    range.End += count;
+            }
+        }
+        SearchLines(position, position + count);
+    }
+
+    void RegexSearch::OnErase(size_t position, size_t count)
+    {
+        if(!m_Text || !m_Error.empty())
+            return;
+        if(m_Phase == SearchPhase::COPYING || m_Phase == SearchPhase::STARTING)
+        {
+            Restart();
+            return;
+        }
+
+        auto byStart = [](const RegexMatch& match, size_t value) { return match.Start < value; };
+        auto from = std::lower_bound(m_Matches.begin(), m_Matches.end(), position, byStart);
+        auto to = std::lower_bound(from, m_Matches.end(), position + count, byStart);
+        m_Changed |= from != to;
+        for(auto it = to; it != m_Matches.end(); ++it)
+        {
+            it->Start -= count;
+            it->End -= count;
+        }
+        m_Matches.erase(from, to);
+        if(m_Job)
+        {
+            m_Edits.push_back({ position, count, false });
+            for(RegexMatch& range : m_Searched)
+            {
+                range.Start = range.Start > position + count ? range.Start - count : std::min(range.Start, position);
+                range.End = range.End > position + count ? range.End - count : std::min(range.End, position);
+            }
+        }
+        SearchLines(position, position);
+    }
+
+    void RegexSearch::Restart()
+    {
+        // Nothing has been found yet, only a copy of the text is out of date.
+        if(m_Phase == SearchPhase::STARTING && !m_Text->HasStableSpans())
+            m_Phase = SearchPhase::COPYING;
+        m_CopyPosition = 0;
+    }
+
+    bool RegexSearch::Update()
+    {
+        bool changed = m_Changed;
+        m_Changed = false;
+        return changed;
+    }
+
+    size_t RegexSearch::FindNext(size_t position) const
+    {
+        return std::lower_bound(m_Matches.begin(), m_Matches.end(), position,
+                                [](const RegexMatch& match, size_t value) { return match.Start < value; })
+            - m_Matches.begin();
+    }
+
+    size_t RegexSearch::FindPrevious(size_t position) const
+    {
+        size_t index = FindNext(position);
+        return index ? index - 1 : m_Matches.size();
+    }
+
+    size_t RegexSearch::FindOverlapping(size_t position) const
+    {
+        // Matches never overlap, so their ends are sorted as well.
+        return std::upper_bound(m_Matches.begin(), m_Matches.end(), position,
+                                [](size_t value, const RegexMatch& match) { return value < match.End; })
+            - m_Matches.begin();
+    }
+
+    void RegexSearch::Cancel(bool wait)
+    {
+        if(m_Job)
+        {
+            m_Job->Cancelled = true;
+            m_Stopping.push_back(std::move(m_Job));
+        }
+        m_Edits.clear();
+        m_Searched.clear();
+
+        // Workers still reading the text are waited for on Clear() only.
+        size_t kept = 0;
+        for(std::shared_ptr<Job>& job : m_Stopping)
+        {
+            std::unique_lock<std::mutex> lock(job->Lock);
+            if(wait)
+                job->Stopped.wait(lock, [&job]() { return job->Running == 0; });
+            if(job->Running != 0)
+                m_Stopping[kept++].swap(job);
+        }
+        m_Stopping.resize(kept);
+    }
+
+    void RegexSearch::StartTask()
+    {
+        if(m_Task == Scheduler::NO_TASK)
+            m_Task = Scheduler::Post([this](Scheduler::Clock::time_point deadline) { return Search(deadline); });
+    }
+
+    TaskStatus RegexSearch::Search(Scheduler::Clock::time_point deadline)
+    {
+        if(m_Phase == SearchPhase::COPYING && !Copy(deadline))
+            return TaskStatus::YIELDED;
+        if(m_Phase == SearchPhase::STARTING)
+        {
+            // Chunks are cut at line starts, only ones that are known will do.
+            if(m_UnindexedBytes != 0)
+                return TaskStatus::BLOCKED;
+            StartJob();
+        }
+        if(m_Phase == SearchPhase::SEARCHING && !Merge(deadline))
+            return Scheduler::Clock::now() >= deadline ? TaskStatus::YIELDED : TaskStatus::BLOCKED;
+        m_Task = Scheduler::NO_TASK;
+        return TaskStatus::DONE;
+    }
+
+    bool RegexSearch::Copy(Scheduler::Clock::time_point deadline)
+    {
+        const TextBuffer& text = *m_Text;
+        if(m_CopyPosition == 0)
+        {
+            m_Job = std::make_shared<Job>();
+            m_Job->Copy.reset(new char[text.Size() + 1]);
+        }
+        while(m_CopyPosition < text.Size())
+        {
+            size_t count = std::min(text.Size() - m_CopyPosition, COPY_SLICE_SIZE);
+            m_CopyPosition += text.Read(m_CopyPosition, count, m_Job->Copy.get() + m_CopyPosition);
+            if(m_CopyPosition < text.Size() && Scheduler::Clock::now() >= deadline)
+                return false;
+        }
+        m_Job->Spans.push_back({ m_Job->Copy.get(), text.Size() });
+        m_Phase = SearchPhase::STARTING;
+        return true;
+    }
+
+    void RegexSearch::StartJob()
+    {
+        const TextBuffer& text = *m_Text;
+        const LineIndex& lines = *m_Lines;
+        if(!m_Job)
+        {
+            m_Job = std::make_shared<Job>();
+            for(size_t position = 0; position < text.Size(); )
+            {
+                TextSpan span = text.SpanAt(position);
+                m_Job->Spans.push_back(span);
+                position += span.Size;
+            }
+        }
+        if(text.Size() == 0)
+        {
+            m_Job.reset();
+            m_Phase = SearchPhase::IDLE;
+            return;
+        }
+
+        Job& job = *m_Job;
+        size_t start = 0;
+        for(const TextSpan& span : job.Spans)
+        {
+            job.SpanStarts.push_back(start);
+            start += span.Size;
+        }
+
+        job.ChunkStarts.push_back(0);
+        for(size_t target = CHUNK_SIZE; target < text.Size(); target += CHUNK_SIZE)
+        {
+            size_t lineStart = lines.GetLineStart(lines.GetLineOf(target));
+            if(lineStart > job.ChunkStarts.back())
+                job.ChunkStarts.push_back(lineStart);
+        }
+        job.ChunkStarts.push_back(text.Size());
+        job.Pattern = m_Regex;
+        job.Results.resize(job.ChunkStarts.size() - 1);
+        job.Done.resize(job.ChunkStarts.size() - 1, 0);
+
+        size_t workers = std::min(WorkerPool::GetThreadCount(), job.Results.size());
+        for(size_t i = 0; i < workers; ++i)
+        {
+            std::shared_ptr<Job> shared = m_Job;
+            WorkerPool::Submit([shared]() { SearchChunks(shared); });
+        }
+        m_NextChunk = 0;
+        m_Phase = SearchPhase::SEARCHING;
+    }
+
+    void RegexSearch::SearchChunks(std::shared_ptr<Job> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(job->Lock);
+            if(job->Cancelled)
+                return;
+            ++job->Running;
+        }
+        // The DFA is built as it goes, every worker needs its own.
+        Regex pattern = job->Pattern;
+        std::vector<char> buffer;
+        std::vector<RegexMatch> found;
+        size_t chunkCount = job->Results.size();
+        while(!job->Cancelled.load(std::memory_order_relaxed))
+        {
+            size_t chunk = job->NextChunk++;
+            if(chunk >= chunkCount)
+                break;
+            size_t start = job->ChunkStarts[chunk];
+            size_t end = job->ChunkStarts[chunk + 1];
+            const char* data = ReadSnapshot(job->Spans, job->SpanStarts, start, end, buffer);
+            found.clear();
+            pattern.FindAll(data, end - start, start, found);
+            {
+                std::lock_guard<std::mutex> lock(job->Lock);
+                job->Results[chunk].swap(found);
+                job->Done[chunk] = 1;
+            }
+            Editor::Wake();
+        }
+        {
+            std::lock_guard<std::mutex> lock(job->Lock);
+            --job->Running;
+        }
+        job->Stopped.notify_all();
+    }
+
+    bool RegexSearch::Merge(Scheduler::Clock::time_point deadline)
+    {
+        Job& job = *m_Job;
+        auto byStart = [](const RegexMatch& a, const RegexMatch& b) { return a.Start < b.Start; };
+        while(m_NextChunk < job.Results.size())
+        {
+            {
+                std::lock_guard<std::mutex> lock(job.Lock);
+                if(!job.Done[m_NextChunk])
+                    return false;
+                m_Found.swap(job.Results[m_NextChunk]);
+                std::vector<RegexMatch>().swap(job.Results[m_NextChunk]);
+            }
+            ++m_NextChunk;
+
+            size_t kept = 0;
+            for(RegexMatch match : m_Found)
+            {
+                if(MapMatch(match))
+                    m_Found[kept++] = match;
+            }
+            m_Found.resize(kept);
+            if(kept)
+            {
+                // Only lines searched again can have matches past these.
+                size_t middle = m_Matches.size();
+                m_Matches.insert(m_Matches.end(), m_Found.begin(), m_Found.end());
+                auto first = std::upper_bound(m_Matches.begin(), m_Matches.begin() + middle, m_Found.front(), byStart);
+                std::inplace_merge(first, m_Matches.begin() + middle, m_Matches.end(), byStart);
+                m_Changed = true;
+            }
+            if(m_NextChunk < job.Results.size() && Scheduler::Clock::now() >= deadline)
+                return false;
+        }
+
+        m_Job.reset();
+        m_Edits.clear();
+        m_Searched.clear();
+        m_Phase = SearchPhase::IDLE;
+        m_Changed = true;
+        return true;
+    }
+
+    bool RegexSearch::MapMatch(RegexMatch& match) const
+    {
+        for(const Edit& edit : m_Edits)
+        {
+            if(edit.Inserted)
+            {
+                if(match.Start >= edit.Position)
+                {
+                    match.Start += edit.Count;
+                    match.End += edit.Count;
+                }
+                else if(match.End > edit.Position)
+                    return false;
+            }
+            else
+            {
+                if(match.Start >= edit.Position + edit.Count)
+                {
+                    match.Start -= edit.Count;
+                    match.End -= edit.Count;
+                }
+                else if(match.End > edit.Position)
+                    return false;
+            }
+        }
+        // Matches in lines that were searched again are already in.
+        auto range = std::upper_bound(m_Searched.begin(), m_Searched.end(), match.Start,
+                                      [](size_t value, const RegexMatch& searched) { return value < searched.End; });
+        return range == m_Searched.end() || range->Start >= match.End;
+    }
+
+    void RegexSearch::SearchLines(size_t start, size_t end)
+    {
+        const LineIndex& lines = *m_Lines;
+        size_t from = lines.GetLineStart(lines.GetLineOf(start));
+        size_t endLine = lines.GetLineOf(end);
+        size_t to = endLine + 1 < lines.GetLineCount() ? lines.GetLineStart(endLine + 1) : m_Text->Size();
+
+        auto byStart = [](const RegexMatch& match, size_t value) { return match.Start < value; };
+        auto first = std::lower_bound(m_Matches.begin(), m_Matches.end(), from, byStart);
+        auto last = std::lower_bound(first, m_Matches.end(), to, byStart);
+        m_Changed |= first != last;
+        size_t index = m_Matches.erase(first, last) - m_Matches.begin();
+
+        m_Line.resize(to - from);
+        m_Text->Read(from, m_Line.size(), m_Line.data());
+        m_Found.clear();
+        m_Regex.FindAll(m_Line.data(), m_Line.size(), from, m_Found);
+        m_Matches.insert(m_Matches.begin() + index, m_Found.begin(), m_Found.end());
+        m_Changed |= !m_Found.empty();
+
+        if(!m_Job)
+            return;
+        // Kept sorted and apart, the new range swallows those it touches.
+        auto byEnd = [](const RegexMatch& range, size_t value) { return range.End < value; };
+        auto merged = std::lower_bound(m_Searched.begin(), m_Searched.end(), from, byEnd);
+        auto mergedEnd = merged;
+        RegexMatch range = { from, to };
+        for(; mergedEnd != m_Searched.end() && mergedEnd->Start <= to; ++mergedEnd)
+        {
+            range.Start = std::min(range.Start, mergedEnd->Start);
+            range.End = std::max(range.End, mergedEnd->End);
+        }
+        size_t at = m_Searched.erase(merged, mergedEnd) - m_Searched.begin();
+        m_Searched.insert(m_Searched.begin() + at, range);
+    }
+}
@@ -0,0 +1,200 @@
+#ifndef _DCE_SEARCH_H
+#define _DCE_SEARCH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Core.h"
+#include "LineIndex.h"
+#include "Regex.h"
+#include "Scheduler.h"
+#include "TextBuffer.h"
+
+namespace dce
+{
+    // Finds every occurrence of a literal query in a buffer, overlapping ones
+    // included. The text is scanned span by span, which is the two sides of
+    // the gap for a gap buffer, by a Scheduler task a slice at a time. A
+    // query that extends the previous one only narrows down its matches
+    // instead of scanning again. Matches are kept sorted by position, so the
+    // ones in a range or next to a position are found in O(log n).
+    class TextSearch
+    {
+    public:
+        TextSearch();
+        TextSearch(const TextSearch&) = delete;
+        ~TextSearch();
+
+        // An empty query drops every match.
+        void SetQuery(const TextBuffer& text, const std::string& query);
+        void Clear();
+        // Both go after the text buffer changed, matches the edit broke are
+        // dropped and the text around it is searched again.
+        void OnInsert(size_t position, size_t count);
+        void OnErase(size_t position, size_t count);
+        // Whether matches were found or dropped since the last call.
+        bool Update();
+
+        // Index of the first match starting at or after position, which is
+        // GetMatchCount() if there is none.
+        size_t FindNext(size_t position) const;
+        // Index of the last match starting before position, GetMatchCount()
+        // if there is none.
+        size_t FindPrevious(size_t position) const;
+        // Index of the first match that ends after position.
+        size_t FindOverlapping(size_t position) const;
+        inline size_t GetMatch(size_t index) const { return m_Matches[index]; }
+        // Matches of a shorter query stay up while a longer one narrows them
+        // down, they end where that one did.
+        inline size_t GetMatchEnd(size_t index) const { return m_Matches[index] + m_MatchedLength; }
+        inline size_t GetMatchCount() const { return m_Matches.size(); }
+        inline const std::string& GetQuery() const { return m_Query; }
+        // Matches can still be missing while this is true.
+        inline bool IsSearching() const { return m_Phase != SearchPhase::IDLE; }
+    public:
+        // Bytes scanned between checks of the deadline.
+        static constexpr size_t SEARCH_SLICE_SIZE = 0x100000ul;
+        // Matches checked against a longer query between checks of the deadline.
+        static constexpr size_t NARROW_SLICE_SIZE = 0x400ul;
+    private:
+        enum class SearchPhase : uint8_t
+        {
+            IDLE,
+            NARROWING,
+            SCANNING
+        };
+
+        void Restart();
+        void StartTask();
+        TaskStatus Search(Scheduler::Clock::time_point deadline);
+        bool Narrow(Scheduler::Clock::time_point deadline);
+        bool Scan(Scheduler::Clock::time_point deadline);
+        // Appends the matches starting from start up to end.
+        void FindIn(size_t start, size_t end, std::vector<size_t>& o_Matches);
+    private:
+        const TextBuffer* m_Text;
+        std::string m_Query;
+        std::vector<size_t> m_Matches;
+        Scheduler::TaskID m_Task;
+        SearchPhase m_Phase;
+        bool m_Changed;
+        // Every match is known to start with this much of the query.
+        size_t m_MatchedLength;
+        // Matches before m_NarrowKept are checked, the ones from m_NarrowNext
+        // on are still to be.
+        size_t m_NarrowKept;
+        size_t m_NarrowNext;
+        // Everything before it has been scanned.
+        size_t m_ScanPosition;
+        std::vector<char> m_Window;
+        std::vector<size_t> m_Found;
+    };
+
+    // Finds the matches of a regular expression in a snapshot of a buffer,
+    // split into chunks of whole lines that the threads of the WorkerPool
+    // take turns at. Results are picked up by a Scheduler task in the order
+    // of the chunks, so they show up front to back. A piece tree's spans
+    // stay valid through edits and are read as they are, a gap buffer is
+    // copied a slice at a time first. Edits made in the meantime are applied
+    // to the results as they come in, the lines they touched are searched
+    // again right away.
+    class RegexSearch
+    {
+    public:
+        RegexSearch();
+        RegexSearch(const RegexSearch&) = delete;
+        ~RegexSearch();
+
+        // An empty pattern drops every match, one that doesn't compile
+        // leaves an error instead.
+        void SetQuery(const TextBuffer& text, const LineIndex& lines, const std::string& pattern);
+        // Waits for the workers to let go of the text, needs to happen
+        // before the text buffer gets cleared or destroyed.
+        void Clear();
+        // Both go after the text buffer and the line index changed.
+        void OnInsert(size_t position, size_t count);
+        void OnErase(size_t position, size_t count);
+        // Whether matches were found or dropped since the last call.
+        bool Update();
+        // Searching waits for the line index to reach the end of the text.
+        inline void SetUnindexedBytes(size_t count) { m_UnindexedBytes = count; }
+
+        size_t FindNext(size_t position) const;
+        size_t FindPrevious(size_t position) const;
+        size_t FindOverlapping(size_t position) const;
+        inline size_t GetMatch(size_t index) const { return m_Matches[index].Start; }
+        inline size_t GetMatchEnd(size_t index) const { return m_Matches[index].End; }
+        inline size_t GetMatchCount() const { return m_Matches.size(); }
+        inline const std::string& GetQuery() const { return m_Query; }
+        // Why the pattern didn't compile, empty if it did.
+        inline const std::string& GetError() const { return m_Error; }
+        inline bool IsSearching() const { return m_Phase != SearchPhase::IDLE; }
+    public:
+        // Lines are never split, a chunk only gets larger than this if one
+        // of them is.
+        static constexpr size_t CHUNK_SIZE = 0x100000ul;
+        static constexpr size_t COPY_SLICE_SIZE = 0x1000000ul;
+    private:
+        enum class SearchPhase : uint8_t
+        {
+            IDLE,
+            COPYING,    // Gap buffers only.
+            STARTING,   // Waits for the lines to be indexed.
+            SEARCHING
+        };
+
+        struct Edit
+        {
+            size_t Position;
+            size_t Count;
+            bool Inserted;
+        };
+
+        struct Job;
+
+        void Cancel(bool wait);
+        // Starts over when the text changed before the search got going.
+        void Restart();
+        void StartTask();
+        TaskStatus Search(Scheduler::Clock::time_point deadline);
+        bool Copy(Scheduler::Clock::time_point deadline);
+        void StartJob();
+        // Run by the workers, each takes chunks until there are none left.
+        static void SearchChunks(std::shared_ptr<Job> job);
+        // Returns whether every chunk is in.
+        bool Merge(Scheduler::Clock::time_point deadline);
+        // Moves a match found in the snapshot to where it is in the text
+        // now, returns false if an edit got in its way.
+        bool MapMatch(RegexMatch& match) const;
+        // Searches the lines from the one with start in it up to the one
+        // with end in it again.
+        void SearchLines(size_t start, size_t end);
+    private:
+        const TextBuffer* m_Text;
+        const LineIndex* m_Lines;
+        std::string m_Query;
+        std::string m_Error;
+        Regex m_Regex;
+        std::vector<RegexMatch> m_Matches;
+        Scheduler::TaskID m_Task;
+        SearchPhase m_Phase;
+        bool m_Changed;
+
+        std::shared_ptr<Job> m_Job;
+        // Cancelled jobs whose workers haven't stopped yet.
+        std::vector<std::shared_ptr<Job>> m_Stopping;
+        size_t m_CopyPosition;
+        size_t m_NextChunk;
+        size_t m_UnindexedBytes;
+        // Edits since the snapshot, and the ranges of text searched again
+        // because of them, sorted and where they are now.
+        std::vector<Edit> m_Edits;
+        std::vector<RegexMatch> m_Searched;
+
+        std::vector<char> m_Line;
+        std::vector<RegexMatch> m_Found;
+    };
+}
+
+#endif // _DCE_SEARCH_H
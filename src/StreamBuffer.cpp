@@ -0,0 +1,98 @@
+#include <glad/glad.h>
+
+#include "FrameStats.h"
+#include "StreamBuffer.h"
+
+namespace dce
+{
+    StreamBuffer::StreamBuffer()
+    {
+        m_Data = nullptr;
+        for(void*& fence : m_Fences)
+            fence = nullptr;
+        m_RegionSize = 0;
+        m_Region = 0;
+        m_Offset = 0;
+        m_BatchStart = 0;
+        m_RendererID = 0;
+    }
+
+    StreamBuffer::~StreamBuffer()
+    {
+        // The context is gone by the time static buffers are destroyed, so
+        // only the memory of a headless buffer is given back here.
+        if(!m_RendererID)
+            free(m_Data);
+    }
+
+    bool StreamBuffer::Init(size_t regionSize, bool headless)
+    {
+        m_RegionSize = regionSize;
+        m_Region = 0;
+        m_Offset = 0;
+        m_BatchStart = 0;
+        size_t size = regionSize * REGION_COUNT;
+        if(headless)
+        {
+            m_Data = (char*)malloc(size);
+            DCE_ASSURE_OR_EXIT(m_Data, "An error occurred during memory allocation.\n");
+            return true;
+        }
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &m_RendererID);
+        glNamedBufferStorage(m_RendererID, size, nullptr, flags);
+        m_Data = (char*)glMapNamedBufferRange(m_RendererID, 0, size, flags);
+        if(!m_Data)
+        {
+            printf("Unable to map a stream buffer of %lu bytes.\n", size);
+            glDeleteBuffers(1, &m_RendererID);
+            m_RendererID = 0;
+            return false;
+        }
+        return true;
+    }
+
+    void StreamBuffer::Destroy()
+    {
+        if(!m_RendererID)
+            return;
+        for(void*& fence : m_Fences)
+        {
+            if(fence)
+                glDeleteSync((GLsync)fence);
+            fence = nullptr;
+        }
+        glUnmapNamedBuffer(m_RendererID);
+        glDeleteBuffers(1, &m_RendererID);
+        m_RendererID = 0;
+        m_Data = nullptr;
+    }
+
+    void StreamBuffer::NextRegion()
+    {
+        if(m_Offset == 0)
+            return;
+
+        if(m_RendererID)
+        {
+            m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            m_Region = (m_Region + 1) % REGION_COUNT;
+
+            GLsync fence = (GLsync)m_Fences[m_Region];
+            if(fence)
+            {
+                ScopedStageTimer timer(FrameStage::SYNC);
+                GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+                while(glClientWaitSync(fence, waitFlags, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+                    waitFlags = 0;
+                glDeleteSync(fence);
+                m_Fences[m_Region] = nullptr;
+            }
+        }
+        else
+            m_Region = (m_Region + 1) % REGION_COUNT;
+        m_Offset = 0;
+        m_BatchStart = 0;
+    }
+}
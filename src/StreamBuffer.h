@@ -0,0 +1,57 @@
+#ifndef _DCE_STREAM_BUFFER_H
+#define _DCE_STREAM_BUFFER_H
+
+#include "Core.h"
+
+namespace dce
+{
+    // Persistently mapped buffer for data written by the CPU every frame. It
+    // is split into REGION_COUNT regions used round robin, each guarded by a
+    // fence, so the CPU only waits if it catches up with a region the GPU is
+    // still reading. Data is appended to the current region and handed out in
+    // batches, each drawn from GetBatchOffset() before EndBatch().
+    class StreamBuffer
+    {
+    public:
+        StreamBuffer();
+        StreamBuffer(const StreamBuffer&) = delete;
+        ~StreamBuffer();
+
+        // Without a context the regions live in plain memory instead.
+        bool Init(size_t regionSize, bool headless);
+        void Destroy();
+
+        // Returns nullptr if the current region can't fit size more bytes.
+        inline void* Allocate(size_t size)
+        {
+            if(m_Offset + size > m_RegionSize)
+                return nullptr;
+            void* data = m_Data + m_Region * m_RegionSize + m_Offset;
+            m_Offset += size;
+            return data;
+        }
+
+        // Fences the current region and moves on to the next one, waiting
+        // until the GPU is done with it. Needs to be called between frames
+        // and whenever Allocate() fails, with the pending batch drawn.
+        void NextRegion();
+
+        inline size_t GetRemaining() const { return m_RegionSize - m_Offset; }
+        inline size_t GetBatchOffset() const { return m_Region * m_RegionSize + m_BatchStart; }
+        inline size_t GetBatchSize() const { return m_Offset - m_BatchStart; }
+        inline void EndBatch() { m_BatchStart = m_Offset; }
+        inline uint32_t GetRendererID() const { return m_RendererID; }
+    public:
+        static constexpr size_t REGION_COUNT = 3;
+    private:
+        char* m_Data;
+        void* m_Fences[REGION_COUNT];
+        size_t m_RegionSize;
+        size_t m_Region;
+        size_t m_Offset;
+        size_t m_BatchStart;
+        uint32_t m_RendererID;
+    };
+}
+
+#endif // _DCE_STREAM_BUFFER_H
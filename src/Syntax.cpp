@@ -0,0 +1,554 @@
+#include <tree_sitter/api.h>
+
+#include <algorithm>
+#include <cstring>
+#include <regex>
+
+#include "Syntax.h"
+#include "Editor.h"
+#include "MappedFile.h"
+
+extern "C" const TSLanguage* tree_sitter_c(void);
+
+namespace dce
+{
+    // A #match? or #not-match? predicate of a query pattern.
+    struct MatchPredicate
+    {
+        uint32_t CaptureIndex;
+        std::regex Regex;
+        bool Negate;
+    };
+
+    struct Language
+    {
+        const char* Name;
+        const char* Extensions[4];
+        const TSLanguage* (*Get)(void);
+        const char* QueryPath;
+        const LexRules* Rules;
+        // Loaded by the main thread the first time a buffer is highlighted.
+        TSQuery* Query;
+        std::vector<HighlightKind> CaptureKinds;
+        std::vector<std::vector<MatchPredicate>> Predicates; // Of every pattern.
+        bool Loaded;
+    };
+
+    static const char* const C_KEYWORDS[] =
+    {
+        "auto", "break", "case", "const", "continue", "default", "do", "else", "enum", "extern", "for", "goto", "if",
+        "inline", "register", "restrict", "return", "sizeof", "static", "struct", "switch", "typedef", "union",
+        "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Generic", "_Noreturn", "_Static_assert",
+        "_Thread_local", nullptr
+    };
+    static const char* const CPP_KEYWORDS[] =
+    {
+        "alignas", "alignof", "auto", "break", "case", "catch", "class", "co_await", "co_return", "co_yield",
+        "concept", "const", "consteval", "constexpr", "constinit", "const_cast", "continue", "decltype", "default",
+        "delete", "do", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "final", "for", "friend",
+        "goto", "if", "inline", "mutable", "namespace", "new", "noexcept", "operator", "override", "private",
+        "protected", "public", "register", "reinterpret_cast", "requires", "return", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "try",
+        "typedef", "typeid", "typename", "union", "using", "virtual", "volatile", "while", nullptr
+    };
+    static const char* const C_TYPES[] =
+    {
+        "bool", "char", "double", "float", "int", "long", "short", "signed", "unsigned", "void", "wchar_t",
+        "char8_t", "char16_t", "char32_t", "size_t", "ssize_t", "ptrdiff_t", "intptr_t", "uintptr_t", "int8_t",
+        "int16_t", "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t", "_Bool", "FILE", nullptr
+    };
+    static const char* const C_CONSTANTS[] = { "true", "false", "NULL", "nullptr", nullptr };
+    static const char* const JS_KEYWORDS[] =
+    {
+        "async", "await", "break", "case", "catch", "class", "const", "continue", "debugger", "default", "delete",
+        "do", "else", "export", "extends", "finally", "for", "function", "if", "import", "in", "instanceof", "let",
+        "new", "of", "return", "static", "super", "switch", "this", "throw", "try", "typeof", "var", "void",
+        "while", "with", "yield", nullptr
+    };
+    static const char* const JS_CONSTANTS[] = { "true", "false", "null", "undefined", "NaN", "Infinity", nullptr };
+    static const char* const LOG_KEYWORDS[] =
+    {
+        "TRACE", "DEBUG", "INFO", "NOTICE", "WARN", "WARNING", "ERROR", "FATAL", "CRITICAL", nullptr
+    };
+
+    static const LexRules C_RULES =
+    {
+        "//", "/*", "*/", "\"'", nullptr, "+-*/%=<>!&|^~?:", "()[]{};,.", C_KEYWORDS, C_TYPES, C_CONSTANTS, true, true
+    };
+    static const LexRules CPP_RULES =
+    {
+        "//", "/*", "*/", "\"'", nullptr, "+-*/%=<>!&|^~?:", "()[]{};,.", CPP_KEYWORDS, C_TYPES, C_CONSTANTS, true, true
+    };
+    static const LexRules JS_RULES =
+    {
+        "//", "/*", "*/", "\"'`", "`", "+-*/%=<>!&|^~?:", "()[]{};,.", JS_KEYWORDS, nullptr, JS_CONSTANTS, false, true
+    };
+    static const LexRules JSON_RULES =
+    {
+        nullptr, nullptr, nullptr, "\"", nullptr, nullptr, "{}[],:", nullptr, nullptr, JS_CONSTANTS, false, false
+    };
+    static const LexRules LOG_RULES =
+    {
+        nullptr, nullptr, nullptr, "\"", nullptr, "=", "[]()", LOG_KEYWORDS, nullptr, nullptr, false, false
+    };
+
+    static Language s_Languages[] =
+    {
+        { "C", { ".c", ".h" }, tree_sitter_c, "dependencies/tree-sitter-c/queries/highlights.scm", &C_RULES, nullptr, {}, {}, false },
+        { "C++", { ".cpp", ".hpp", ".cc", ".hh" }, nullptr, nullptr, &CPP_RULES, nullptr, {}, {}, false },
+        { "JavaScript", { ".js", ".mjs" }, nullptr, nullptr, &JS_RULES, nullptr, {}, {}, false },
+        { "JSON", { ".json" }, nullptr, nullptr, &JSON_RULES, nullptr, {}, {}, false },
+        { "Log", { ".log" }, nullptr, nullptr, &LOG_RULES, nullptr, {}, {}, false }
+    };
+    static constexpr size_t LANGUAGE_CNT = sizeof(s_Languages) / sizeof(s_Languages[0]);
+    static constexpr size_t NO_LANGUAGE = SIZE_MAX;
+    // Text of longer nodes never matches a predicate.
+    static constexpr size_t MAX_PREDICATE_TEXT = 256;
+
+    // Captures are named like "function.special", only the part before the
+    // first dot picks the kind.
+    static HighlightKind GetCaptureKind(const char* name, uint32_t length)
+    {
+        static const struct { const char* Name; HighlightKind Kind; } KINDS[] =
+        {
+            { "keyword", HighlightKind::KEYWORD },
+            { "operator", HighlightKind::OPERATOR },
+            { "delimiter", HighlightKind::DELIMITER },
+            { "string", HighlightKind::STRING },
+            { "number", HighlightKind::NUMBER },
+            { "constant", HighlightKind::CONSTANT },
+            { "type", HighlightKind::TYPE },
+            { "function", HighlightKind::FUNCTION },
+            { "property", HighlightKind::PROPERTY },
+            { "label", HighlightKind::LABEL },
+            { "comment", HighlightKind::COMMENT }
+        };
+        const char* dot = (const char*)memchr(name, '.', length);
+        size_t baseLength = dot ? (size_t)(dot - name) : length;
+        for(const auto& kind : KINDS)
+        {
+            if(strlen(kind.Name) == baseLength && memcmp(kind.Name, name, baseLength) == 0)
+                return kind.Kind;
+        }
+        return HighlightKind::NONE;
+    }
+
+    static bool LoadQuery(Language& language)
+    {
+        if(language.Loaded)
+            return language.Query != nullptr;
+        language.Loaded = true;
+
+        MappedFile file;
+        if(!file.Open(language.QueryPath))
+        {
+            printf("Unable to open highlight query \'%s\', %s files are only lexed.\n", language.QueryPath, language.Name);
+            return false;
+        }
+        uint32_t errorOffset;
+        TSQueryError error;
+        language.Query = ts_query_new(language.Get(), file.Data(), (uint32_t)file.Size(), &errorOffset, &error);
+        if(!language.Query)
+        {
+            printf("Error %d at byte %u of highlight query \'%s\'.\n", (int)error, errorOffset, language.QueryPath);
+            return false;
+        }
+
+        uint32_t captureCount = ts_query_capture_count(language.Query);
+        for(uint32_t i = 0; i < captureCount; ++i)
+        {
+            uint32_t length;
+            const char* name = ts_query_capture_name_for_id(language.Query, i, &length);
+            language.CaptureKinds.push_back(GetCaptureKind(name, length));
+        }
+
+        // Steps come as the predicate's name, its arguments and a terminator.
+        uint32_t patternCount = ts_query_pattern_count(language.Query);
+        language.Predicates.resize(patternCount);
+        for(uint32_t pattern = 0; pattern < patternCount; ++pattern)
+        {
+            uint32_t stepCount;
+            const TSQueryPredicateStep* steps = ts_query_predicates_for_pattern(language.Query, pattern, &stepCount);
+            for(uint32_t i = 0; i < stepCount; ++i)
+            {
+                uint32_t end = i;
+                while(steps[end].type != TSQueryPredicateStepTypeDone)
+                    ++end;
+                uint32_t length;
+                const char* name = ts_query_string_value_for_id(language.Query, steps[i].value_id, &length);
+                std::string predicate(name, length);
+                bool isMatch = predicate == "match?" || predicate == "not-match?";
+                if(isMatch && end - i == 3 && steps[i + 1].type == TSQueryPredicateStepTypeCapture &&
+                   steps[i + 2].type == TSQueryPredicateStepTypeString)
+                {
+                    const char* regex = ts_query_string_value_for_id(language.Query, steps[i + 2].value_id, &length);
+                    language.Predicates[pattern].push_back({ steps[i + 1].value_id, std::regex(regex, length),
+                                                             predicate[0] == 'n' });
+                }
+                else
+                    printf("Ignoring unsupported predicate #%s in highlight query \'%s\'.\n", predicate.c_str(), language.QueryPath);
+                i = end;
+            }
+        }
+        return true;
+    }
+
+    static TSPoint GetPoint(const LineIndex& lines, size_t position)
+    {
+        size_t line = lines.GetLineOf(position);
+        return { (uint32_t)line, (uint32_t)(position - lines.GetLineStart(line)) };
+    }
+
+    SyntaxHighlighter::SyntaxHighlighter()
+    {
+        m_Language = nullptr;
+        m_LanguageIndex = NO_LANGUAGE;
+        m_Cancel = 0;
+        m_Parser = nullptr;
+        m_Tree = nullptr;
+        m_Text = nullptr;
+        m_Version = 0;
+        m_ParseRequested = false;
+        m_Stop = false;
+        m_Result = nullptr;
+        m_ResultVersion = 0;
+        m_DisplayTree = nullptr;
+        m_QueryCursor = nullptr;
+        m_AwaitingTree = false;
+    }
+
+    SyntaxHighlighter::~SyntaxHighlighter()
+    {
+        if(m_Worker.joinable())
+        {
+            m_Cancel = 1;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stop = true;
+            }
+            m_Wake.notify_one();
+            m_Worker.join();
+        }
+        Reset();
+        if(m_Parser)
+            ts_parser_delete(m_Parser);
+        if(m_QueryCursor)
+            ts_query_cursor_delete(m_QueryCursor);
+    }
+
+    void SyntaxHighlighter::SetLanguage(const std::string& filepath)
+    {
+        size_t index = NO_LANGUAGE;
+        size_t dot = filepath.find_last_of("./");
+        if(dot != std::string::npos && filepath[dot] == '.')
+        {
+            const char* extension = filepath.c_str() + dot;
+            for(size_t i = 0; i < LANGUAGE_CNT && index == NO_LANGUAGE; ++i)
+            {
+                for(const char* candidate : s_Languages[i].Extensions)
+                {
+                    if(candidate && strcmp(candidate, extension) == 0)
+                        index = i;
+                }
+            }
+        }
+        if(index == m_LanguageIndex)
+            return;
+
+        Reset();
+        m_LanguageIndex = index;
+        m_Language = index == NO_LANGUAGE || !s_Languages[index].Get ? nullptr : s_Languages[index].Get();
+        m_Lexer.SetRules(index == NO_LANGUAGE ? nullptr : s_Languages[index].Rules);
+        if(m_Parser && m_Language)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ts_parser_set_language(m_Parser, m_Language);
+        }
+    }
+
+    void SyntaxHighlighter::Reset()
+    {
+        if(m_Parser)
+        {
+            m_Cancel = 1;
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ts_parser_reset(m_Parser);
+            if(m_Tree)
+                ts_tree_delete(m_Tree);
+            m_Tree = nullptr;
+            m_Text = nullptr;
+            m_ParseRequested = false;
+            ++m_Version;
+            m_Cancel = 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_ResultMutex);
+            if(m_Result)
+                ts_tree_delete(m_Result);
+            m_Result = nullptr;
+        }
+        if(m_DisplayTree)
+            ts_tree_delete(m_DisplayTree);
+        m_DisplayTree = nullptr;
+        m_AwaitingTree = false;
+        m_Lexer.Reset();
+    }
+
+    std::unique_lock<std::mutex> SyntaxHighlighter::Lock()
+    {
+        if(!m_Language)
+            return std::unique_lock<std::mutex>();
+        // Parsing checks the flag every so often and gives up, so the lock
+        // is only ever waited on for a moment.
+        m_Cancel = 1;
+        return std::unique_lock<std::mutex>(m_Mutex);
+    }
+
+    void SyntaxHighlighter::OnInsert(const TextBuffer& text, const LineIndex& lines, size_t position,
+                                     const char* data, size_t count)
+    {
+        m_Lexer.OnInsert(lines, position, data, count);
+        if(!m_Language)
+            return;
+        TSInputEdit edit;
+        edit.start_byte = (uint32_t)position;
+        edit.old_end_byte = (uint32_t)position;
+        edit.new_end_byte = (uint32_t)(position + count);
+        edit.start_point = GetPoint(lines, position);
+        edit.old_end_point = edit.start_point;
+        edit.new_end_point = edit.start_point;
+        for(const char* cur = data, *end = data + count; cur != end;)
+        {
+            const char* newline = (const char*)memchr(cur, '\n', (size_t)(end - cur));
+            if(!newline)
+            {
+                edit.new_end_point.column += (uint32_t)(end - cur);
+                break;
+            }
+            ++edit.new_end_point.row;
+            edit.new_end_point.column = 0;
+            cur = newline + 1;
+        }
+        ApplyEdit(text, edit, text.Size() + count);
+    }
+
+    void SyntaxHighlighter::OnErase(const TextBuffer& text, const LineIndex& lines, size_t position, size_t count)
+    {
+        m_Lexer.OnErase(lines, position, count);
+        if(!m_Language)
+            return;
+        TSInputEdit edit;
+        edit.start_byte = (uint32_t)position;
+        edit.old_end_byte = (uint32_t)(position + count);
+        edit.new_end_byte = (uint32_t)position;
+        edit.start_point = GetPoint(lines, position);
+        edit.old_end_point = GetPoint(lines, position + count);
+        edit.new_end_point = edit.start_point;
+        ApplyEdit(text, edit, text.Size() - count);
+    }
+
+    void SyntaxHighlighter::ApplyEdit(const TextBuffer& text, const TSInputEdit& edit, size_t newSize)
+    {
+        ++m_Version;
+        if(newSize > MAX_TEXT_SIZE || text.Size() > MAX_TEXT_SIZE)
+        {
+            // Parsed again from scratch once the text is small enough.
+            if(m_Tree)
+                ts_tree_delete(m_Tree);
+            if(m_DisplayTree)
+                ts_tree_delete(m_DisplayTree);
+            m_Tree = nullptr;
+            m_DisplayTree = nullptr;
+            m_ParseRequested = false;
+            m_AwaitingTree = false;
+            if(m_Parser)
+                ts_parser_reset(m_Parser);
+            m_Cancel = 0;
+            return;
+        }
+
+        if(m_Tree)
+            ts_tree_edit(m_Tree, &edit);
+        if(m_DisplayTree)
+            ts_tree_edit(m_DisplayTree, &edit);
+        StartWorker();
+        m_Text = &text;
+        m_ParseRequested = true;
+        m_AwaitingTree = true;
+        m_Cancel = 0;
+        m_Wake.notify_one();
+    }
+
+    void SyntaxHighlighter::OnTextMoved()
+    {
+        if(!m_Language)
+            return;
+        m_Cancel = 0;
+        if(!m_AwaitingTree)
+            return;
+        m_ParseRequested = true;
+        m_Wake.notify_one();
+    }
+
+    bool SyntaxHighlighter::Update()
+    {
+        bool relexed = m_Lexer.Update();
+        if(!m_AwaitingTree)
+            return relexed;
+        TSTree* result;
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(m_ResultMutex);
+            result = m_Result;
+            version = m_ResultVersion;
+            m_Result = nullptr;
+        }
+        if(!result)
+            return relexed;
+        // Edited since, the tree for the current text is still to come.
+        if(version != m_Version)
+        {
+            ts_tree_delete(result);
+            return relexed;
+        }
+        if(m_DisplayTree)
+            ts_tree_delete(m_DisplayTree);
+        m_DisplayTree = result;
+        m_AwaitingTree = false;
+        return true;
+    }
+
+    const HighlightKind* SyntaxHighlighter::Highlight(const TextBuffer& text, LineIndex& lines, size_t start, size_t size)
+    {
+        if(!m_Language || text.Size() > MAX_TEXT_SIZE)
+            return m_Lexer.Highlight(text, lines, start, size);
+        Language& language = s_Languages[m_LanguageIndex];
+        if(!LoadQuery(language))
+            return m_Lexer.Highlight(text, lines, start, size);
+        if(!m_DisplayTree)
+        {
+            if(!m_AwaitingTree)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                StartWorker();
+                m_Text = &text;
+                m_ParseRequested = true;
+                m_AwaitingTree = true;
+                m_Wake.notify_one();
+            }
+            return nullptr;
+        }
+
+        if(!m_QueryCursor)
+            m_QueryCursor = ts_query_cursor_new();
+        m_Kinds.assign(size, HighlightKind::NONE);
+        const size_t end = start + size;
+        ts_query_cursor_set_byte_range(m_QueryCursor, (uint32_t)start, (uint32_t)end);
+        ts_query_cursor_exec(m_QueryCursor, language.Query, ts_tree_root_node(m_DisplayTree));
+
+        // Captures come ordered by where their nodes start, nested ones after
+        // the nodes around them. A node captured by several patterns gets
+        // the kind of the last one, later patterns being the more specific.
+        TSQueryMatch match;
+        uint32_t captureIndex;
+        uint32_t lastStart = UINT32_MAX, lastEnd = 0, lastPattern = 0;
+        while(ts_query_cursor_next_capture(m_QueryCursor, &match, &captureIndex))
+        {
+            const TSQueryCapture& capture = match.captures[captureIndex];
+            uint32_t nodeStart = ts_node_start_byte(capture.node);
+            uint32_t nodeEnd = ts_node_end_byte(capture.node);
+            if(nodeStart == lastStart && nodeEnd == lastEnd && match.pattern_index < lastPattern)
+                continue;
+
+            bool matches = true;
+            for(const MatchPredicate& predicate : language.Predicates[match.pattern_index])
+            {
+                for(uint16_t i = 0; i < match.capture_count && matches; ++i)
+                {
+                    if(match.captures[i].index != predicate.CaptureIndex)
+                        continue;
+                    uint32_t textStart = ts_node_start_byte(match.captures[i].node);
+                    uint32_t textEnd = ts_node_end_byte(match.captures[i].node);
+                    bool found = false;
+                    if(textEnd - textStart <= MAX_PREDICATE_TEXT && textEnd <= text.Size())
+                    {
+                        m_NodeText.resize(textEnd - textStart);
+                        text.Read(textStart, m_NodeText.size(), &m_NodeText[0]);
+                        found = std::regex_search(m_NodeText, predicate.Regex);
+                    }
+                    matches = found != predicate.Negate;
+                }
+            }
+            if(!matches)
+                continue;
+
+            lastStart = nodeStart;
+            lastEnd = nodeEnd;
+            lastPattern = match.pattern_index;
+            size_t from = std::max((size_t)nodeStart, start), to = std::min((size_t)nodeEnd, end);
+            if(from < to)
+                std::fill(m_Kinds.begin() + (from - start), m_Kinds.begin() + (to - start), language.CaptureKinds[capture.index]);
+        }
+        return m_Kinds.data();
+    }
+
+    void SyntaxHighlighter::StartWorker()
+    {
+        if(m_Worker.joinable())
+            return;
+        m_Parser = ts_parser_new();
+        ts_parser_set_language(m_Parser, m_Language);
+        static_assert(sizeof(std::atomic<size_t>) == sizeof(size_t), "The cancellation flag is read as a size_t.");
+        ts_parser_set_cancellation_flag(m_Parser, (const size_t*)&m_Cancel);
+        m_Worker = std::thread(&SyntaxHighlighter::ParseAsync, this);
+    }
+
+    void SyntaxHighlighter::ParseAsync()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while(true)
+        {
+            // An edit that's about to take the lock is let through first.
+            m_Wake.wait(lock, [this]() { return m_Stop || (m_ParseRequested && m_Cancel == 0); });
+            if(m_Stop)
+                return;
+            m_ParseRequested = false;
+
+            TSInput input = { this, ReadText, TSInputEncodingUTF8 };
+            TSTree* tree = ts_parser_parse(m_Parser, m_Tree, input);
+            if(!tree)
+            {
+                // Cancelled by an edit, which asks for another parse of the
+                // text as it is afterwards.
+                ts_parser_reset(m_Parser);
+                continue;
+            }
+            if(m_Tree)
+                ts_tree_delete(m_Tree);
+            m_Tree = tree;
+
+            // Published without holding up the next edit.
+            TSTree* result = ts_tree_copy(tree);
+            uint64_t version = m_Version;
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> resultLock(m_ResultMutex);
+                if(m_Result)
+                    ts_tree_delete(m_Result);
+                m_Result = result;
+                m_ResultVersion = version;
+            }
+            Editor::Wake();
+            lock.lock();
+        }
+    }
+
+    const char* SyntaxHighlighter::ReadText(void* payload, uint32_t byteIndex, TSPoint position, uint32_t* o_BytesRead)
+    {
+        (void)position;
+        const TextBuffer* text = ((const SyntaxHighlighter*)payload)->m_Text;
+        TextSpan span = byteIndex < text->Size() ? text->SpanAt(byteIndex) : TextSpan{ nullptr, 0 };
+        *o_BytesRead = (uint32_t)span.Size;
+        return span.Size ? span.Data : "";
+    }
+}
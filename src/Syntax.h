@@ -0,0 +1,120 @@
+#ifndef _DCE_SYNTAX_H
+#define _DCE_SYNTAX_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Core.h"
+#include "Lexer.h"
+#include "LineIndex.h"
+#include "TextBuffer.h"
+
+struct TSInputEdit;
+struct TSLanguage;
+struct TSParser;
+struct TSPoint;
+struct TSTree;
+struct TSQueryCursor;
+
+namespace dce
+{
+    enum class HighlightKind : uint8_t
+    {
+        NONE,
+        KEYWORD,
+        OPERATOR,
+        DELIMITER,
+        STRING,
+        NUMBER,
+        CONSTANT,
+        TYPE,
+        FUNCTION,
+        PROPERTY,
+        LABEL,
+        COMMENT,
+        MATCH,      // Search matches, drawn over whatever the syntax says.
+        COUNT
+    };
+
+    // Keeps a tree-sitter syntax tree of a buffer up to date. Parsing happens
+    // on a worker thread of its own that reads the text buffer's spans
+    // directly, so edits have to lock the highlighter while they change the
+    // text, which cancels a parse that's in progress. Every edit is applied to
+    // the trees right away and the worker only reparses what it touched.
+    // Until the new tree is in, highlights come from the old one with the
+    // edits applied, which only shifts them around. Files too large to parse
+    // and languages without a grammar get highlighted by a Lexer instead.
+    class SyntaxHighlighter
+    {
+    public:
+        SyntaxHighlighter();
+        SyntaxHighlighter(const SyntaxHighlighter&) = delete;
+        ~SyntaxHighlighter();
+
+        // Picks the grammar and lexer rules by the file extension, files of
+        // unknown types are left plain.
+        void SetLanguage(const std::string& filepath);
+        // Stops parsing and drops the trees, needs to happen before the text
+        // buffer gets replaced or reloaded.
+        void Reset();
+        // Has to be held from OnInsert() or OnErase() until the text changed.
+        // Doesn't lock anything if there's nothing to highlight.
+        std::unique_lock<std::mutex> Lock();
+        // Both go before the text buffer and the line index are changed.
+        void OnInsert(const TextBuffer& text, const LineIndex& lines, size_t position, const char* data, size_t count);
+        void OnErase(const TextBuffer& text, const LineIndex& lines, size_t position, size_t count);
+        // Goes after the text buffer moved its text without changing it, with
+        // Lock() held since before. A parse that got cancelled starts over.
+        void OnTextMoved();
+        // Picks up the tree of a finished parse, returns whether there was one
+        // or the lexer caught up with lines it had to guess at.
+        bool Update();
+        // Whether a tree is on its way for Update() to pick up.
+        inline bool IsParsing() const { return m_AwaitingTree; }
+        // Kind of every byte from start up to start + size, or nullptr if the
+        // text isn't highlighted (yet).
+        const HighlightKind* Highlight(const TextBuffer& text, LineIndex& lines, size_t start, size_t size);
+    public:
+        // Larger files are only lexed, their trees would take up several
+        // times as much memory as the text.
+        static constexpr size_t MAX_TEXT_SIZE = 0x2000000ul;
+    private:
+        void ApplyEdit(const TextBuffer& text, const TSInputEdit& edit, size_t newSize);
+        void StartWorker();
+        void ParseAsync();
+        static const char* ReadText(void* payload, uint32_t byteIndex, TSPoint position, uint32_t* o_BytesRead);
+    private:
+        const TSLanguage* m_Language;
+        size_t m_LanguageIndex;
+        std::thread m_Worker;
+
+        // Guards everything the worker uses while parsing.
+        std::mutex m_Mutex;
+        std::condition_variable m_Wake;
+        std::atomic<size_t> m_Cancel;
+        TSParser* m_Parser;
+        TSTree* m_Tree;
+        const TextBuffer* m_Text;
+        uint64_t m_Version; // Counts edits, written by the main thread only.
+        bool m_ParseRequested;
+        bool m_Stop;
+
+        std::mutex m_ResultMutex;
+        TSTree* m_Result;
+        uint64_t m_ResultVersion;
+
+        // Only touched by the main thread.
+        TSTree* m_DisplayTree;
+        TSQueryCursor* m_QueryCursor;
+        bool m_AwaitingTree;
+        std::vector<HighlightKind> m_Kinds;
+        std::string m_NodeText;
+        Lexer m_Lexer;
+    };
+}
+
+#endif // _DCE_SYNTAX_H
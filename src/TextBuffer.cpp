@@ -0,0 +1,80 @@
+#include <cstring>
+
+#include "TextBuffer.h"
+#include "PieceTree.h"
+
+namespace dce
+{
+    TextBuffer* TextBuffer::Create(TextBackend backend, size_t ensuredCapacity)
+    {
+        switch(backend)
+        {
+            case TextBackend::GAP_BUFFER:
+                return new GapTextBuffer(ensuredCapacity);
+            case TextBackend::PIECE_TREE:
+                return new PieceTree();
+        }
+        return nullptr;
+    }
+
+    size_t TextBuffer::Read(size_t position, size_t count, char* o_Data) const
+    {
+        size_t read = 0;
+        while(read < count)
+        {
+            TextSpan span = SpanAt(position + read);
+            if(span.Size == 0)
+                break;
+            size_t size = span.Size < count - read ? span.Size : count - read;
+            memcpy(o_Data + read, span.Data, size);
+            read += size;
+        }
+        return read;
+    }
+
+    const char* TextBuffer::GetBackendName(TextBackend backend)
+    {
+        switch(backend)
+        {
+            case TextBackend::GAP_BUFFER:
+                return "Gap Buffer";
+            case TextBackend::PIECE_TREE:
+                return "Piece Tree";
+        }
+        return "Unknown";
+    }
+
+    void GapTextBuffer::Clear()
+    {
+        m_Data.Clear();
+    }
+
+    char* GapTextBuffer::Load(size_t size)
+    {
+        m_Data.Clear();
+        return m_Data.AddUninitialized(size);
+    }
+
+    // The gap is only moved when the buffer is edited, so cursor movement
+    // never has to shift any data around.
+    void GapTextBuffer::Insert(size_t position, const char* data, size_t count)
+    {
+        m_Data.SetGapPosition(position);
+        m_Data.Add(data, count, true);
+    }
+
+    void GapTextBuffer::Erase(size_t position, size_t count)
+    {
+        m_Data.SetGapPosition(position);
+        m_Data.Remove(count, false);
+    }
+
+    TextSpan GapTextBuffer::SpanAt(size_t index) const
+    {
+        if(index >= m_Data.Size())
+            return { nullptr, 0 };
+        if(index < m_Data.GapPos())
+            return { m_Data.Data() + index, m_Data.GapPos() - index };
+        return { m_Data.At(index), m_Data.Size() - index };
+    }
+}
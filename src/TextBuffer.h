@@ -0,0 +1,113 @@
+#ifndef _DCE_TEXT_BUFFER_H
+#define _DCE_TEXT_BUFFER_H
+
+#include "Core.h"
+#include "GapBuffer.h"
+#include "MappedFile.h"
+
+namespace dce
+{
+    // A contiguous run of characters owned by a TextBuffer. Only valid until
+    // the next mutation of the buffer it came from, unless the buffer has
+    // stable spans.
+    struct TextSpan
+    {
+        const char* Data;
+        size_t Size;
+    };
+
+    enum class TextBackend
+    {
+        GAP_BUFFER,
+        PIECE_TREE
+    };
+
+    class TextBuffer
+    {
+    public:
+        virtual ~TextBuffer() = default;
+
+        virtual void Clear() = 0;
+        // Discards the current contents and returns a writable block of 'size'
+        // characters that becomes the new contents of the buffer.
+        virtual char* Load(size_t size) = 0;
+        // Takes ownership of the mapping and uses it as the contents of the
+        // buffer without copying. Returns false, leaving the mapping untouched,
+        // if the backend needs to own its data.
+        virtual bool LoadMapped(MappedFile& file) { (void)file; return false; }
+        virtual void Insert(size_t position, const char* data, size_t count) = 0;
+        virtual void Erase(size_t position, size_t count) = 0;
+        virtual char At(size_t index) const = 0;
+        // Returns the longest contiguous span starting at index, or an empty
+        // span if index is the end of the buffer.
+        virtual TextSpan SpanAt(size_t index) const = 0;
+        virtual size_t Size() const = 0;
+        virtual TextBackend GetBackend() const = 0;
+        // Whether spans stay valid through later edits, until the buffer is
+        // cleared or destroyed, which lets other threads read them while the
+        // buffer keeps changing.
+        virtual bool HasStableSpans() const { return false; }
+        // Gives back memory the buffer holds on to but doesn't need right now.
+        virtual void Trim() {}
+        // Whether Trim() would move the text, which spans read before then
+        // don't survive.
+        virtual bool CanTrim() const { return false; }
+
+        // Copies up to count characters starting at position, returns how many.
+        size_t Read(size_t position, size_t count, char* o_Data) const;
+
+        static TextBuffer* Create(TextBackend backend, size_t ensuredCapacity);
+        static const char* GetBackendName(TextBackend backend);
+    };
+
+    // Sequential reader that only goes through the virtual interface once per
+    // span instead of once per character.
+    class TextReader
+    {
+    public:
+        TextReader(const TextBuffer& buffer, size_t position)
+            : m_Buffer(buffer), m_Position(position), m_Cur(nullptr), m_End(nullptr) {}
+
+        inline char Next()
+        {
+            if(m_Cur == m_End)
+            {
+                TextSpan span = m_Buffer.SpanAt(m_Position);
+                DCE_ASSERT(span.Size, "Attempted to read past the end of the buffer.\n");
+                m_Cur = span.Data;
+                m_End = span.Data + span.Size;
+            }
+            ++m_Position;
+            return *m_Cur++;
+        }
+
+        inline size_t GetPosition() const { return m_Position; }
+        inline bool AtEnd() const { return m_Position >= m_Buffer.Size(); }
+    private:
+        const TextBuffer& m_Buffer;
+        size_t m_Position;
+        const char* m_Cur;
+        const char* m_End;
+    };
+
+    class GapTextBuffer : public TextBuffer
+    {
+    public:
+        GapTextBuffer(size_t ensuredCapacity) : m_Data(ensuredCapacity) {}
+
+        void Clear() override;
+        char* Load(size_t size) override;
+        void Insert(size_t position, const char* data, size_t count) override;
+        void Erase(size_t position, size_t count) override;
+        char At(size_t index) const override { return m_Data[index]; }
+        TextSpan SpanAt(size_t index) const override;
+        size_t Size() const override { return m_Data.Size(); }
+        TextBackend GetBackend() const override { return TextBackend::GAP_BUFFER; }
+        void Trim() override { m_Data.Trim(); }
+        bool CanTrim() const override { return m_Data.CanTrim(); }
+    private:
+        GapBuffer<char, PoolAllocator, ShrinkOnIdle<PageAlignedGrowth>> m_Data;
+    };
+}
+
+#endif // _DCE_TEXT_BUFFER_H
@@ -0,0 +1,288 @@
+#include <cstring>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DCE_SCAN_X86
+#endif
+
+#include "TextScan.h"
+
+namespace dce
+{
+    namespace TextScan
+    {
+        static inline void EmitNewlines(uint32_t mask, size_t base, size_t* last, std::vector<size_t>& o_Lengths)
+        {
+            while(mask)
+            {
+                size_t pos = base + (size_t)__builtin_ctz(mask);
+                o_Lengths.push_back(pos + 1 - *last);
+                *last = pos + 1;
+                mask &= mask - 1;
+            }
+        }
+
+#if !defined(DCE_SCAN_X86) || !defined(__SSE2__)
+        static size_t ScanScalar(const char* data, size_t size, std::vector<size_t>& o_Lengths)
+        {
+            size_t last = 0;
+            const char* end = data + size;
+            const char* cur = data;
+            while((cur = (const char*)memchr(cur, '\n', (size_t)(end - cur))))
+            {
+                size_t pos = (size_t)(cur - data);
+                o_Lengths.push_back(pos + 1 - last);
+                last = pos + 1;
+                ++cur;
+            }
+            return size - last;
+        }
+#endif
+
+#if defined(DCE_SCAN_X86) && defined(__SSE2__)
+        static size_t ScanSSE2(const char* data, size_t size, std::vector<size_t>& o_Lengths)
+        {
+            const __m128i newline = _mm_set1_epi8('\n');
+            size_t last = 0;
+            size_t i = 0;
+            for(; i + 16 <= size; i += 16)
+            {
+                __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+                uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+                EmitNewlines(mask, i, &last, o_Lengths);
+            }
+            for(; i < size; ++i)
+            {
+                if(data[i] == '\n')
+                {
+                    o_Lengths.push_back(i + 1 - last);
+                    last = i + 1;
+                }
+            }
+            return size - last;
+        }
+#endif
+
+#if defined(DCE_SCAN_X86)
+        __attribute__((target("avx2")))
+        static size_t ScanAVX2(const char* data, size_t size, std::vector<size_t>& o_Lengths)
+        {
+            const __m256i newline = _mm256_set1_epi8('\n');
+            size_t last = 0;
+            size_t i = 0;
+            for(; i + 64 <= size; i += 64)
+            {
+                __m256i lo = _mm256_loadu_si256((const __m256i*)(data + i));
+                __m256i hi = _mm256_loadu_si256((const __m256i*)(data + i + 32));
+                uint32_t loMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline));
+                uint32_t hiMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline));
+                EmitNewlines(loMask, i, &last, o_Lengths);
+                EmitNewlines(hiMask, i + 32, &last, o_Lengths);
+            }
+            for(; i < size; ++i)
+            {
+                if(data[i] == '\n')
+                {
+                    o_Lengths.push_back(i + 1 - last);
+                    last = i + 1;
+                }
+            }
+            return size - last;
+        }
+#endif
+
+        typedef size_t (*ScanFunc)(const char*, size_t, std::vector<size_t>&);
+
+        static ScanFunc SelectScanFunc(const char** o_Name)
+        {
+#if defined(DCE_SCAN_X86)
+            if(__builtin_cpu_supports("avx2"))
+            {
+                *o_Name = "AVX2";
+                return ScanAVX2;
+            }
+#endif
+#if defined(DCE_SCAN_X86) && defined(__SSE2__)
+            *o_Name = "SSE2";
+            return ScanSSE2;
+#else
+            *o_Name = "Scalar";
+            return ScanScalar;
+#endif
+        }
+
+        static const char* s_ScanName = "Scalar";
+        static const ScanFunc s_Scan = SelectScanFunc(&s_ScanName);
+
+        size_t ScanLineLengths(const char* data, size_t size, std::vector<size_t>& o_Lengths)
+        {
+            return s_Scan(data, size, o_Lengths);
+        }
+
+        size_t ScanLineLengthsParallel(const char* data, size_t size, std::vector<size_t>& o_Lengths)
+        {
+            size_t threadCount = std::thread::hardware_concurrency();
+            size_t maxThreads = size / PARALLEL_CHUNK_SIZE;
+            if(threadCount > maxThreads)
+                threadCount = maxThreads;
+
+            if(threadCount <= 1)
+            {
+                o_Lengths.reserve(o_Lengths.size() + (size >> 6) + 1);
+                return s_Scan(data, size, o_Lengths);
+            }
+
+            // Every thread indexes its own chunk as if it started a line, the
+            // bytes left over at the end of one chunk then belong to the first
+            // line of the next one.
+            struct ChunkResult
+            {
+                std::vector<size_t> Lengths;
+                size_t Tail;
+            };
+            std::vector<ChunkResult> results(threadCount);
+            std::vector<std::thread> workers;
+            size_t chunkSize = size / threadCount;
+            for(size_t i = 0; i < threadCount; ++i)
+            {
+                size_t begin = i * chunkSize;
+                size_t end = (i == threadCount - 1) ? size : begin + chunkSize;
+                workers.emplace_back([&results, data, begin, end, i]()
+                {
+                    results[i].Lengths.reserve((end - begin) >> 6);
+                    results[i].Tail = s_Scan(data + begin, end - begin, results[i].Lengths);
+                });
+            }
+            for(std::thread& worker : workers)
+                worker.join();
+
+            size_t total = 0;
+            for(const ChunkResult& result : results)
+                total += result.Lengths.size();
+            o_Lengths.reserve(o_Lengths.size() + total);
+
+            size_t carry = 0;
+            for(ChunkResult& result : results)
+            {
+                if(result.Lengths.empty())
+                {
+                    carry += result.Tail;
+                    continue;
+                }
+                result.Lengths[0] += carry;
+                o_Lengths.insert(o_Lengths.end(), result.Lengths.begin(), result.Lengths.end());
+                carry = result.Tail;
+            }
+            return carry;
+        }
+
+        void BuildLineLengths(const char* data, size_t size, std::vector<size_t>& o_Lengths)
+        {
+            size_t tail = ScanLineLengthsParallel(data, size, o_Lengths);
+            o_Lengths.push_back(tail);
+        }
+
+        const char* GetScanMethodName()
+        {
+            return s_ScanName;
+        }
+
+        // The first and last byte of the needle already matched.
+        static inline bool MatchesInner(const char* candidate, const char* needle, size_t length)
+        {
+            return length <= 2 || memcmp(candidate + 1, needle + 1, length - 2) == 0;
+        }
+
+        static void FindScalar(const char* data, size_t size, const char* needle, size_t length, size_t base,
+                               std::vector<size_t>& o_Positions, size_t from)
+        {
+            const char* last = data + size - length;
+            for(const char* cur = data + from; cur <= last; ++cur)
+            {
+                cur = (const char*)memchr(cur, needle[0], (size_t)(last - cur) + 1);
+                if(!cur)
+                    break;
+                if(cur[length - 1] == needle[length - 1] && MatchesInner(cur, needle, length))
+                    o_Positions.push_back(base + (size_t)(cur - data));
+            }
+        }
+
+#if defined(DCE_SCAN_X86) && defined(__SSE2__)
+        static void FindSSE2(const char* data, size_t size, const char* needle, size_t length, size_t base,
+                             std::vector<size_t>& o_Positions)
+        {
+            const __m128i first = _mm_set1_epi8(needle[0]);
+            const __m128i last = _mm_set1_epi8(needle[length - 1]);
+            size_t i = 0;
+            for(; i + length - 1 + 16 <= size; i += 16)
+            {
+                __m128i blockFirst = _mm_loadu_si128((const __m128i*)(data + i));
+                __m128i blockLast = _mm_loadu_si128((const __m128i*)(data + i + length - 1));
+                uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first),
+                                                                          _mm_cmpeq_epi8(blockLast, last)));
+                while(mask)
+                {
+                    size_t pos = i + (size_t)__builtin_ctz(mask);
+                    if(MatchesInner(data + pos, needle, length))
+                        o_Positions.push_back(base + pos);
+                    mask &= mask - 1;
+                }
+            }
+            FindScalar(data, size, needle, length, base, o_Positions, i);
+        }
+#endif
+
+#if defined(DCE_SCAN_X86)
+        __attribute__((target("avx2")))
+        static void FindAVX2(const char* data, size_t size, const char* needle, size_t length, size_t base,
+                             std::vector<size_t>& o_Positions)
+        {
+            const __m256i first = _mm256_set1_epi8(needle[0]);
+            const __m256i last = _mm256_set1_epi8(needle[length - 1]);
+            size_t i = 0;
+            for(; i + length - 1 + 32 <= size; i += 32)
+            {
+                __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(data + i));
+                __m256i blockLast = _mm256_loadu_si256((const __m256i*)(data + i + length - 1));
+                uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first),
+                                                                                _mm256_cmpeq_epi8(blockLast, last)));
+                while(mask)
+                {
+                    size_t pos = i + (size_t)__builtin_ctz(mask);
+                    if(MatchesInner(data + pos, needle, length))
+                        o_Positions.push_back(base + pos);
+                    mask &= mask - 1;
+                }
+            }
+            FindScalar(data, size, needle, length, base, o_Positions, i);
+        }
+#endif
+
+        typedef void (*FindFunc)(const char*, size_t, const char*, size_t, size_t, std::vector<size_t>&);
+
+        static FindFunc SelectFindFunc()
+        {
+#if defined(DCE_SCAN_X86)
+            if(__builtin_cpu_supports("avx2"))
+                return FindAVX2;
+#endif
+#if defined(DCE_SCAN_X86) && defined(__SSE2__)
+            return FindSSE2;
+#else
+            return [](const char* data, size_t size, const char* needle, size_t length, size_t base,
+                      std::vector<size_t>& o_Positions) { FindScalar(data, size, needle, length, base, o_Positions, 0); };
+#endif
+        }
+
+        static const FindFunc s_Find = SelectFindFunc();
+
+        void FindAll(const char* data, size_t size, const char* needle, size_t length, size_t base,
+                     std::vector<size_t>& o_Positions)
+        {
+            if(length == 0 || length > size)
+                return;
+            s_Find(data, size, needle, length, base, o_Positions);
+        }
+    }
+}
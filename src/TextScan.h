@@ -0,0 +1,37 @@
+#ifndef _DCE_TEXT_SCAN_H
+#define _DCE_TEXT_SCAN_H
+
+#include <vector>
+
+#include "Core.h"
+
+namespace dce
+{
+    namespace TextScan
+    {
+        // Appends the length (newline included) of every line that ends inside
+        // data to o_Lengths, treating data[0] as the start of a line. Returns
+        // the number of bytes following the last newline.
+        size_t ScanLineLengths(const char* data, size_t size, std::vector<size_t>& o_Lengths);
+
+        // Same as above, split across worker threads for large inputs.
+        size_t ScanLineLengthsParallel(const char* data, size_t size, std::vector<size_t>& o_Lengths);
+
+        // Indexes a whole text. The trailing unterminated line is always
+        // appended, so the result can be handed straight to LineIndex::Build().
+        void BuildLineLengths(const char* data, size_t size, std::vector<size_t>& o_Lengths);
+
+        const char* GetScanMethodName();
+
+        // Appends base plus the offset of every occurrence of needle that lies
+        // entirely inside data to o_Positions, overlapping ones included and
+        // in order. Candidates are filtered by the needle's first and last
+        // byte a vector at a time, only those are compared in full.
+        void FindAll(const char* data, size_t size, const char* needle, size_t length, size_t base,
+                     std::vector<size_t>& o_Positions);
+
+        static constexpr size_t PARALLEL_CHUNK_SIZE = 0x800000ul;
+    }
+}
+
+#endif // _DCE_TEXT_SCAN_H
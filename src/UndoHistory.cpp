@@ -0,0 +1,166 @@
+#include <cstring>
+
+#include "UndoHistory.h"
+
+namespace dce
+{
+    UndoHistory::UndoHistory()
+    {
+        m_FirstBlock = 0;
+        m_Head = nullptr;
+        m_Remaining = 0;
+        m_BlockBytes = 0;
+        m_Current = 0;
+        m_Sealed = false;
+    }
+
+    UndoHistory::~UndoHistory()
+    {
+        Clear();
+    }
+
+    void UndoHistory::Clear()
+    {
+        for(const Block& block : m_Blocks)
+            free(block.Data);
+        m_Blocks.clear();
+        m_Ops.clear();
+        m_FirstBlock = 0;
+        m_Head = nullptr;
+        m_Remaining = 0;
+        m_BlockBytes = 0;
+        m_Current = 0;
+        m_Sealed = false;
+    }
+
+    void UndoHistory::Record(OpType type, size_t position, const char* data, size_t count)
+    {
+        if(count == 0)
+            return;
+
+        DropRedo();
+        if(!m_Sealed && ExtendLastOp(type, position, data, count))
+            return;
+
+        char* dest = Allocate(count);
+        Append(dest, type, data, count);
+        uint32_t block = m_FirstBlock + (uint32_t)m_Blocks.size() - 1;
+        m_Ops.push_back({ dest, position, count, block, type });
+        m_Current = m_Ops.size();
+        m_Sealed = false;
+
+        while(!m_Ops.empty() && GetMemoryUsage() > MAX_MEMORY_USAGE)
+            DropOldest();
+    }
+
+    const UndoHistory::Op* UndoHistory::Undo()
+    {
+        if(m_Current == 0)
+            return nullptr;
+        m_Sealed = true;
+        return &m_Ops[--m_Current];
+    }
+
+    const UndoHistory::Op* UndoHistory::Redo()
+    {
+        if(m_Current == m_Ops.size())
+            return nullptr;
+        return &m_Ops[m_Current++];
+    }
+
+    // Typing, deleting forward and backspacing in one place each grow the last
+    // operation as long as its bytes are still the last ones in the arena.
+    bool UndoHistory::ExtendLastOp(OpType type, size_t position, const char* data, size_t count)
+    {
+        if(m_Ops.empty() || count > m_Remaining)
+            return false;
+
+        Op& last = m_Ops.back();
+        if(last.Type != type || last.Data + last.Length != m_Head)
+            return false;
+        if(type == OpType::INSERT && (position != last.Position + last.Length || last.Data[last.Length - 1] == '\n'))
+            return false;
+        if(type == OpType::ERASE && position != last.Position)
+            return false;
+        if(type == OpType::ERASE_BACKWARD && position + count != last.Position)
+            return false;
+
+        Append(m_Head, type, data, count);
+        m_Head += count;
+        m_Remaining -= count;
+        last.Length += count;
+        if(type == OpType::ERASE_BACKWARD)
+            last.Position = position;
+        return true;
+    }
+
+    char* UndoHistory::Allocate(size_t count)
+    {
+        if(count > m_Remaining)
+        {
+            size_t size = count > BLOCK_SIZE ? count : BLOCK_SIZE;
+            char* data = (char*)malloc(size);
+            DCE_ASSURE_OR_EXIT(data, "An error occurred during memory allocation.\n");
+            m_Blocks.push_back({ data, size });
+            m_BlockBytes += size;
+            m_Head = data;
+            m_Remaining = size;
+        }
+
+        char* dest = m_Head;
+        m_Head += count;
+        m_Remaining -= count;
+        return dest;
+    }
+
+    void UndoHistory::Append(char* dest, OpType type, const char* data, size_t count)
+    {
+        if(type != OpType::ERASE_BACKWARD)
+        {
+            memcpy(dest, data, count);
+            return;
+        }
+        for(size_t i = 0; i < count; ++i)
+            dest[i] = data[count - 1 - i];
+    }
+
+    // Operations are laid out in the arena in the order they were recorded, so
+    // everything from the first undone one onwards can be handed back at once.
+    void UndoHistory::DropRedo()
+    {
+        if(m_Current == m_Ops.size())
+            return;
+
+        const Op& first = m_Ops[m_Current];
+        while(m_FirstBlock + m_Blocks.size() - 1 > first.Block)
+        {
+            m_BlockBytes -= m_Blocks.back().Size;
+            free(m_Blocks.back().Data);
+            m_Blocks.pop_back();
+        }
+        const Block& block = m_Blocks.back();
+        m_Head = (char*)first.Data;
+        m_Remaining = (size_t)(block.Data + block.Size - m_Head);
+        m_Ops.resize(m_Current);
+        m_Sealed = true;
+    }
+
+    void UndoHistory::DropOldest()
+    {
+        m_Ops.pop_front();
+        --m_Current;
+        if(m_Ops.empty())
+        {
+            Clear();
+            return;
+        }
+
+        while(m_FirstBlock < m_Ops.front().Block)
+        {
+            m_BlockBytes -= m_Blocks.front().Size;
+            free(m_Blocks.front().Data);
+            m_Blocks.pop_front();
+            ++m_FirstBlock;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef _DCE_UNDO_HISTORY_H
+#define _DCE_UNDO_HISTORY_H
+
+#include <deque>
+
+#include "Core.h"
+
+namespace dce
+{
+    // Log of text edits for undo and redo. Each operation only keeps the bytes
+    // it inserted or erased, stored back to back in an append-only arena of
+    // blocks, so dropping the redo tail just rewinds the arena and the oldest
+    // operations are given up block by block once MAX_MEMORY_USAGE is hit.
+    // Consecutive keystrokes are coalesced into a single operation.
+    class UndoHistory
+    {
+    public:
+        enum class OpType : uint8_t
+        {
+            INSERT,
+            ERASE,
+            ERASE_BACKWARD // Bytes are stored in reverse, as backspace removes them.
+        };
+
+        struct Op
+        {
+            const char* Data;
+            size_t Position;
+            size_t Length;
+            uint32_t Block;
+            OpType Type;
+        };
+    public:
+        UndoHistory();
+        UndoHistory(const UndoHistory&) = delete;
+        ~UndoHistory();
+
+        void Clear();
+        // Drops everything that could still be redone.
+        void Record(OpType type, size_t position, const char* data, size_t count);
+        // Makes the next Record() start a new operation even if it could have
+        // been merged into the last one.
+        inline void Seal() { m_Sealed = true; }
+        // Return the operation to revert or reapply, or nullptr if there is none.
+        const Op* Undo();
+        const Op* Redo();
+
+        inline size_t GetOpCount() const { return m_Ops.size(); }
+        inline size_t GetUndoCount() const { return m_Current; }
+        inline size_t GetMemoryUsage() const { return m_BlockBytes + m_Ops.size() * sizeof(Op); }
+    public:
+        static constexpr size_t BLOCK_SIZE = 0x10000ul;
+        static constexpr size_t MAX_MEMORY_USAGE = 0x4000000ul;
+    private:
+        struct Block
+        {
+            char* Data;
+            size_t Size;
+        };
+
+        bool ExtendLastOp(OpType type, size_t position, const char* data, size_t count);
+        char* Allocate(size_t count);
+        void Append(char* dest, OpType type, const char* data, size_t count);
+        void DropRedo();
+        void DropOldest();
+    private:
+        std::deque<Op> m_Ops;
+        std::deque<Block> m_Blocks;
+        uint32_t m_FirstBlock; // Id of m_Blocks.front(), ids keep counting up.
+        char* m_Head;
+        size_t m_Remaining;
+        size_t m_BlockBytes;
+        size_t m_Current;
+        bool m_Sealed;
+    };
+}
+
+#endif // _DCE_UNDO_HISTORY_H
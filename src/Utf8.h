@@ -0,0 +1,63 @@
+#ifndef _DCE_UTF8_H
+#define _DCE_UTF8_H
+
+#include "Core.h"
+
+namespace dce
+{
+    namespace Utf8
+    {
+        static constexpr uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+        // Decodes the codepoint starting at data, which has size > 0 bytes
+        // left, and stores the length of its sequence in o_Length. Malformed,
+        // overlong and truncated sequences decode to REPLACEMENT_CHARACTER one
+        // byte at a time, so every byte of the input is accounted for.
+        inline uint32_t Decode(const char* data, size_t size, size_t* o_Length)
+        {
+            const uint8_t* bytes = (const uint8_t*)data;
+            const uint8_t lead = bytes[0];
+            *o_Length = 1;
+            if(lead < 0x80)
+                return lead;
+
+            size_t length;
+            uint32_t codepoint, min;
+            if((lead & 0xE0) == 0xC0)
+            {
+                length = 2;
+                codepoint = lead & 0x1F;
+                min = 0x80;
+            }
+            else if((lead & 0xF0) == 0xE0)
+            {
+                length = 3;
+                codepoint = lead & 0x0F;
+                min = 0x800;
+            }
+            else if((lead & 0xF8) == 0xF0)
+            {
+                length = 4;
+                codepoint = lead & 0x07;
+                min = 0x10000;
+            }
+            else
+                return REPLACEMENT_CHARACTER;
+
+            if(length > size)
+                return REPLACEMENT_CHARACTER;
+            for(size_t i = 1; i < length; ++i)
+            {
+                if((bytes[i] & 0xC0) != 0x80)
+                    return REPLACEMENT_CHARACTER;
+                codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+            }
+            if(codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+                return REPLACEMENT_CHARACTER;
+            *o_Length = length;
+            return codepoint;
+        }
+    }
+}
+
+#endif // _DCE_UTF8_H
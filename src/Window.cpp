@@ -7,6 +7,7 @@
 #include "Editor.h"
 #include "Renderer.h"
 #include "FileManager.h"
+#include "FrameStats.h"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -53,6 +54,21 @@ namespace dce
                 });
         
 
+        glfwSetWindowContentScaleCallback(m_Window,
+                [](GLFWwindow* window, float xScale, float yScale)
+                {
+                    (void)window; (void)yScale;
+                    Editor::OnContentScale(xScale);
+                });
+
+        glfwSetWindowRefreshCallback(m_Window, 
+                [](GLFWwindow* window)
+                {
+                    (void)window;
+                    Editor::Invalidate();
+                });
+        
+
         glfwSetScrollCallback(m_Window, 
                 [](GLFWwindow* window, double xOffset, double yOffset)
                 {
@@ -64,7 +80,10 @@ namespace dce
                 {
                     (void)window; (void)scancode;
                     if(action != GLFW_RELEASE)
+                    {
+                        ScopedStageTimer timer(FrameStage::EVENTS);
                         Editor::OnKeyPress((KeyCode)key, mods, action == GLFW_REPEAT);
+                    }
                 });
 
     }
@@ -85,11 +104,40 @@ namespace dce
         glfwSetWindowTitle(m_Window, newTitle);
     }
 
-    // SWAP THE WINDOW FRAME BUFFERS AND POLL WINDOW EVENTS.
-    void EditorWindow::WindowNextFrame()
+    // SWAP THE WINDOW FRAME BUFFERS.
+    void EditorWindow::SwapBuffers()
     {
+        ScopedStageTimer timer(FrameStage::SWAP);
         glfwSwapBuffers(m_Window);
-        glfwPollEvents();
+    }
+
+    float EditorWindow::GetContentScale() const
+    {
+        float xScale, yScale;
+        glfwGetWindowContentScale(m_Window, &xScale, &yScale);
+        return xScale;
+    }
+
+    double EditorWindow::GetRefreshRate()
+    {
+        const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        if(!mode || mode->refreshRate <= 0)
+            return DEFAULT_REFRESH_RATE;
+        return (double)mode->refreshRate;
+    }
+
+    // WAIT FOR AND HANDLE WINDOW EVENTS.
+    void EditorWindow::Wake()
+    {
+        glfwPostEmptyEvent();
+    }
+
+    void EditorWindow::WaitEvents(double timeout)
+    {
+        if(timeout > 0.0)
+            glfwWaitEventsTimeout(timeout);
+        else
+            glfwPollEvents();
     }
 
     namespace
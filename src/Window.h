@@ -15,7 +15,10 @@ namespace dce
         ~EditorWindow();
 
         void UpdateWindowTitle(const char* newTitle);
-        void WindowNextFrame();
+        void SwapBuffers();
+        // Handles pending events, sleeping up to timeout seconds for one to
+        // come in if there are none.
+        void WaitEvents(double timeout);
 
         inline void SetWindowSize(uint32_t width, uint32_t height)
         {
@@ -33,6 +36,13 @@ namespace dce
         inline uint32_t GetHeight() const { return m_Height; }
 
         inline bool IsMinimized() const { return m_Minimized; }
+        float GetContentScale() const;
+        // Of the primary monitor, in Hz.
+        static double GetRefreshRate();
+        // Makes WaitEvents() return, can be called from any thread.
+        static void Wake();
+    public:
+        static constexpr double DEFAULT_REFRESH_RATE = 60.0;
     private:
         GLFWwindow* m_Window;
         uint32_t m_Width, m_Height;
@@ -0,0 +1,66 @@
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "WorkerPool.h"
+
+namespace dce
+{
+    namespace WorkerPool
+    {
+        struct PoolState
+        {
+            std::mutex Lock;
+            std::condition_variable Wake;
+            std::deque<Job> Jobs;
+            size_t ThreadCount = 0;
+        };
+
+        // Never destroyed, the threads are detached and still wait on it
+        // while the process exits.
+        static PoolState& s_Pool = *new PoolState();
+
+        static void RunWorker()
+        {
+            while(true)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(s_Pool.Lock);
+                    s_Pool.Wake.wait(lock, []() { return !s_Pool.Jobs.empty(); });
+                    job = std::move(s_Pool.Jobs.front());
+                    s_Pool.Jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        static void StartThreads()
+        {
+            size_t cores = std::thread::hardware_concurrency();
+            s_Pool.ThreadCount = cores > 2 ? cores - 1 : 1;
+            for(size_t i = 0; i < s_Pool.ThreadCount; ++i)
+                std::thread(RunWorker).detach();
+        }
+
+        void Submit(Job job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(s_Pool.Lock);
+                if(s_Pool.ThreadCount == 0)
+                    StartThreads();
+                s_Pool.Jobs.push_back(std::move(job));
+            }
+            s_Pool.Wake.notify_one();
+        }
+
+        size_t GetThreadCount()
+        {
+            std::lock_guard<std::mutex> lock(s_Pool.Lock);
+            if(s_Pool.ThreadCount == 0)
+                StartThreads();
+            return s_Pool.ThreadCount;
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef _DCE_WORKER_POOL_H
+#define _DCE_WORKER_POOL_H
+
+#include <functional>
+
+#include "Core.h"
+
+namespace dce
+{
+    // Threads for work that can be split up and done in parallel without
+    // holding up the main thread, one fewer than there are cores but at
+    // least one. They're started the first time a job is submitted and live
+    // as long as the process, jobs are run in the order they came in.
+    namespace WorkerPool
+    {
+        typedef std::function<void()> Job;
+
+        void Submit(Job job);
+        size_t GetThreadCount();
+    }
+}
+
+#endif // _DCE_WORKER_POOL_H